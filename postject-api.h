@@ -3,20 +3,39 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #if defined(__APPLE__) && defined(__MACH__)
 #include <mach-o/dyld.h>
 #include <mach-o/getsect.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #elif defined(__linux__)
 #include <elf.h>
+#include <fcntl.h>
 #include <link.h>
+#include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #elif defined(_WIN32)
 #include <windows.h>
 #endif
 
+// For the CRC32C instructions of `postject_verify_resource()`
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define POSTJECT__CRC32C_SSE42
+#elif defined(_M_X64) && defined(_MSC_VER)
+#include <intrin.h>
+#define POSTJECT__CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define POSTJECT__CRC32C_ARM
+#endif
+
 #ifndef POSTJECT_SENTINEL_FUSE
 #define POSTJECT_SENTINEL_FUSE \
   "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2"
@@ -38,6 +57,13 @@ inline void postject_options_init(struct postject_options* options) {
   options->pe_resource_name = NULL;
 }
 
+// Called by `postject_enumerate_resources()` for each resource. The name is
+// only valid for the duration of the call. Return false to stop enumerating.
+typedef bool (*postject_resource_callback)(const char* name,
+                                           const void* data,
+                                           size_t size,
+                                           void* user_data);
+
 static inline bool postject_has_resource() {
   static const volatile char* sentinel = POSTJECT_SENTINEL_FUSE ":0";
   return sentinel[sizeof(POSTJECT_SENTINEL_FUSE)] == '1';
@@ -51,6 +77,218 @@ static int postject__dl_iterate_phdr_callback(struct dl_phdr_info* info,
   *((struct dl_phdr_info*)data) = *info;
   return 1;
 }
+
+struct postject__elf_note {
+  const char* name;
+  const void* data;
+  size_t size;
+};
+
+// Hash table of the notes injected by postject, built on the first lookup so
+// that the program headers and notes are only walked once
+struct postject__elf_index {
+  size_t count;
+  size_t mask;
+  struct postject__elf_note* notes;
+  // Open addressing, with 1-based indices into `notes` and 0 for empty slots
+  size_t* slots;
+};
+
+static inline size_t postject__hash(const char* name) {
+  // FNV-1a
+  size_t hash = (size_t)2166136261u;
+  for (; *name != '\0'; name++) {
+    hash = (hash ^ (unsigned char)*name) * (size_t)16777619u;
+  }
+  return hash;
+}
+
+// Stores up to `capacity` of the main program's postject notes in `notes`, and
+// returns how many there are in total
+static inline size_t postject__walk_elf_notes(struct postject__elf_note* notes,
+                                              size_t capacity) {
+  struct dl_phdr_info main_program_info;
+  dl_iterate_phdr(postject__dl_iterate_phdr_callback, &main_program_info);
+
+  uintptr_t p = (uintptr_t)main_program_info.dlpi_phdr;
+  size_t n = main_program_info.dlpi_phnum;
+  uintptr_t base_addr = main_program_info.dlpi_addr;
+  size_t count = 0;
+
+  // iterate program header
+  for (; n > 0; n--, p += sizeof(ElfW(Phdr))) {
+    ElfW(Phdr)* phdr = (ElfW(Phdr)*)p;
+
+    // skip everything but notes
+    if (phdr->p_type != PT_NOTE) {
+      continue;
+    }
+
+    // GNU property notes use 8 byte alignment, everything else uses 4
+    size_t alignment = phdr->p_align == 8 ? 8 : 4;
+
+    // note segment starts at base address + segment virtual address
+    uintptr_t pos = (base_addr + phdr->p_vaddr);
+    uintptr_t end = (pos + phdr->p_memsz);
+
+    // iterate through segment until we reach the end
+    while (pos + sizeof(ElfW(Nhdr)) <= end) {
+      ElfW(Nhdr)* note = (ElfW(Nhdr)*)pos;
+      const char* name = (const char*)(pos + sizeof(ElfW(Nhdr)));
+      uintptr_t desc = (uintptr_t)name + roundup(note->n_namesz, alignment);
+
+      if (desc > end || note->n_descsz > end - desc) {
+        break;  // invalid
+      }
+
+      // postject writes its notes with type 0 and a NUL-terminated name
+      if (note->n_type == 0 && note->n_namesz != 0 && note->n_descsz != 0 &&
+          name[note->n_namesz - 1] == '\0') {
+        if (count < capacity) {
+          notes[count].name = name;
+          notes[count].data = (const void*)desc;
+          notes[count].size = note->n_descsz;
+        }
+        count++;
+      }
+
+      pos = desc + roundup(note->n_descsz, alignment);
+    }
+  }
+
+  return count;
+}
+
+static inline const struct postject__elf_index* postject__get_elf_index() {
+  static struct postject__elf_index* cached_index = NULL;
+
+  struct postject__elf_index* index =
+      __atomic_load_n(&cached_index, __ATOMIC_ACQUIRE);
+  if (index != NULL) {
+    return index;
+  }
+
+  // Keep the table at most half full
+  size_t count = postject__walk_elf_notes(NULL, 0);
+  size_t capacity = 1;
+  while (capacity < count * 2) {
+    capacity <<= 1;
+  }
+
+  index = (struct postject__elf_index*)malloc(
+      sizeof(struct postject__elf_index) +
+      count * sizeof(struct postject__elf_note) + capacity * sizeof(size_t));
+  if (index == NULL) {
+    return NULL;
+  }
+
+  index->notes = (struct postject__elf_note*)(index + 1);
+  index->slots = (size_t*)(index->notes + count);
+  index->count = postject__walk_elf_notes(index->notes, count);
+  index->mask = capacity - 1;
+  memset(index->slots, 0, capacity * sizeof(size_t));
+
+  for (size_t i = 0; i < index->count; i++) {
+    size_t slot = postject__hash(index->notes[i].name) & index->mask;
+    while (index->slots[slot] != 0 &&
+           strcmp(index->notes[index->slots[slot] - 1].name,
+                  index->notes[i].name) != 0) {
+      slot = (slot + 1) & index->mask;
+    }
+
+    // The first note wins if a name is used more than once
+    if (index->slots[slot] == 0) {
+      index->slots[slot] = i + 1;
+    }
+  }
+
+  // Another thread may have built the index in the meantime, use theirs
+  struct postject__elf_index* expected = NULL;
+  if (!__atomic_compare_exchange_n(&cached_index, &expected, index, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(index);
+    index = expected;
+  }
+
+  return index;
+}
+#elif defined(__APPLE__) && defined(__MACH__)
+#ifdef __LP64__
+typedef struct mach_header_64 postject__mach_header;
+typedef struct segment_command_64 postject__segment_command;
+typedef struct section_64 postject__section;
+#define POSTJECT__LC_SEGMENT LC_SEGMENT_64
+#else
+typedef struct mach_header postject__mach_header;
+typedef struct segment_command postject__segment_command;
+typedef struct section postject__section;
+#define POSTJECT__LC_SEGMENT LC_SEGMENT
+#endif
+
+// Finds the loaded image of the main program, or of the given framework
+static inline bool postject__find_macho_image(
+    const char* framework_name,
+    const postject__mach_header** header,
+    intptr_t* slide) {
+  uint32_t image = 0;
+
+  if (framework_name != NULL) {
+    // Frameworks are loaded from .../<name>.framework/<name>, like
+    // getsectdatafromFramework() expects
+    size_t name_length = strlen(framework_name);
+    for (image = 0; image < _dyld_image_count(); image++) {
+      const char* path = _dyld_get_image_name(image);
+      size_t path_length = strlen(path);
+      if (path_length > name_length + 11 &&
+          strcmp(path + path_length - name_length, framework_name) == 0 &&
+          strncmp(path + path_length - name_length - 11, ".framework/", 11) ==
+              0) {
+        break;
+      }
+    }
+
+    if (image == _dyld_image_count()) {
+      return false;
+    }
+  }
+
+  *header = (const postject__mach_header*)_dyld_get_image_header(image);
+  *slide = _dyld_get_image_vmaddr_slide(image);
+  return *header != NULL;
+}
+#elif defined(_WIN32)
+struct postject__enum_context {
+  postject_resource_callback callback;
+  void* user_data;
+  size_t count;
+};
+
+static inline BOOL CALLBACK postject__enum_names_callback(HMODULE module,
+                                                          LPCSTR type,
+                                                          LPSTR name,
+                                                          LONG_PTR param) {
+  struct postject__enum_context* context =
+      (struct postject__enum_context*)param;
+
+  // postject only injects named resources
+  if (IS_INTRESOURCE(name)) {
+    return TRUE;
+  }
+
+  HRSRC resource_handle = FindResourceA(module, name, type);
+  HGLOBAL global_resource_handle =
+      resource_handle ? LoadResource(module, resource_handle) : NULL;
+  if (global_resource_handle == NULL) {
+    return TRUE;
+  }
+
+  context->count++;
+  return context->callback(name, LockResource(global_resource_handle),
+                           SizeofResource(module, resource_handle),
+                           context->user_data)
+             ? TRUE
+             : FALSE;
+}
 #endif
 
 static const void* postject_find_resource(
@@ -63,6 +301,8 @@ static const void* postject_find_resource(
   }
 
 #if defined(__APPLE__) && defined(__MACH__)
+  // Section names are at most 16 characters, so the prefixed name fits
+  char prefixed_name[2 + 16 + 1];
   char* section_name = NULL;
   const char* segment_name = "__POSTJECT";
 
@@ -74,10 +314,10 @@ static const void* postject_find_resource(
     name = options->macho_section_name;
   } else if (strncmp(name, "__", 2) != 0) {
     // Automatically prepend __ to match naming convention
-    section_name = (char*)malloc(strlen(name) + 3);
-    if (section_name == NULL) {
+    if (strlen(name) + 2 >= sizeof(prefixed_name)) {
       return NULL;
     }
+    section_name = prefixed_name;
     strcpy(section_name, "__");
     strcat(section_name, name);
   }
@@ -110,9 +350,7 @@ static const void* postject_find_resource(
     }
   }
 
-  free(section_name);
-
-  if (size != NULL) {
+  if (size != NULL && ptr != NULL) {
     *size = (size_t)section_size;
   }
 
@@ -123,62 +361,42 @@ static const void* postject_find_resource(
     name = options->elf_section_name;
   }
 
-  struct dl_phdr_info main_program_info;
-  dl_iterate_phdr(postject__dl_iterate_phdr_callback, &main_program_info);
-
-  uintptr_t p = (uintptr_t)main_program_info.dlpi_phdr;
-  size_t n = main_program_info.dlpi_phnum;
-  uintptr_t base_addr = main_program_info.dlpi_addr;
-
-  // iterate program header
-  for (; n > 0; n--, p += sizeof(ElfW(Phdr))) {
-    ElfW(Phdr)* phdr = (ElfW(Phdr)*)p;
-
-    // skip everything but notes
-    if (phdr->p_type != PT_NOTE) {
-      continue;
-    }
-
-    // note segment starts at base address + segment virtual address
-    uintptr_t pos = (base_addr + phdr->p_vaddr);
-    uintptr_t end = (pos + phdr->p_memsz);
-
-    // iterate through segment until we reach the end
-    while (pos < end) {
-      if (pos + sizeof(ElfW(Nhdr)) > end) {
-        break;  // invalid
-      }
+  const struct postject__elf_index* index = postject__get_elf_index();
+  if (index == NULL) {
+    return NULL;
+  }
 
-      ElfW(Nhdr)* note = (ElfW(Nhdr)*)(uintptr_t)pos;
-      if (note->n_namesz != 0 && note->n_descsz != 0 &&
-          strncmp((char*)(pos + sizeof(ElfW(Nhdr))), (char*)name,
-                  sizeof(name)) == 0) {
-        *size = note->n_descsz;
-        // advance past note header and aligned name
-        // to get to description data
-        return (void*)((uintptr_t)note + sizeof(ElfW(Nhdr)) +
-                       roundup(note->n_namesz, 4));
+  size_t slot = postject__hash(name) & index->mask;
+  for (; index->slots[slot] != 0; slot = (slot + 1) & index->mask) {
+    const struct postject__elf_note* note =
+        &index->notes[index->slots[slot] - 1];
+    if (strcmp(note->name, name) == 0) {
+      if (size != NULL) {
+        *size = note->size;
       }
-
-      pos += (sizeof(ElfW(Nhdr)) + roundup(note->n_namesz, 4) +
-              roundup(note->n_descsz, 4));
+      return note->data;
     }
   }
   return NULL;
 
 #elif defined(_WIN32)
   void* ptr = NULL;
+  char short_name[256];
   char* resource_name = NULL;
 
   if (options != NULL && options->pe_resource_name != NULL) {
     name = options->pe_resource_name;
   } else {
-    // Automatically uppercase the resource name or it won't be found
-    resource_name = (char*)malloc(strlen(name) + 1);
+    // Automatically uppercase the resource name or it won't be found. Only
+    // unusually long names need an allocation.
+    size_t name_size = strlen(name) + 1;
+    resource_name = name_size <= sizeof(short_name)
+                        ? short_name
+                        : (char*)malloc(name_size);
     if (resource_name == NULL) {
       return NULL;
     }
-    strcpy_s(resource_name, strlen(name) + 1, name);
+    strcpy_s(resource_name, name_size, name);
     CharUpperA(resource_name);  // Uppercases inplace
   }
 
@@ -198,7 +416,9 @@ static const void* postject_find_resource(
     }
   }
 
-  free(resource_name);
+  if (resource_name != short_name) {
+    free(resource_name);
+  }
 
   return ptr;
 #else
@@ -206,4 +426,797 @@ static const void* postject_find_resource(
 #endif
 }
 
+// Calls `callback` for each resource injected by postject, walking them only
+// once, and returns how many were visited. The options select the Mach-O
+// segment and framework to look in.
+static inline size_t postject_enumerate_resources(
+    postject_resource_callback callback,
+    void* user_data,
+    const struct postject_options* options) {
+#if defined(__APPLE__) && defined(__MACH__)
+  const char* segment_name = "__POSTJECT";
+  const char* framework_name = NULL;
+
+  if (options != NULL && options->macho_segment_name != NULL) {
+    segment_name = options->macho_segment_name;
+  }
+  if (options != NULL) {
+    framework_name = options->macho_framework_name;
+  }
+
+  const postject__mach_header* header = NULL;
+  intptr_t slide = 0;
+  if (!postject__find_macho_image(framework_name, &header, &slide)) {
+    return 0;
+  }
+
+  uintptr_t command = (uintptr_t)(header + 1);
+  size_t count = 0;
+
+  for (uint32_t i = 0; i < header->ncmds; i++) {
+    const postject__segment_command* segment =
+        (const postject__segment_command*)command;
+    command += ((const struct load_command*)command)->cmdsize;
+
+    if (segment->cmd != POSTJECT__LC_SEGMENT ||
+        strncmp(segment->segname, segment_name, sizeof(segment->segname)) !=
+            0) {
+      continue;
+    }
+
+    const postject__section* sections = (const postject__section*)(segment + 1);
+    for (uint32_t j = 0; j < segment->nsects; j++) {
+      // Section names aren't NUL-terminated if they're 16 characters long
+      char name[sizeof(sections[j].sectname) + 1];
+      memcpy(name, sections[j].sectname, sizeof(sections[j].sectname));
+      name[sizeof(sections[j].sectname)] = '\0';
+
+      count++;
+      if (!callback(name, (const void*)(sections[j].addr + slide),
+                    (size_t)sections[j].size, user_data)) {
+        return count;
+      }
+    }
+  }
+
+  return count;
+#elif defined(__linux__)
+  (void)options;
+
+  const struct postject__elf_index* index = postject__get_elf_index();
+  if (index == NULL) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < index->count; i++) {
+    const struct postject__elf_note* note = &index->notes[i];
+    if (!callback(note->name, note->data, note->size, user_data)) {
+      return i + 1;
+    }
+  }
+
+  return index->count;
+#elif defined(_WIN32)
+  (void)options;
+
+  struct postject__enum_context context;
+  context.callback = callback;
+  context.user_data = user_data;
+  context.count = 0;
+
+  EnumResourceNamesA(NULL, MAKEINTRESOURCEA(10) /* RT_RCDATA */,
+                     postject__enum_names_callback, (LONG_PTR)&context);
+
+  return context.count;
+#else
+  (void)callback;
+  (void)user_data;
+  (void)options;
+  return 0;
+#endif
+}
+
+// Resources injected with --compress start with a 20 byte header: the magic
+// "PJCZ", a version byte, a codec byte, 2 reserved bytes, the uncompressed
+// chunk size (uint32) and the uncompressed size (uint64), in little-endian.
+// The data follows as independently compressed chunks, which all decompress
+// to the chunk size except for the last one. Each chunk starts with its
+// stored size (uint32), with the top bit set if it's stored uncompressed.
+#define POSTJECT_COMPRESSION_HEADER_SIZE 20
+#define POSTJECT_CODEC_LZ4 1
+
+// Reads a resource chunk by chunk, decompressing it if needed. Resources that
+// weren't compressed are read as is.
+struct postject_reader {
+  const unsigned char* pos;
+  const unsigned char* end;
+  size_t chunk_size;
+  size_t remaining;
+  bool compressed;
+};
+
+static inline uint64_t postject__read_le(const unsigned char* p, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= (uint64_t)p[i] << (8 * i);
+  }
+  return value;
+}
+
+// Decompresses an LZ4 block, returns the decompressed size or (size_t)-1 if
+// the block is corrupt or doesn't fit
+static inline size_t postject__lz4_decompress(const unsigned char* src,
+                                              size_t src_size,
+                                              unsigned char* dst,
+                                              size_t dst_size) {
+  const unsigned char* ip = src;
+  const unsigned char* const iend = src + src_size;
+  unsigned char* op = dst;
+  unsigned char* const oend = dst + dst_size;
+
+  while (ip < iend) {
+    const unsigned token = *ip++;
+
+    size_t literals = token >> 4;
+    if (literals == 15) {
+      unsigned char byte;
+      do {
+        if (ip == iend) {
+          return (size_t)-1;
+        }
+        byte = *ip++;
+        literals += byte;
+      } while (byte == 255);
+    }
+
+    if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) {
+      return (size_t)-1;
+    }
+    memcpy(op, ip, literals);
+    ip += literals;
+    op += literals;
+
+    // The last sequence only has literals
+    if (ip == iend) {
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return (size_t)-1;
+    }
+    const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+
+    if (offset == 0 || offset > (size_t)(op - dst)) {
+      return (size_t)-1;
+    }
+
+    size_t match = token & 15;
+    if (match == 15) {
+      unsigned char byte;
+      do {
+        if (ip == iend) {
+          return (size_t)-1;
+        }
+        byte = *ip++;
+        match += byte;
+      } while (byte == 255);
+    }
+    match += 4;
+
+    if (match > (size_t)(oend - op)) {
+      return (size_t)-1;
+    }
+
+    // Matches can overlap the output, so copy byte by byte
+    const unsigned char* from = op - offset;
+    for (size_t i = 0; i < match; i++) {
+      op[i] = from[i];
+    }
+    op += match;
+  }
+
+  return (size_t)(op - dst);
+}
+
+static inline bool postject_reader_init(struct postject_reader* reader,
+                                        const void* data,
+                                        size_t size) {
+  const unsigned char* bytes = (const unsigned char*)data;
+  reader->pos = bytes;
+  reader->end = bytes + size;
+  reader->chunk_size = 256 * 1024;
+  reader->remaining = size;
+  reader->compressed = false;
+
+  if (size < POSTJECT_COMPRESSION_HEADER_SIZE ||
+      memcmp(bytes, "PJCZ", 4) != 0) {
+    return true;
+  }
+
+  const uint64_t chunk_size = postject__read_le(bytes + 8, 4);
+  const uint64_t uncompressed_size = postject__read_le(bytes + 12, 8);
+
+  if (bytes[4] != 1 || bytes[5] != POSTJECT_CODEC_LZ4 || chunk_size == 0 ||
+      uncompressed_size > (size_t)-1) {
+    return false;
+  }
+
+  reader->pos = bytes + POSTJECT_COMPRESSION_HEADER_SIZE;
+  reader->chunk_size = (size_t)chunk_size;
+  reader->remaining = (size_t)uncompressed_size;
+  reader->compressed = true;
+  return true;
+}
+
+// The size of the (decompressed) data left to read
+static inline size_t postject_reader_remaining(
+    const struct postject_reader* reader) {
+  return reader->remaining;
+}
+
+// The largest amount of data returned by a single postject_reader_next()
+static inline size_t postject_reader_chunk_size(
+    const struct postject_reader* reader) {
+  return reader->chunk_size;
+}
+
+// Reads the next chunk into `buffer`, which has to hold at least
+// postject_reader_chunk_size() bytes. `size` is set to 0 at the end of the
+// data. Returns false if the data is corrupt or the buffer is too small.
+static inline bool postject_reader_next(struct postject_reader* reader,
+                                        void* buffer,
+                                        size_t buffer_size,
+                                        size_t* size) {
+  const size_t expected = reader->remaining < reader->chunk_size
+                              ? reader->remaining
+                              : reader->chunk_size;
+  *size = 0;
+
+  if (expected == 0) {
+    return true;
+  }
+  if (buffer_size < expected) {
+    return false;
+  }
+
+  if (!reader->compressed) {
+    memcpy(buffer, reader->pos, expected);
+    reader->pos += expected;
+  } else {
+    if (reader->end - reader->pos < 4) {
+      return false;
+    }
+
+    const uint32_t stored = (uint32_t)postject__read_le(reader->pos, 4);
+    const size_t stored_size = stored & 0x7fffffffu;
+    reader->pos += 4;
+
+    if (stored_size > (size_t)(reader->end - reader->pos)) {
+      return false;
+    }
+
+    if (stored & 0x80000000u) {
+      if (stored_size != expected) {
+        return false;
+      }
+      memcpy(buffer, reader->pos, expected);
+    } else if (postject__lz4_decompress(reader->pos, stored_size,
+                                        (unsigned char*)buffer,
+                                        expected) != expected) {
+      return false;
+    }
+
+    reader->pos += stored_size;
+  }
+
+  reader->remaining -= expected;
+  *size = expected;
+  return true;
+}
+
+// Resources injected with --checksum are followed by the CRC32C of every
+// chunk of their data (uint32 each) and a 20 byte footer: the magic "PJCK", a
+// version byte, an algorithm byte, 2 reserved bytes, the chunk size (uint32)
+// and the size of the data (uint64), in little-endian. With --compress as
+// well, the checksums are of the compressed data.
+#define POSTJECT_CHECKSUM_FOOTER_SIZE 20
+#define POSTJECT_CHECKSUM_CRC32C 1
+
+// The data of a resource injected with --checksum and its checksums, whose
+// chunks can be verified independently, e.g. on several threads
+struct postject_checksums {
+  const unsigned char* data;
+  size_t size;
+  size_t chunk_size;
+  size_t chunk_count;
+  const unsigned char* checksums;
+};
+
+// CRC32C in software, 8 bytes at a time ("slicing-by-8"). The tables are only
+// a few thousand operations to build, which is negligible next to a chunk.
+static inline uint32_t postject__crc32c_table(const unsigned char* p,
+                                              size_t size) {
+  uint32_t table[8][256];
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+    }
+    table[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int k = 1; k < 8; k++) {
+      table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+    }
+  }
+
+  uint32_t crc = 0xffffffffu;
+  for (; size >= 8; size -= 8, p += 8) {
+    const uint32_t low = crc ^ (uint32_t)postject__read_le(p, 4);
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+          table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+  }
+  for (; size > 0; size--, p++) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xff];
+  }
+  return ~crc;
+}
+
+#if defined(POSTJECT__CRC32C_SSE42)
+static inline bool postject__has_sse42() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  unsigned eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 20)) != 0;
+#endif
+}
+
+#if !defined(_MSC_VER) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+static inline uint32_t
+postject__crc32c_sse42(const unsigned char* p, size_t size) {
+  uint64_t crc = 0xffffffffu;
+  for (; size >= 8; size -= 8, p += 8) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+#if defined(_MSC_VER) && !defined(__clang__)
+    crc = _mm_crc32_u64(crc, value);
+#else
+    crc = __builtin_ia32_crc32di(crc, value);
+#endif
+  }
+  uint32_t crc32 = (uint32_t)crc;
+  for (; size > 0; size--, p++) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    crc32 = _mm_crc32_u8(crc32, *p);
+#else
+    crc32 = __builtin_ia32_crc32qi(crc32, *p);
+#endif
+  }
+  return ~crc32;
+}
+#elif defined(POSTJECT__CRC32C_ARM)
+static inline uint32_t postject__crc32c_arm(const unsigned char* p,
+                                            size_t size) {
+  uint32_t crc = 0xffffffffu;
+  for (; size >= 8; size -= 8, p += 8) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    crc = __crc32cd(crc, value);
+  }
+  for (; size > 0; size--, p++) {
+    crc = __crc32cb(crc, *p);
+  }
+  return ~crc;
+}
+#endif
+
+// CRC32C, with the SSE 4.2 or ARMv8 CRC instructions when the CPU has them
+static inline uint32_t postject__crc32c(const unsigned char* p, size_t size) {
+#if defined(POSTJECT__CRC32C_SSE42)
+  if (postject__has_sse42()) {
+    return postject__crc32c_sse42(p, size);
+  }
+#elif defined(POSTJECT__CRC32C_ARM)
+  return postject__crc32c_arm(p, size);
+#endif
+  return postject__crc32c_table(p, size);
+}
+
+// Finds the checksums of a resource's data from the footer. Returns false if
+// the resource wasn't injected with --checksum.
+static inline bool postject_checksums_init(
+    struct postject_checksums* checksums,
+    const void* resource,
+    size_t resource_size) {
+  const unsigned char* bytes = (const unsigned char*)resource;
+  if (resource_size < POSTJECT_CHECKSUM_FOOTER_SIZE) {
+    return false;
+  }
+
+  const unsigned char* footer =
+      bytes + resource_size - POSTJECT_CHECKSUM_FOOTER_SIZE;
+  const uint64_t chunk_size = postject__read_le(footer + 8, 4);
+  const uint64_t size = postject__read_le(footer + 12, 8);
+  const size_t available = resource_size - POSTJECT_CHECKSUM_FOOTER_SIZE;
+
+  if (memcmp(footer, "PJCK", 4) != 0 || footer[4] != 1 ||
+      footer[5] != POSTJECT_CHECKSUM_CRC32C || chunk_size == 0 ||
+      size > available) {
+    return false;
+  }
+
+  // The checksums have to exactly fill the room between the data and the
+  // footer
+  const uint64_t chunk_count = (size + chunk_size - 1) / chunk_size;
+  if (chunk_count > (available - size) / 4 ||
+      size + chunk_count * 4 != available) {
+    return false;
+  }
+
+  checksums->data = bytes;
+  checksums->size = (size_t)size;
+  checksums->chunk_size = (size_t)chunk_size;
+  checksums->chunk_count = (size_t)chunk_count;
+  checksums->checksums = bytes + size;
+  return true;
+}
+
+// Checks the chunk at `index` against its checksum. Chunks can be checked
+// concurrently.
+static inline bool postject_verify_chunk(
+    const struct postject_checksums* checksums,
+    size_t index) {
+  if (index >= checksums->chunk_count) {
+    return false;
+  }
+
+  const size_t offset = index * checksums->chunk_size;
+  const size_t size = checksums->size - offset < checksums->chunk_size
+                          ? checksums->size - offset
+                          : checksums->chunk_size;
+  return postject__crc32c(checksums->data + offset, size) ==
+         (uint32_t)postject__read_le(checksums->checksums + index * 4, 4);
+}
+
+// Remembers the resources that passed `postject_verify_resource()`, by
+// address, so that they're only checked once. Returns whether `resource` was
+// verified, after adding it if `add` is set. Past the first 64 resources,
+// they're checked every time.
+static inline bool postject__verified(const void* resource, bool add) {
+  static const void* volatile verified[64];
+
+  for (size_t i = 0; i < sizeof(verified) / sizeof(*verified); i++) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    const void* current = InterlockedCompareExchangePointer(
+        (PVOID volatile*)&verified[i], NULL, NULL);
+    if (current == NULL && add) {
+      current = InterlockedCompareExchangePointer(
+          (PVOID volatile*)&verified[i], (PVOID)resource, NULL);
+      if (current == NULL) {
+        return true;
+      }
+    }
+#else
+    const void* current = __atomic_load_n(&verified[i], __ATOMIC_ACQUIRE);
+    if (current == NULL && add) {
+      if (__atomic_compare_exchange_n(&verified[i], &current, resource, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return true;
+      }
+    }
+#endif
+    if (current == resource) {
+      return true;
+    }
+    if (current == NULL) {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+// Finds a resource injected with --checksum and checks all of its data,
+// setting `data` and `size` to the data without the checksums, e.g. to pass
+// on to `postject_reader_init()` if it was also compressed. Resources are
+// only checked the first time, later calls for them are as cheap as
+// `postject_find_resource()`. To check a large resource on several threads,
+// use `postject_checksums_init()` and `postject_verify_chunk()` instead.
+// Returns false if the resource isn't found, wasn't injected with --checksum,
+// or is corrupt.
+static inline bool postject_verify_resource(
+    const char* name,
+    const void** data,
+    size_t* size,
+    const struct postject_options* options) {
+  size_t resource_size = 0;
+  struct postject_checksums checksums;
+  *data = NULL;
+  *size = 0;
+
+  const void* resource = postject_find_resource(name, &resource_size, options);
+  if (resource == NULL ||
+      !postject_checksums_init(&checksums, resource, resource_size)) {
+    return false;
+  }
+
+  if (!postject__verified(resource, false)) {
+    for (size_t i = 0; i < checksums.chunk_count; i++) {
+      if (!postject_verify_chunk(&checksums, i)) {
+        return false;
+      }
+    }
+    postject__verified(resource, true);
+  }
+
+  *data = checksums.data;
+  *size = checksums.size;
+  return true;
+}
+
+// Finds a resource and decompresses it into `buffer` if it was injected with
+// --compress, or copies it otherwise. The checksums of resources injected with
+// --checksum are left out, but not checked, see postject_verify_resource(). If
+// `buffer` is NULL, only the size of the decompressed data is stored in
+// `size`. Returns false if the resource isn't found, the buffer is too small,
+// or the data is corrupt.
+static inline bool postject_find_resource_decompressed(
+    const char* name,
+    void* buffer,
+    size_t buffer_size,
+    size_t* size,
+    const struct postject_options* options) {
+  size_t resource_size = 0;
+  struct postject_checksums checksums;
+  struct postject_reader reader;
+  *size = 0;
+
+  const void* data = postject_find_resource(name, &resource_size, options);
+  if (data == NULL) {
+    return false;
+  }
+
+  // The checksums come after the (compressed) data
+  if (postject_checksums_init(&checksums, data, resource_size)) {
+    data = checksums.data;
+    resource_size = checksums.size;
+  }
+
+  if (!postject_reader_init(&reader, data, resource_size)) {
+    return false;
+  }
+
+  const size_t total = postject_reader_remaining(&reader);
+  if (buffer == NULL) {
+    *size = total;
+    return true;
+  }
+  if (buffer_size < total) {
+    return false;
+  }
+
+  // Every chunk but the last one fills `chunk_size` bytes, so each one can be
+  // decompressed straight into its place in the buffer
+  unsigned char* out = (unsigned char*)buffer;
+  size_t written = 0;
+  size_t chunk = 0;
+  do {
+    if (!postject_reader_next(&reader, out + written, total - written,
+                              &chunk)) {
+      return false;
+    }
+    written += chunk;
+  } while (chunk != 0);
+
+  *size = total;
+  return true;
+}
+
+// Hints for `postject_resource_span()` about how the resource will be read
+#define POSTJECT_HINT_WILLNEED 1
+#define POSTJECT_HINT_SEQUENTIAL 2
+
+// The whole pages that a resource occupies in memory
+struct postject_span {
+  const void* data;
+  size_t size;
+};
+
+static inline size_t postject__page_size() {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+  long page_size = sysconf(_SC_PAGESIZE);
+  return page_size > 0 ? (size_t)page_size : 4096;
+#else
+  return 4096;
+#endif
+}
+
+// Rounds a resource found with `postject_find_resource()` out to page
+// boundaries, and passes the `POSTJECT_HINT_*` flags in `hints` on to the OS
+// for those pages, e.g. to start reading a large resource from disk before
+// it's used. Resources injected with `--align <page size>` start on a page
+// boundary, so that the span doesn't cover the end of anything else. Returns
+// false if the OS rejected the hints, in which case `span` is still set.
+static inline bool postject_resource_span(const void* data,
+                                          size_t size,
+                                          unsigned hints,
+                                          struct postject_span* span) {
+  const size_t page_size = postject__page_size();
+  const uintptr_t start = (uintptr_t)data & ~(uintptr_t)(page_size - 1);
+  const uintptr_t end =
+      ((uintptr_t)data + size + page_size - 1) & ~(uintptr_t)(page_size - 1);
+  bool ok = true;
+
+  span->data = (const void*)start;
+  span->size = (size_t)(end - start);
+  if (span->size == 0) {
+    return true;
+  }
+
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+  if (hints & POSTJECT_HINT_SEQUENTIAL) {
+    ok = posix_madvise((void*)start, span->size, POSIX_MADV_SEQUENTIAL) == 0 &&
+         ok;
+  }
+  if (hints & POSTJECT_HINT_WILLNEED) {
+    ok = posix_madvise((void*)start, span->size, POSIX_MADV_WILLNEED) == 0 &&
+         ok;
+  }
+#elif defined(_WIN32) && _WIN32_WINNT >= 0x0602
+  // Windows has no equivalent of the sequential hint
+  if (hints & POSTJECT_HINT_WILLNEED) {
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)start;
+    range.NumberOfBytes = span->size;
+    ok = PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+  }
+#else
+  (void)hints;
+#endif
+
+  return ok;
+}
+
+// Resources injected with --detach are stored after the end of the
+// executable, where the loader doesn't map them, and what's injected as the
+// resource is only a descriptor of where they are. The descriptor is "PJDT",
+// the version, 3 reserved bytes, and the offset and size of the data as
+// little-endian 64-bit integers, and it's repeated right after the data, so
+// that a descriptor that no longer matches the file isn't trusted.
+#define POSTJECT_DETACHED_DESCRIPTOR_SIZE 24
+
+// Unmaps a resource mapped with `postject_map_resource()`
+static inline void postject_unmap_resource(const void* data, size_t size) {
+#if defined(__linux__)
+  munmap((void*)data, size + POSTJECT_DETACHED_DESCRIPTOR_SIZE);
+#elif defined(_WIN32)
+  (void)size;
+  UnmapViewOfFile(data);
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+// Maps a resource injected with --detach from the executable's file, e.g.
+// `/proc/self/exe` on Linux, read-only. The data is only read from disk as
+// it's used and doesn't count towards the executable's own mapping, so large
+// resources only cost memory when they're needed. The data starts on a page
+// boundary, see `postject_resource_span()`. Returns NULL if the resource
+// isn't found, wasn't injected with --detach, or the executable doesn't
+// match its descriptor anymore. The mapping stays valid until it's passed to
+// `postject_unmap_resource()`, with the same size.
+static inline const void* postject_map_resource(
+    const char* name,
+    size_t* size,
+    const struct postject_options* options) {
+  size_t descriptor_size = 0;
+  const unsigned char* descriptor =
+      (const unsigned char*)postject_find_resource(name, &descriptor_size,
+                                                   options);
+  unsigned char* data = NULL;
+
+  if (size != NULL) {
+    *size = 0;
+  }
+
+  if (descriptor == NULL ||
+      descriptor_size != POSTJECT_DETACHED_DESCRIPTOR_SIZE ||
+      memcmp(descriptor, "PJDT", 4) != 0 || descriptor[4] != 1) {
+    return NULL;
+  }
+
+  const uint64_t offset = postject__read_le(descriptor + 8, 8);
+  const uint64_t data_size = postject__read_le(descriptor + 16, 8);
+  if (data_size > SIZE_MAX - POSTJECT_DETACHED_DESCRIPTOR_SIZE) {
+    return NULL;
+  }
+  const size_t length = (size_t)data_size + POSTJECT_DETACHED_DESCRIPTOR_SIZE;
+
+#if defined(__linux__)
+  // Without _FILE_OFFSET_BITS=64, off_t is 32-bit on 32-bit platforms
+  if ((off_t)offset < 0 || (uint64_t)(off_t)offset != offset) {
+    return NULL;
+  }
+
+  int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && (uint64_t)info.st_size >= offset &&
+      (uint64_t)info.st_size - offset >= length) {
+    void* mapping =
+        mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, (off_t)offset);
+    if (mapping != MAP_FAILED) {
+      data = (unsigned char*)mapping;
+    }
+  }
+  close(fd);
+#elif defined(_WIN32)
+  // Paths can be up to 32767 characters long
+  const DWORD path_capacity = 32768;
+  wchar_t* path = (wchar_t*)malloc(path_capacity * sizeof(wchar_t));
+  if (path == NULL) {
+    return NULL;
+  }
+
+  const DWORD path_length = GetModuleFileNameW(NULL, path, path_capacity);
+  HANDLE file = INVALID_HANDLE_VALUE;
+  if (path_length > 0 && path_length < path_capacity) {
+    file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  }
+  free(path);
+  if (file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+
+  LARGE_INTEGER file_size;
+  HANDLE mapping = NULL;
+  if (GetFileSizeEx(file, &file_size) &&
+      (uint64_t)file_size.QuadPart >= offset &&
+      (uint64_t)file_size.QuadPart - offset >= length) {
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  if (mapping != NULL) {
+    data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ,
+                                         (DWORD)(offset >> 32), (DWORD)offset,
+                                         length);
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+#else
+  (void)offset;
+  (void)length;
+#endif
+
+  if (data == NULL) {
+    return NULL;
+  }
+
+  if (memcmp(data + data_size, descriptor, POSTJECT_DETACHED_DESCRIPTOR_SIZE) !=
+      0) {
+    postject_unmap_resource(data, (size_t)data_size);
+    return NULL;
+  }
+
+  if (size != NULL) {
+    *size = (size_t)data_size;
+  }
+  return data;
+}
+
 #endif  // POSTJECT_API_H_
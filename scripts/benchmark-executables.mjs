@@ -0,0 +1,306 @@
+// Generators for the synthetic executables used by scripts/benchmark.mjs.
+// They aren't meant to run, only to be parsed and injected into: each one has
+// `sections` data sections, which together make up most of `size`, holds the
+// default sentinel fuse, and the ELF ones also have `notes` notes.
+
+import { promises as fs } from "fs";
+
+export const SENTINEL_FUSE =
+  "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2:0";
+
+const CHUNK_SIZE = 1024 * 1024;
+
+function align(value, alignment) {
+  return Math.ceil(value / alignment) * alignment;
+}
+
+// Writes `size` bytes of filler at `offset`, in chunks so that large sections
+// don't have to be held in memory
+async function writeFiller(file, offset, size) {
+  const chunk = Buffer.alloc(Math.min(size, CHUNK_SIZE));
+  for (let i = 0; i < chunk.length; i++) {
+    chunk[i] = (i * 31 + (i >> 8)) & 0xff;
+  }
+
+  for (let written = 0; written < size; written += chunk.length) {
+    const length = Math.min(chunk.length, size - written);
+    await file.write(chunk, 0, length, offset + written);
+  }
+}
+
+async function writeExecutable(filename, headers, sections) {
+  const file = await fs.open(filename, "w");
+  try {
+    await file.write(headers, 0, headers.length, 0);
+    for (const { offset, size } of sections) {
+      await writeFiller(file, offset, size);
+    }
+
+    // The fuse goes at the start of the first section
+    const fuse = Buffer.from(SENTINEL_FUSE);
+    await file.write(fuse, 0, fuse.length, sections[0].offset);
+  } finally {
+    await file.close();
+  }
+}
+
+function sectionSizes(size, count, overhead) {
+  const sectionSize = Math.max(
+    align(Math.floor((size - overhead) / count), 16),
+    SENTINEL_FUSE.length
+  );
+  return new Array(count).fill(sectionSize);
+}
+
+export async function generateELF(filename, { size, sections, notes }) {
+  const ehdrSize = 64;
+  const phdrSize = 56;
+  const shdrSize = 64;
+  const baseAddress = 0x400000;
+
+  // Notes named "n<i>", with 16 bytes of description and type 1, so that the
+  // runtime doesn't take them for postject resources
+  const noteEntries = [];
+  for (let i = 0; i < notes; i++) {
+    const name = Buffer.from(`n${i}\0`);
+    const entry = Buffer.alloc(12 + align(name.length, 4) + 16, 0x5a);
+    entry.writeUInt32LE(name.length, 0);
+    entry.writeUInt32LE(16, 4);
+    entry.writeUInt32LE(1, 8);
+    entry.fill(0, 12, 12 + align(name.length, 4));
+    name.copy(entry, 12);
+    noteEntries.push(entry);
+  }
+  const notesBuffer = Buffer.concat(noteEntries);
+
+  const notesOffset = ehdrSize + 2 * phdrSize;
+  let offset = align(notesOffset + notesBuffer.length, 16);
+  const layout = sectionSizes(size, sections, offset).map((sectionSize) => {
+    const section = { offset, size: sectionSize };
+    offset += sectionSize;
+    return section;
+  });
+  const loadEnd = offset;
+
+  const names = ["", ".note.bench", ...layout.map((_, i) => `.s${i}`)];
+  names.push(".shstrtab");
+  const nameOffsets = [];
+  let nameOffset = 0;
+  for (const name of names) {
+    nameOffsets.push(nameOffset);
+    nameOffset += name.length + 1;
+  }
+  const shstrtab = Buffer.from(names.map((name) => name + "\0").join(""));
+  const shstrtabOffset = loadEnd;
+  const shoff = align(shstrtabOffset + shstrtab.length, 8);
+  const shnum = names.length;
+
+  const headers = Buffer.alloc(notesOffset + notesBuffer.length);
+  Buffer.from([0x7f, 0x45, 0x4c, 0x46, 2, 1, 1, 0]).copy(headers, 0);
+  headers.writeUInt16LE(2, 16); // ET_EXEC
+  headers.writeUInt16LE(0x3e, 18); // EM_X86_64
+  headers.writeUInt32LE(1, 20);
+  headers.writeBigUInt64LE(BigInt(baseAddress + layout[0].offset), 24);
+  headers.writeBigUInt64LE(BigInt(ehdrSize), 32);
+  headers.writeBigUInt64LE(BigInt(shoff), 40);
+  headers.writeUInt16LE(ehdrSize, 52);
+  headers.writeUInt16LE(phdrSize, 54);
+  headers.writeUInt16LE(2, 56);
+  headers.writeUInt16LE(shdrSize, 58);
+  headers.writeUInt16LE(shnum, 60);
+  headers.writeUInt16LE(shnum - 1, 62);
+
+  const writePhdr = (index, type, flags, phOffset, phSize, phAlign) => {
+    const p = ehdrSize + index * phdrSize;
+    headers.writeUInt32LE(type, p);
+    headers.writeUInt32LE(flags, p + 4);
+    headers.writeBigUInt64LE(BigInt(phOffset), p + 8);
+    headers.writeBigUInt64LE(BigInt(baseAddress + phOffset), p + 16);
+    headers.writeBigUInt64LE(BigInt(baseAddress + phOffset), p + 24);
+    headers.writeBigUInt64LE(BigInt(phSize), p + 32);
+    headers.writeBigUInt64LE(BigInt(phSize), p + 40);
+    headers.writeBigUInt64LE(BigInt(phAlign), p + 48);
+  };
+  writePhdr(0, 1, 5, 0, loadEnd, 0x1000); // PT_LOAD, R+X
+  writePhdr(1, 4, 4, notesOffset, notesBuffer.length, 4); // PT_NOTE, R
+  notesBuffer.copy(headers, notesOffset);
+
+  const table = Buffer.alloc(shnum * shdrSize);
+  const writeShdr = (index, type, flags, shOffset, shSize, shAlign) => {
+    const p = index * shdrSize;
+    table.writeUInt32LE(nameOffsets[index], p);
+    table.writeUInt32LE(type, p + 4);
+    table.writeBigUInt64LE(BigInt(flags), p + 8);
+    table.writeBigUInt64LE(BigInt(flags ? baseAddress + shOffset : 0), p + 16);
+    table.writeBigUInt64LE(BigInt(shOffset), p + 24);
+    table.writeBigUInt64LE(BigInt(shSize), p + 32);
+    table.writeBigUInt64LE(BigInt(shAlign), p + 48);
+  };
+  writeShdr(1, 7, 2, notesOffset, notesBuffer.length, 4); // SHT_NOTE
+  layout.forEach(({ offset, size }, i) => {
+    writeShdr(i + 2, 1, 2, offset, size, 16); // SHT_PROGBITS, SHF_ALLOC
+  });
+  writeShdr(shnum - 1, 3, 0, shstrtabOffset, shstrtab.length, 1);
+
+  await writeExecutable(filename, headers, layout);
+  const file = await fs.open(filename, "r+");
+  try {
+    await file.write(shstrtab, 0, shstrtab.length, shstrtabOffset);
+    await file.write(table, 0, table.length, shoff);
+  } finally {
+    await file.close();
+  }
+}
+
+export async function generatePE(filename, { size, sections }) {
+  const peOffset = 0x40;
+  const optionalHeaderOffset = peOffset + 4 + 20;
+  const optionalHeaderSize = 240;
+  const sectionTableOffset = optionalHeaderOffset + optionalHeaderSize;
+  const fileAlignment = 0x200;
+  const sectionAlignment = 0x1000;
+  const headersSize = align(sectionTableOffset + sections * 40, fileAlignment);
+
+  let offset = headersSize;
+  let address = sectionAlignment;
+  const layout = sectionSizes(size, sections, headersSize).map(
+    (sectionSize) => {
+      const section = {
+        offset,
+        address,
+        size: align(sectionSize, fileAlignment),
+      };
+      offset += section.size;
+      address += align(section.size, sectionAlignment);
+      return section;
+    }
+  );
+
+  const headers = Buffer.alloc(headersSize);
+  headers.write("MZ", 0, "latin1");
+  headers.writeUInt32LE(peOffset, 0x3c);
+  headers.write("PE\0\0", peOffset, "latin1");
+  headers.writeUInt16LE(0x8664, peOffset + 4); // IMAGE_FILE_MACHINE_AMD64
+  headers.writeUInt16LE(sections, peOffset + 6);
+  headers.writeUInt16LE(optionalHeaderSize, peOffset + 20);
+  headers.writeUInt16LE(0x22, peOffset + 22); // Executable, large address aware
+
+  const o = optionalHeaderOffset;
+  headers.writeUInt16LE(0x20b, o); // PE32+
+  headers.writeUInt32LE(offset - headersSize, o + 8); // SizeOfInitializedData
+  headers.writeUInt32LE(layout[0].address, o + 16); // AddressOfEntryPoint
+  headers.writeUInt32LE(layout[0].address, o + 20); // BaseOfCode
+  headers.writeBigUInt64LE(0x140000000n, o + 24); // ImageBase
+  headers.writeUInt32LE(sectionAlignment, o + 32);
+  headers.writeUInt32LE(fileAlignment, o + 36);
+  headers.writeUInt16LE(6, o + 40); // MajorOperatingSystemVersion
+  headers.writeUInt16LE(6, o + 48); // MajorSubsystemVersion
+  headers.writeUInt32LE(address, o + 56); // SizeOfImage
+  headers.writeUInt32LE(headersSize, o + 60);
+  headers.writeUInt16LE(3, o + 68); // IMAGE_SUBSYSTEM_WINDOWS_CUI
+  headers.writeUInt16LE(0x8160, o + 70); // DllCharacteristics
+  headers.writeBigUInt64LE(0x100000n, o + 72); // SizeOfStackReserve
+  headers.writeBigUInt64LE(0x1000n, o + 80); // SizeOfStackCommit
+  headers.writeBigUInt64LE(0x100000n, o + 88); // SizeOfHeapReserve
+  headers.writeBigUInt64LE(0x1000n, o + 96); // SizeOfHeapCommit
+  headers.writeUInt32LE(16, o + 108); // NumberOfRvaAndSizes
+
+  layout.forEach(({ offset, address, size }, i) => {
+    const p = sectionTableOffset + i * 40;
+    headers.write(`.s${i}`.slice(0, 8), p, "latin1");
+    headers.writeUInt32LE(size, p + 8);
+    headers.writeUInt32LE(address, p + 12);
+    headers.writeUInt32LE(size, p + 16);
+    headers.writeUInt32LE(offset, p + 20);
+    headers.writeUInt32LE(0x40000040, p + 36); // Initialized data, readable
+  });
+
+  await writeExecutable(filename, headers, layout);
+}
+
+export async function generateMachO(filename, { size, sections }) {
+  const headerSize = 32;
+  const segmentSize = 72;
+  const sectionSize = 80;
+  const pageSize = 0x4000;
+  const baseAddress = 0x100000000n;
+
+  // __PAGEZERO, __TEXT with the sections, __LINKEDIT, LC_SYMTAB and LC_MAIN
+  const commandsSize = 3 * segmentSize + sections * sectionSize + 24 + 24;
+  // Leave room for more load commands, as the linker does
+  const dataOffset = align(headerSize + commandsSize + 0x1000, pageSize);
+
+  let offset = dataOffset;
+  const layout = sectionSizes(size, sections, dataOffset).map(
+    (sectionSize) => {
+      const section = { offset, size: sectionSize };
+      offset += sectionSize;
+      return section;
+    }
+  );
+  const textSize = align(offset, pageSize);
+  const linkeditOffset = textSize;
+  const linkeditSize = pageSize;
+
+  const headers = Buffer.alloc(dataOffset);
+  headers.writeUInt32LE(0xfeedfacf, 0); // MH_MAGIC_64
+  headers.writeUInt32LE(0x01000007, 4); // CPU_TYPE_X86_64
+  headers.writeUInt32LE(3, 8); // CPU_SUBTYPE_X86_64_ALL
+  headers.writeUInt32LE(2, 12); // MH_EXECUTE
+  headers.writeUInt32LE(5, 16);
+  headers.writeUInt32LE(commandsSize, 20);
+  headers.writeUInt32LE(0x00200085, 24); // NOUNDEFS, DYLDLINK, TWOLEVEL, PIE
+
+  let p = headerSize;
+  const writeName = (name, at) => headers.write(name, at, 16, "latin1");
+  const writeSegment = (name, vmaddr, vmsize, fileoff, filesize, prot, n) => {
+    headers.writeUInt32LE(0x19, p); // LC_SEGMENT_64
+    headers.writeUInt32LE(segmentSize + n * sectionSize, p + 4);
+    writeName(name, p + 8);
+    headers.writeBigUInt64LE(vmaddr, p + 24);
+    headers.writeBigUInt64LE(BigInt(vmsize), p + 32);
+    headers.writeBigUInt64LE(BigInt(fileoff), p + 40);
+    headers.writeBigUInt64LE(BigInt(filesize), p + 48);
+    headers.writeUInt32LE(prot, p + 56);
+    headers.writeUInt32LE(prot, p + 60);
+    headers.writeUInt32LE(n, p + 64);
+    p += segmentSize;
+  };
+
+  writeSegment("__PAGEZERO", 0n, 0x100000000, 0, 0, 0, 0);
+  writeSegment("__TEXT", baseAddress, textSize, 0, textSize, 5, sections);
+  layout.forEach(({ offset, size }, i) => {
+    writeName(`__s${i}`, p);
+    writeName("__TEXT", p + 16);
+    headers.writeBigUInt64LE(baseAddress + BigInt(offset), p + 32);
+    headers.writeBigUInt64LE(BigInt(size), p + 40);
+    headers.writeUInt32LE(offset, p + 48);
+    headers.writeUInt32LE(4, p + 52);
+    p += sectionSize;
+  });
+  writeSegment(
+    "__LINKEDIT",
+    baseAddress + BigInt(textSize),
+    linkeditSize,
+    linkeditOffset,
+    linkeditSize,
+    1,
+    0
+  );
+
+  headers.writeUInt32LE(0x2, p); // LC_SYMTAB, without symbols
+  headers.writeUInt32LE(24, p + 4);
+  headers.writeUInt32LE(linkeditOffset, p + 8);
+  headers.writeUInt32LE(linkeditOffset, p + 16);
+  headers.writeUInt32LE(1, p + 20);
+  p += 24;
+
+  headers.writeUInt32LE(0x80000028, p); // LC_MAIN
+  headers.writeUInt32LE(24, p + 4);
+  headers.writeBigUInt64LE(BigInt(dataOffset), p + 8);
+
+  await writeExecutable(filename, headers, [
+    ...layout,
+    { offset: linkeditOffset, size: linkeditSize },
+  ]);
+}
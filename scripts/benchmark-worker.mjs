@@ -0,0 +1,101 @@
+// Runs a single injection for scripts/benchmark.mjs, in its own process so
+// that the peak RSS belongs to that injection alone. It goes through the same
+// steps as src/api.js, timing each one, and prints the results as JSON.
+
+import { createRequire } from "module";
+import { performance } from "perf_hooks";
+import { promises as fs } from "fs";
+
+const require = createRequire(import.meta.url);
+
+const { engine, executable, resource, format } = JSON.parse(process.argv[2]);
+const phases = [];
+
+async function phase(name, fn) {
+  const start = performance.now();
+  const result = await fn();
+  phases.push({
+    name,
+    ms: performance.now() - start,
+    rss: process.memoryUsage().rss,
+  });
+  return result;
+}
+
+async function main() {
+  const postject = await phase("load", async () =>
+    engine === "native"
+      ? require("../dist/postject.node")
+      : await require("../build/postject.js")()
+  );
+
+  const data = await phase("read", () => fs.readFile(resource));
+
+  const detected = await phase("detect", () =>
+    postject.getExecutableFormatOfFile(executable)
+  );
+
+  const sentinelFuse = "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2";
+
+  // The fuse is flipped along with the injection, as src/api.js does
+  const { result, sentinelFuseResult, stats } = await phase("inject", () => {
+    switch (detected) {
+      case postject.ExecutableFormat.kELF:
+        return postject.injectManyIntoELFFile(
+          executable,
+          [{ name: "bench", data }],
+          false,
+          executable,
+          sentinelFuse
+        );
+      case postject.ExecutableFormat.kMachO:
+        return postject.injectManyIntoMachOFile(
+          executable,
+          "__POSTJECT",
+          [{ name: "__bench", data }],
+          false,
+          executable,
+          sentinelFuse
+        );
+      case postject.ExecutableFormat.kPE:
+        return postject.injectManyIntoPEFile(
+          executable,
+          [{ name: "BENCH", data }],
+          false,
+          executable,
+          sentinelFuse
+        );
+      default:
+        throw new Error(`${format} executable wasn't recognized`);
+    }
+  });
+
+  if (sentinelFuseResult !== postject.SentinelFuseResult.kSuccess) {
+    throw new Error(
+      `Patching the sentinel fuse failed with ${sentinelFuseResult}`
+    );
+  }
+
+  if (result !== postject.InjectResult.kSuccess) {
+    throw new Error(`Injection failed with ${result}`);
+  }
+
+  // The engine's own breakdown of the injection, e.g. LIEF's parse, build and
+  // fuse
+  phases[phases.length - 1].engine = stats.phases;
+
+  // maxRSS is in kilobytes
+  console.log(
+    JSON.stringify({
+      phases,
+      peakRss: process.resourceUsage().maxRSS * 1024,
+      outputSize: (await fs.stat(executable)).size,
+      bytesWritten: stats.bytesWritten,
+    })
+  );
+}
+
+main().catch((err) => {
+  console.error(err.message);
+  process.exit(1);
+});
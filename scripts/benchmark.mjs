@@ -0,0 +1,157 @@
+#!/usr/bin/env zx
+
+// Benchmarks injection into synthetic ELF, PE and Mach-O executables of
+// various sizes, with resources of various sizes. Each injection runs in its
+// own process, and reports the time and RSS after each phase, as well as the
+// peak RSS. A summary is printed to stderr, and the results are written as
+// JSON lines, one per injection, to stdout or to --output.
+//
+// Options:
+//   --engine native|wasm        Defaults to native when dist/postject.node
+//                               exists
+//   --formats elf,pe,macho
+//   --executable-sizes 1M,32M,200M
+//   --resource-sizes 1K,1M,64M,500M
+//   --sections 64               Data sections in each executable
+//   --notes 64                  Notes in each ELF executable
+//   --runs 1                    Injections per combination
+//   --output <file>
+
+import * as crypto from "crypto";
+import { performance } from "perf_hooks";
+import { fileURLToPath } from "url";
+
+import {
+  generateELF,
+  generateMachO,
+  generatePE,
+} from "./benchmark-executables.mjs";
+
+$.verbose = false;
+
+const generators = { elf: generateELF, pe: generatePE, macho: generateMachO };
+
+function parseSize(size) {
+  const match = /^(\d+)([KMG]?)$/i.exec(String(size).trim());
+  if (!match) {
+    throw new Error(`Invalid size: ${size}`);
+  }
+  const units = { "": 1, K: 1024, M: 1024 ** 2, G: 1024 ** 3 };
+  return Number(match[1]) * units[match[2].toUpperCase()];
+}
+
+function list(value, fallback) {
+  return String(value ?? fallback)
+    .split(",")
+    .map((item) => item.trim())
+    .filter(Boolean);
+}
+
+function formatBytes(bytes) {
+  return `${(bytes / 1024 ** 2).toFixed(1)} MB`;
+}
+
+const scriptsDir = path.dirname(fileURLToPath(import.meta.url));
+const workerScript = path.join(scriptsDir, "benchmark-worker.mjs");
+const engine =
+  argv.engine ??
+  ((await fs.pathExists(path.join(scriptsDir, "../dist/postject.node")))
+    ? "native"
+    : "wasm");
+const formats = list(argv.formats, "elf,pe,macho");
+const executableSizes = list(argv["executable-sizes"], "1M,32M,200M");
+const resourceSizes = list(argv["resource-sizes"], "1K,1M,64M,500M");
+const sections = Number(argv.sections ?? 64);
+const notes = Number(argv.notes ?? 64);
+const runs = Number(argv.runs ?? 1);
+
+for (const format of formats) {
+  if (!generators[format]) {
+    throw new Error(`Unknown format: ${format}`);
+  }
+}
+
+const tempDir = await fs.mkdtemp(path.join(os.tmpdir(), "postject-bench-"));
+const output = argv.output ? fs.createWriteStream(argv.output) : process.stdout;
+
+try {
+  const resources = {};
+  for (const size of resourceSizes) {
+    // Random data, so that the resources are representative of snapshots
+    // and other binary data when compression is involved
+    resources[size] = path.join(tempDir, `resource-${size}`);
+    const file = await fs.open(resources[size], "w");
+    const chunk = crypto.randomBytes(Math.min(parseSize(size), 1024 ** 2));
+    for (let written = 0; written < parseSize(size); ) {
+      const length = Math.min(chunk.length, parseSize(size) - written);
+      await fs.write(file, chunk, 0, length, written);
+      written += length;
+    }
+    await fs.close(file);
+  }
+
+  for (const format of formats) {
+    for (const executableSize of executableSizes) {
+      const original = path.join(tempDir, `${format}-${executableSize}`);
+      await generators[format](original, {
+        size: parseSize(executableSize),
+        sections,
+        notes,
+      });
+
+      for (const resourceSize of resourceSizes) {
+        for (let run = 0; run < runs; run++) {
+          const executable = path.join(tempDir, "executable");
+          await fs.copy(original, executable);
+
+          const start = performance.now();
+          const job = JSON.stringify({
+            engine,
+            executable,
+            resource: resources[resourceSize],
+            format,
+          });
+          const worker = await nothrow($`node ${workerScript} ${job}`);
+          const wallMs = performance.now() - start;
+
+          const record = {
+            engine,
+            format,
+            executableSize: parseSize(executableSize),
+            resourceSize: parseSize(resourceSize),
+            sections,
+            notes: format === "elf" ? notes : 0,
+            run,
+            wallMs,
+          };
+
+          if (worker.exitCode === 0) {
+            Object.assign(record, JSON.parse(worker.stdout));
+          } else {
+            record.error = worker.stderr.trim().split("\n").pop();
+          }
+
+          output.write(JSON.stringify(record) + "\n");
+
+          const phases = (record.phases ?? [])
+            .map(({ name, ms }) => `${name} ${ms.toFixed(1)} ms`)
+            .join(", ");
+          console.error(
+            `${format} ${executableSize} + ${resourceSize}: ` +
+              (record.error
+                ? `error: ${record.error}`
+                : `${wallMs.toFixed(1)} ms, peak RSS ` +
+                  `${formatBytes(record.peakRss)} (${phases})`)
+          );
+        }
+      }
+
+      await fs.remove(original);
+    }
+  }
+} finally {
+  if (output !== process.stdout) {
+    output.end();
+  }
+  await fs.remove(tempDir);
+}
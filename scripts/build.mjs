@@ -28,19 +28,30 @@ if (!(await fs.exists("./build"))) {
 }
 cd("build");
 
-// Build with emsdk
-await $`emcmake cmake -G Ninja ..`;
+// Build with emsdk. With --wasm-file, the WASM binary is kept in its own
+// file rather than embedded in api.js, see POSTJECT_WASM_SINGLE_FILE, and
+// with --memory64 it's built for wasm64, see POSTJECT_WASM_MEMORY64
+const singleFile = argv["wasm-file"] ? "OFF" : "ON";
+const memory64 = argv.memory64 ? "ON" : "OFF";
+await $`emcmake cmake -G Ninja -DPOSTJECT_WASM_SINGLE_FILE=${singleFile} -DPOSTJECT_WASM_MEMORY64=${memory64} ..`;
 await $`cmake --build . -j ${jobs}`;
 
 // Bundle api.js and copy artifacts to dist
 await fs.copy("../src/api.js", "api.js");
-await $`esbuild api.js --bundle --platform=node --outfile=../dist/api.js`;
+await $`esbuild api.js --bundle --platform=node --external:./postject.node --outfile=../dist/api.js`;
 await fs.copy("../src/cli.js", "../dist/cli.js");
 await fs.copy("../postject-api.h", "../dist/postject-api.h");
+if (argv["wasm-file"]) {
+  await fs.copy("postject.wasm", "../dist/postject.wasm");
+} else {
+  // Don't leave a stale binary from a previous build behind
+  await fs.remove("../dist/postject.wasm");
+}
 
 // Repace all occurrences of `__filename` and `__dirname` with "" because
 // Node.js core doesn't support it. These uses are functionally dead when
-// `SINGLE_FILE` is enabled anyways.
+// `SINGLE_FILE` is enabled anyways, and otherwise api.js locates
+// postject.wasm itself.
 // Refs: https://github.com/postmanlabs/postject/issues/50
 // TODO(RaisinTen): Send a PR to emsdk to get rid of these symbols from the
 // affected code paths when `SINGLE_FILE` is enabled.
@@ -48,6 +59,14 @@ const contents = await fs.readFile("../dist/api.js", "utf-8");
 const replaced = contents.replace(/\b__filename\b|\b__dirname\b/g, "''");
 await fs.writeFile("../dist/api.js", replaced);
 
+// Build the native CLI and Node.js addon with --native, the WASM build is
+// used as the fallback when the addon isn't available
+if (argv.native) {
+  await $`cmake -G Ninja -S .. -B native -DCMAKE_BUILD_TYPE=Release`;
+  await $`cmake --build native -j ${jobs}`;
+  await fs.copy("native/postject.node", "../dist/postject.node");
+}
+
 // Build tests
 if (!(await fs.exists("./test"))) {
   await $`mkdir test`;
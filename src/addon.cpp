@@ -0,0 +1,825 @@
+// Native Node.js addon for postject. It exposes the same interface as the
+// WASM build (src/wasm.cpp), so src/api.js can use whichever one is available.
+
+#include <string>
+#include <vector>
+
+#include <node_api.h>
+
+#include "checksum.h"
+#include "compression.h"
+#include "postject.h"
+#include "stamp.h"
+
+#define NAPI_CALL(env, call)                                         \
+  do {                                                               \
+    if ((call) != napi_ok) {                                         \
+      napi_throw_error((env), nullptr, "N-API call failed: " #call); \
+      return nullptr;                                                \
+    }                                                                \
+  } while (0)
+
+namespace {
+
+bool get_buffer(napi_env env, napi_value value, std::vector<uint8_t>* vec) {
+  void* data = nullptr;
+  size_t length = 0;
+  if (napi_get_buffer_info(env, value, &data, &length) != napi_ok) {
+    return false;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  vec->assign(bytes, bytes + length);
+  return true;
+}
+
+bool get_string(napi_env env, napi_value value, std::string* str) {
+  size_t length = 0;
+  if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) {
+    return false;
+  }
+  str->resize(length + 1);
+  if (napi_get_value_string_utf8(env, value, &(*str)[0], str->size(),
+                                 &length) != napi_ok) {
+    return false;
+  }
+  str->resize(length);
+  return true;
+}
+
+napi_value buffer_from_vec(napi_env env, std::vector<uint8_t>* vec) {
+  // Hand the output over to JS without copying it when possible
+  auto* owned = new std::vector<uint8_t>(std::move(*vec));
+  napi_value buffer;
+  napi_status status = napi_create_external_buffer(
+      env, owned->size(), owned->data(),
+      [](napi_env, void*, void* hint) {
+        delete static_cast<std::vector<uint8_t>*>(hint);
+      },
+      owned, &buffer);
+
+  if (status != napi_ok) {
+    // External buffers aren't allowed in every embedder, fall back to a copy
+    status = napi_create_buffer_copy(env, owned->size(), owned->data(),
+                                     nullptr, &buffer);
+    delete owned;
+    if (status != napi_ok) {
+      return nullptr;
+    }
+  }
+
+  return buffer;
+}
+
+// Counterpart of the `ExecutableBuffer` class from the WASM build
+napi_value executable_buffer_constructor(napi_env env,
+                                         napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_value self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, &self, nullptr));
+
+  auto* executable = new std::vector<uint8_t>();
+  if (argc < 1 || !get_buffer(env, argv[0], executable)) {
+    delete executable;
+    napi_throw_type_error(env, nullptr, "executable must be a buffer");
+    return nullptr;
+  }
+
+  NAPI_CALL(env, napi_wrap(
+                     env, self, executable,
+                     [](napi_env, void* data, void*) {
+                       delete static_cast<std::vector<uint8_t>*>(data);
+                     },
+                     nullptr, nullptr));
+  return self;
+}
+
+napi_value executable_buffer_delete(napi_env env, napi_callback_info info) {
+  napi_value self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+
+  void* executable = nullptr;
+  if (napi_remove_wrap(env, self, &executable) == napi_ok) {
+    delete static_cast<std::vector<uint8_t>*>(executable);
+  }
+  return nullptr;
+}
+
+const std::vector<uint8_t>* unwrap_executable(napi_env env, napi_value value) {
+  void* executable = nullptr;
+  if (napi_unwrap(env, value, &executable) != napi_ok) {
+    napi_throw_type_error(env, nullptr,
+                          "executable must be an ExecutableBuffer");
+    return nullptr;
+  }
+  return static_cast<const std::vector<uint8_t>*>(executable);
+}
+
+// `{ phases: [{ name, ms }], bytesWritten }`
+napi_value stats_object(napi_env env, const InjectStats& stats) {
+  napi_value object;
+  napi_value phases;
+  napi_value bytes_written;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  NAPI_CALL(env, napi_create_array_with_length(env, stats.phases.size(),
+                                               &phases));
+  for (size_t i = 0; i < stats.phases.size(); i++) {
+    napi_value phase;
+    napi_value name;
+    napi_value ms;
+    NAPI_CALL(env, napi_create_object(env, &phase));
+    NAPI_CALL(env, napi_create_string_utf8(env, stats.phases[i].name.c_str(),
+                                           NAPI_AUTO_LENGTH, &name));
+    NAPI_CALL(env,
+              napi_create_double(env, stats.phases[i].milliseconds, &ms));
+    NAPI_CALL(env, napi_set_named_property(env, phase, "name", name));
+    NAPI_CALL(env, napi_set_named_property(env, phase, "ms", ms));
+    NAPI_CALL(env, napi_set_element(env, phases, i, phase));
+  }
+  NAPI_CALL(env, napi_set_named_property(env, object, "phases", phases));
+  NAPI_CALL(env, napi_create_double(env,
+                                    static_cast<double>(stats.bytes_written),
+                                    &bytes_written));
+  NAPI_CALL(env, napi_set_named_property(env, object, "bytesWritten",
+                                         bytes_written));
+  return object;
+}
+
+// `{ result, stats }`
+napi_value inject_stats_object(napi_env env,
+                               InjectResult result,
+                               const InjectStats& stats) {
+  napi_value object;
+  napi_value result_value;
+  napi_value stats_value;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  NAPI_CALL(env, napi_create_int32(env, static_cast<int32_t>(result),
+                                   &result_value));
+  NAPI_CALL(env, napi_set_named_property(env, object, "result", result_value));
+  stats_value = stats_object(env, stats);
+  if (stats_value == nullptr) {
+    return nullptr;
+  }
+  NAPI_CALL(env, napi_set_named_property(env, object, "stats", stats_value));
+  return object;
+}
+
+// `{ result, stats, sentinelFuseResult }`, which the file functions return
+napi_value inject_file_result_object(napi_env env,
+                                     InjectResult result,
+                                     const InjectStats& stats,
+                                     SentinelFuseResult fuse_result) {
+  napi_value object = inject_stats_object(env, result, stats);
+  napi_value fuse_result_value;
+  if (object == nullptr) {
+    return nullptr;
+  }
+
+  NAPI_CALL(env, napi_create_int32(env, static_cast<int32_t>(fuse_result),
+                                   &fuse_result_value));
+  NAPI_CALL(env, napi_set_named_property(env, object, "sentinelFuseResult",
+                                         fuse_result_value));
+  return object;
+}
+
+// Unless `sentinel_fuse` is empty, the fuse is flipped before the output is
+// handed over to JS, so it's scanned once, natively
+napi_value inject_result_object(napi_env env,
+                                InjectResult result,
+                                const InjectStats& stats,
+                                const std::string& sentinel_fuse,
+                                std::vector<uint8_t>* output) {
+  napi_value object = inject_stats_object(env, result, stats);
+  napi_value data;
+  if (object == nullptr) {
+    return nullptr;
+  }
+
+  if (result == InjectResult::kSuccess && !sentinel_fuse.empty()) {
+    napi_value fuse_result;
+    NAPI_CALL(env, napi_create_int32(env,
+                                     static_cast<int32_t>(patch_sentinel_fuse(
+                                         output, sentinel_fuse)),
+                                     &fuse_result));
+    NAPI_CALL(env, napi_set_named_property(env, object, "sentinelFuseResult",
+                                           fuse_result));
+  }
+
+  if (result == InjectResult::kSuccess) {
+    data = buffer_from_vec(env, output);
+    if (data == nullptr) {
+      napi_throw_error(env, nullptr, "Couldn't create output buffer");
+      return nullptr;
+    }
+  } else {
+    NAPI_CALL(env, napi_get_undefined(env, &data));
+  }
+  NAPI_CALL(env, napi_set_named_property(env, object, "data", data));
+
+  return object;
+}
+
+napi_value get_executable_format_addon(napi_env env,
+                                       napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  const std::vector<uint8_t>* executable = unwrap_executable(env, argv[0]);
+  if (executable == nullptr) {
+    return nullptr;
+  }
+
+  napi_value format;
+  NAPI_CALL(env, napi_create_int32(env,
+                                   static_cast<int32_t>(
+                                       get_executable_format(*executable)),
+                                   &format));
+  return format;
+}
+
+// Reads an optional byte count, leaving `bytes` as is if it's undefined
+bool get_optional_bytes(napi_env env,
+                        napi_value object,
+                        const char* name,
+                        uint64_t* bytes) {
+  napi_value value;
+  napi_valuetype type;
+  if (napi_get_named_property(env, object, name, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok) {
+    return false;
+  }
+
+  if (type != napi_undefined) {
+    int64_t number = 0;
+    if (napi_get_value_int64(env, value, &number) != napi_ok || number < 0) {
+      return false;
+    }
+    *bytes = static_cast<uint64_t>(number);
+  }
+
+  return true;
+}
+
+// Reads an optional flag, leaving `flag` as is if it's undefined
+bool get_optional_bool(napi_env env,
+                       napi_value object,
+                       const char* name,
+                       bool* flag) {
+  napi_value value;
+  napi_valuetype type;
+  if (napi_get_named_property(env, object, name, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok) {
+    return false;
+  }
+
+  return type == napi_undefined ||
+         napi_get_value_bool(env, value, flag) == napi_ok;
+}
+
+// Reads an optional string, leaving `str` as is if it's undefined
+bool get_optional_string(napi_env env,
+                         napi_value object,
+                         const char* name,
+                         std::string* str) {
+  napi_value value;
+  napi_valuetype type;
+  if (napi_get_named_property(env, object, name, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok) {
+    return false;
+  }
+
+  return type == napi_undefined || get_string(env, value, str);
+}
+
+// Converts an array of `{ name, data, alignment, reserve, detached, file }`
+// objects from JS, where all but `name` are optional, and `data` is only
+// missing for detached resources streamed from `file`. The data is copied
+// into `storage`, which has to outlive the returned resources.
+bool get_resources(napi_env env,
+                   napi_value value,
+                   std::vector<Resource>* resources,
+                   std::vector<std::vector<uint8_t>>* storage) {
+  uint32_t length = 0;
+  if (napi_get_array_length(env, value, &length) != napi_ok) {
+    return false;
+  }
+
+  resources->reserve(length);
+  storage->reserve(length);
+
+  for (uint32_t i = 0; i < length; i++) {
+    napi_value resource;
+    napi_value name;
+    napi_value data;
+    Resource entry;
+    storage->emplace_back();
+
+    if (napi_get_element(env, value, i, &resource) != napi_ok ||
+        napi_get_named_property(env, resource, "name", &name) != napi_ok ||
+        napi_get_named_property(env, resource, "data", &data) != napi_ok ||
+        !get_optional_bytes(env, resource, "alignment", &entry.alignment) ||
+        !get_optional_bytes(env, resource, "reserve", &entry.reserve) ||
+        !get_optional_bool(env, resource, "detached", &entry.detached) ||
+        !get_optional_string(env, resource, "file", &entry.file) ||
+        !get_string(env, name, &entry.name) ||
+        (entry.file.empty() && !get_buffer(env, data, &storage->back()))) {
+      return false;
+    }
+
+    // Streamed resources are only read by the injection, in chunks
+    entry.data = entry.file.empty() ? &storage->back() : nullptr;
+    resources->push_back(entry);
+  }
+
+  return true;
+}
+
+// Shared argument handling for `injectManyIntoELF()` and
+// `injectManyIntoPE()`, which both take
+// `(executable, resources, overwrite, sentinelFuse)`
+template <InjectResult (*InjectMany)(const std::vector<uint8_t>&,
+                                     const std::vector<Resource>&,
+                                     bool,
+                                     std::vector<uint8_t>*,
+                                     InjectStats*)>
+napi_value inject_many(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value argv[4];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  const std::vector<uint8_t>* executable = unwrap_executable(env, argv[0]);
+  if (executable == nullptr) {
+    return nullptr;
+  }
+
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  std::string sentinel_fuse;
+  bool overwrite = false;
+  if (argc < 4 || !get_resources(env, argv[1], &resources, &storage) ||
+      napi_get_value_bool(env, argv[2], &overwrite) != napi_ok ||
+      !get_string(env, argv[3], &sentinel_fuse)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  std::vector<uint8_t> output;
+  InjectStats stats;
+  InjectResult result =
+      InjectMany(*executable, resources, overwrite, &output, &stats);
+  return inject_result_object(env, result, stats, sentinel_fuse, &output);
+}
+
+napi_value inject_many_into_macho_addon(napi_env env,
+                                        napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  const std::vector<uint8_t>* executable = unwrap_executable(env, argv[0]);
+  if (executable == nullptr) {
+    return nullptr;
+  }
+
+  std::string segment_name;
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  std::string sentinel_fuse;
+  bool overwrite = false;
+  if (argc < 5 || !get_string(env, argv[1], &segment_name) ||
+      !get_resources(env, argv[2], &resources, &storage) ||
+      napi_get_value_bool(env, argv[3], &overwrite) != napi_ok ||
+      !get_string(env, argv[4], &sentinel_fuse)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  std::vector<uint8_t> output;
+  InjectStats stats;
+  InjectResult result = inject_many_into_macho(
+      *executable, segment_name, resources, overwrite, &output, &stats);
+  return inject_result_object(env, result, stats, sentinel_fuse, &output);
+}
+
+napi_value get_executable_format_of_file_addon(napi_env env,
+                                               napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  if (argc < 1 || !get_string(env, argv[0], &filename)) {
+    napi_throw_type_error(env, nullptr, "filename must be a string");
+    return nullptr;
+  }
+
+  napi_value format;
+  NAPI_CALL(env, napi_create_int32(env,
+                                   static_cast<int32_t>(
+                                       get_executable_format_of_file(filename)),
+                                   &format));
+  return format;
+}
+
+// Shared argument handling for `injectManyIntoELFFile()` and
+// `injectManyIntoPEFile()`, which both take
+// `(filename, resources, overwrite, outputFilename, sentinelFuse)`
+template <InjectResult (*InjectManyFile)(const std::string&,
+                                         const std::vector<Resource>&,
+                                         bool,
+                                         const std::string&,
+                                         const std::string&,
+                                         SentinelFuseResult*,
+                                         InjectStats*)>
+napi_value inject_many_file(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  bool overwrite = false;
+  std::string output_filename;
+  std::string sentinel_fuse;
+  if (argc < 5 || !get_string(env, argv[0], &filename) ||
+      !get_resources(env, argv[1], &resources, &storage) ||
+      napi_get_value_bool(env, argv[2], &overwrite) != napi_ok ||
+      !get_string(env, argv[3], &output_filename) ||
+      !get_string(env, argv[4], &sentinel_fuse)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+  InjectResult result =
+      InjectManyFile(filename, resources, overwrite, output_filename,
+                     sentinel_fuse, &fuse_result, &stats);
+  return inject_file_result_object(env, result, stats, fuse_result);
+}
+
+napi_value inject_many_into_macho_file_addon(napi_env env,
+                                             napi_callback_info info) {
+  size_t argc = 6;
+  napi_value argv[6];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  std::string segment_name;
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  bool overwrite = false;
+  std::string output_filename;
+  std::string sentinel_fuse;
+  if (argc < 6 || !get_string(env, argv[0], &filename) ||
+      !get_string(env, argv[1], &segment_name) ||
+      !get_resources(env, argv[2], &resources, &storage) ||
+      napi_get_value_bool(env, argv[3], &overwrite) != napi_ok ||
+      !get_string(env, argv[4], &output_filename) ||
+      !get_string(env, argv[5], &sentinel_fuse)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+  InjectResult result = inject_many_into_macho_file(
+      filename, segment_name, resources, overwrite, output_filename,
+      sentinel_fuse, &fuse_result, &stats);
+  return inject_file_result_object(env, result, stats, fuse_result);
+}
+
+// `(filename, segmentName, resources, sentinelFuse, templateFilename)`, where
+// the `reserve` of each resource is its capacity. Returns
+// `{ result, sentinelFuseResult }`, and only writes the template when both
+// succeeded.
+napi_value create_injection_template_addon(napi_env env,
+                                           napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  std::string segment_name;
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  std::string sentinel_fuse;
+  std::string template_filename;
+  if (argc < 5 || !get_string(env, argv[0], &filename) ||
+      !get_string(env, argv[1], &segment_name) ||
+      !get_resources(env, argv[2], &resources, &storage) ||
+      !get_string(env, argv[3], &sentinel_fuse) ||
+      !get_string(env, argv[4], &template_filename)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  InjectionTemplate tmpl;
+  InjectResult result =
+      create_injection_template(filename, segment_name, resources, &tmpl);
+  SentinelFuseResult fuse_result = SentinelFuseResult::kError;
+  if (result == InjectResult::kSuccess) {
+    fuse_result = patch_sentinel_fuse(&tmpl.executable, sentinel_fuse);
+    if (fuse_result == SentinelFuseResult::kSuccess &&
+        !write_injection_template(tmpl, template_filename)) {
+      result = InjectResult::kError;
+    }
+  }
+
+  napi_value object;
+  napi_value result_value;
+  napi_value fuse_result_value;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  NAPI_CALL(env, napi_create_int32(env, static_cast<int32_t>(result),
+                                   &result_value));
+  NAPI_CALL(env, napi_create_int32(env, static_cast<int32_t>(fuse_result),
+                                   &fuse_result_value));
+  NAPI_CALL(env, napi_set_named_property(env, object, "result", result_value));
+  NAPI_CALL(env, napi_set_named_property(env, object, "sentinelFuseResult",
+                                         fuse_result_value));
+  return object;
+}
+
+napi_value get_injection_template_format_addon(napi_env env,
+                                               napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string template_filename;
+  if (argc < 1 || !get_string(env, argv[0], &template_filename)) {
+    napi_throw_type_error(env, nullptr, "filename must be a string");
+    return nullptr;
+  }
+
+  napi_value format;
+  NAPI_CALL(env, napi_create_int32(env,
+                                   static_cast<int32_t>(
+                                       get_injection_template_format(
+                                           template_filename)),
+                                   &format));
+  return format;
+}
+
+// `(templateFilename, resources, outputFilename)`
+napi_value stamp_injection_template_addon(napi_env env,
+                                          napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string template_filename;
+  std::vector<Resource> resources;
+  std::vector<std::vector<uint8_t>> storage;
+  std::string output_filename;
+  if (argc < 3 || !get_string(env, argv[0], &template_filename) ||
+      !get_resources(env, argv[1], &resources, &storage) ||
+      !get_string(env, argv[2], &output_filename)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(
+                     env,
+                     static_cast<int32_t>(stamp_injection_template(
+                         template_filename, resources, output_filename)),
+                     &result));
+  return result;
+}
+
+// `(filename, segmentName)`, returns `[{ name, offset, size, detached }]`, or
+// null if the file can't be read or isn't an executable
+napi_value list_resources_in_file_addon(napi_env env,
+                                        napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  std::string segment_name;
+  if (argc < 2 || !get_string(env, argv[0], &filename) ||
+      !get_string(env, argv[1], &segment_name)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  std::vector<ResourceInfo> resources;
+  napi_value array;
+  if (!list_resources_in_file(filename, segment_name, &resources)) {
+    NAPI_CALL(env, napi_get_null(env, &array));
+    return array;
+  }
+
+  NAPI_CALL(env,
+            napi_create_array_with_length(env, resources.size(), &array));
+  for (size_t i = 0; i < resources.size(); i++) {
+    napi_value entry;
+    napi_value name;
+    napi_value offset;
+    napi_value size;
+    napi_value detached;
+    NAPI_CALL(env, napi_create_object(env, &entry));
+    NAPI_CALL(env, napi_create_string_utf8(env, resources[i].name.c_str(),
+                                           NAPI_AUTO_LENGTH, &name));
+    NAPI_CALL(env, napi_create_double(
+                       env, static_cast<double>(resources[i].offset), &offset));
+    NAPI_CALL(env, napi_create_double(
+                       env, static_cast<double>(resources[i].size), &size));
+    NAPI_CALL(env, napi_get_boolean(env, resources[i].detached, &detached));
+    NAPI_CALL(env, napi_set_named_property(env, entry, "name", name));
+    NAPI_CALL(env, napi_set_named_property(env, entry, "offset", offset));
+    NAPI_CALL(env, napi_set_named_property(env, entry, "size", size));
+    NAPI_CALL(env, napi_set_named_property(env, entry, "detached", detached));
+    NAPI_CALL(env, napi_set_element(env, array, i, entry));
+  }
+  return array;
+}
+
+// `(filename, segmentName, name, outputFilename)`
+napi_value extract_resource_from_file_addon(napi_env env,
+                                            napi_callback_info info) {
+  size_t argc = 4;
+  napi_value argv[4];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::string filename;
+  std::string segment_name;
+  std::string name;
+  std::string output_filename;
+  if (argc < 4 || !get_string(env, argv[0], &filename) ||
+      !get_string(env, argv[1], &segment_name) ||
+      !get_string(env, argv[2], &name) ||
+      !get_string(env, argv[3], &output_filename)) {
+    napi_throw_type_error(env, nullptr, "Invalid arguments");
+    return nullptr;
+  }
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(
+                     env,
+                     static_cast<int32_t>(extract_resource_from_file(
+                         filename, segment_name, name, output_filename)),
+                     &result));
+  return result;
+}
+
+napi_value compress_resource_addon(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::vector<uint8_t> data;
+  if (argc < 1 || !get_buffer(env, argv[0], &data)) {
+    napi_throw_type_error(env, nullptr, "data must be a buffer");
+    return nullptr;
+  }
+
+  std::vector<uint8_t> compressed = compress_resource(data);
+  napi_value buffer = buffer_from_vec(env, &compressed);
+  if (buffer == nullptr) {
+    napi_throw_error(env, nullptr, "Couldn't create output buffer");
+  }
+  return buffer;
+}
+
+napi_value checksum_resource_addon(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+  std::vector<uint8_t> data;
+  if (argc < 1 || !get_buffer(env, argv[0], &data)) {
+    napi_throw_type_error(env, nullptr, "data must be a buffer");
+    return nullptr;
+  }
+
+  std::vector<uint8_t> checksummed = add_resource_checksum(data);
+  napi_value buffer = buffer_from_vec(env, &checksummed);
+  if (buffer == nullptr) {
+    napi_throw_error(env, nullptr, "Couldn't create output buffer");
+  }
+  return buffer;
+}
+
+napi_value create_enum(napi_env env,
+                       const std::vector<std::pair<const char*, int32_t>>&
+                           values) {
+  napi_value object;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  for (const auto& value : values) {
+    napi_value number;
+    NAPI_CALL(env, napi_create_int32(env, value.second, &number));
+    NAPI_CALL(env,
+              napi_set_named_property(env, object, value.first, number));
+  }
+  return object;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  napi_value executable_format = create_enum(
+      env, {{"kELF", static_cast<int32_t>(ExecutableFormat::kELF)},
+            {"kMachO", static_cast<int32_t>(ExecutableFormat::kMachO)},
+            {"kPE", static_cast<int32_t>(ExecutableFormat::kPE)},
+            {"kUnknown", static_cast<int32_t>(ExecutableFormat::kUnknown)}});
+  napi_value inject_result = create_enum(
+      env,
+      {{"kAlreadyExists", static_cast<int32_t>(InjectResult::kAlreadyExists)},
+       {"kError", static_cast<int32_t>(InjectResult::kError)},
+       {"kSuccess", static_cast<int32_t>(InjectResult::kSuccess)},
+       {"kTooLarge", static_cast<int32_t>(InjectResult::kTooLarge)}});
+  napi_value sentinel_fuse_result = create_enum(
+      env,
+      {{"kSuccess", static_cast<int32_t>(SentinelFuseResult::kSuccess)},
+       {"kNotFound", static_cast<int32_t>(SentinelFuseResult::kNotFound)},
+       {"kMultipleFound",
+        static_cast<int32_t>(SentinelFuseResult::kMultipleFound)},
+       {"kInvalidValue",
+        static_cast<int32_t>(SentinelFuseResult::kInvalidValue)},
+       {"kError", static_cast<int32_t>(SentinelFuseResult::kError)}});
+  napi_value stamp_result = create_enum(
+      env,
+      {{"kSuccess", static_cast<int32_t>(StampResult::kSuccess)},
+       {"kUnknownResource",
+        static_cast<int32_t>(StampResult::kUnknownResource)},
+       {"kTooLarge", static_cast<int32_t>(StampResult::kTooLarge)},
+       {"kError", static_cast<int32_t>(StampResult::kError)}});
+  napi_value extract_result = create_enum(
+      env, {{"kSuccess", static_cast<int32_t>(ExtractResult::kSuccess)},
+            {"kNotFound", static_cast<int32_t>(ExtractResult::kNotFound)},
+            {"kError", static_cast<int32_t>(ExtractResult::kError)}});
+  if (executable_format == nullptr || inject_result == nullptr ||
+      sentinel_fuse_result == nullptr || stamp_result == nullptr ||
+      extract_result == nullptr) {
+    return nullptr;
+  }
+
+  napi_property_descriptor buffer_methods[] = {
+      {"delete", nullptr, executable_buffer_delete, nullptr, nullptr, nullptr,
+       napi_default, nullptr},
+  };
+  napi_value executable_buffer;
+  NAPI_CALL(env, napi_define_class(env, "ExecutableBuffer", NAPI_AUTO_LENGTH,
+                                   executable_buffer_constructor, nullptr, 1,
+                                   buffer_methods, &executable_buffer));
+
+  napi_property_descriptor properties[] = {
+      {"ExecutableFormat", nullptr, nullptr, nullptr, nullptr,
+       executable_format, napi_enumerable, nullptr},
+      {"InjectResult", nullptr, nullptr, nullptr, nullptr, inject_result,
+       napi_enumerable, nullptr},
+      {"SentinelFuseResult", nullptr, nullptr, nullptr, nullptr,
+       sentinel_fuse_result, napi_enumerable, nullptr},
+      {"StampResult", nullptr, nullptr, nullptr, nullptr, stamp_result,
+       napi_enumerable, nullptr},
+      {"ExtractResult", nullptr, nullptr, nullptr, nullptr, extract_result,
+       napi_enumerable, nullptr},
+      {"ExecutableBuffer", nullptr, nullptr, nullptr, nullptr,
+       executable_buffer, napi_enumerable, nullptr},
+      {"getExecutableFormat", nullptr, get_executable_format_addon, nullptr,
+       nullptr, nullptr, napi_enumerable, nullptr},
+      {"injectManyIntoELF", nullptr, inject_many<inject_many_into_elf>,
+       nullptr, nullptr, nullptr, napi_enumerable, nullptr},
+      {"injectManyIntoMachO", nullptr, inject_many_into_macho_addon, nullptr,
+       nullptr, nullptr, napi_enumerable, nullptr},
+      {"injectManyIntoPE", nullptr, inject_many<inject_many_into_pe>, nullptr,
+       nullptr, nullptr, napi_enumerable, nullptr},
+      {"getExecutableFormatOfFile", nullptr,
+       get_executable_format_of_file_addon, nullptr, nullptr, nullptr,
+       napi_enumerable, nullptr},
+      {"injectManyIntoELFFile", nullptr,
+       inject_many_file<inject_many_into_elf_file>, nullptr, nullptr, nullptr,
+       napi_enumerable, nullptr},
+      {"injectManyIntoMachOFile", nullptr, inject_many_into_macho_file_addon,
+       nullptr, nullptr, nullptr, napi_enumerable, nullptr},
+      {"injectManyIntoPEFile", nullptr,
+       inject_many_file<inject_many_into_pe_file>, nullptr, nullptr, nullptr,
+       napi_enumerable, nullptr},
+      {"createInjectionTemplate", nullptr, create_injection_template_addon,
+       nullptr, nullptr, nullptr, napi_enumerable, nullptr},
+      {"getInjectionTemplateFormat", nullptr,
+       get_injection_template_format_addon, nullptr, nullptr, nullptr,
+       napi_enumerable, nullptr},
+      {"stampInjectionTemplate", nullptr, stamp_injection_template_addon,
+       nullptr, nullptr, nullptr, napi_enumerable, nullptr},
+      {"listResourcesInFile", nullptr, list_resources_in_file_addon, nullptr,
+       nullptr, nullptr, napi_enumerable, nullptr},
+      {"extractResourceFromFile", nullptr, extract_resource_from_file_addon,
+       nullptr, nullptr, nullptr, napi_enumerable, nullptr},
+      {"compressResource", nullptr, compress_resource_addon, nullptr, nullptr,
+       nullptr, napi_enumerable, nullptr},
+      {"checksumResource", nullptr, checksum_resource_addon, nullptr, nullptr,
+       nullptr, napi_enumerable, nullptr},
+  };
+  NAPI_CALL(env, napi_define_properties(
+                     env, exports, sizeof(properties) / sizeof(*properties),
+                     properties));
+
+  return exports;
+}
+
+}  // namespace
+
+NAPI_MODULE(postject, init)
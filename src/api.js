@@ -1,17 +1,223 @@
 const { constants, promises: fs } = require("fs");
+const os = require("os");
 const path = require("path");
+const { performance } = require("perf_hooks");
+const {
+  Worker,
+  isMainThread,
+  parentPort,
+  workerData,
+} = require("worker_threads");
 
-const loadPostjectModule = require("./postject.js");
+const loadWasmModule = require("./postject.js");
+
+// Builds without SINGLE_FILE keep the WASM binary in postject.wasm next to
+// this file, rather than embedded in it as base64, which is compiled directly.
+// The workers of `injectAll()` are handed the module the main thread compiled.
+async function compileWasmBinary() {
+  if (!isMainThread && workerData?.postjectWasmModule) {
+    return workerData.postjectWasmModule;
+  }
+
+  let binary;
+  try {
+    binary = await fs.readFile(
+      path.join(path.dirname(module.filename), "postject.wasm")
+    );
+  } catch {
+    return null;
+  }
+
+  return await WebAssembly.compile(binary);
+}
+
+async function instantiatePostjectModule() {
+  // Prefer the native addon when it was built, it's considerably faster and
+  // isn't limited by the WASM heap
+  try {
+    return { engine: "native", postject: require("./postject.node") };
+  } catch {
+    const wasmModule = await compileWasmBinary();
+    const options = wasmModule
+      ? {
+          instantiateWasm(imports, receiveInstance) {
+            WebAssembly.instantiate(wasmModule, imports).then((instance) =>
+              receiveInstance(instance, wasmModule)
+            );
+            return {};
+          },
+        }
+      : {};
+
+    return {
+      engine: "wasm",
+      postject: await loadWasmModule(options),
+      wasmModule,
+    };
+  }
+}
+
+// Instantiating the WASM build means compiling it and allocating its initial
+// heap, so it's only done once per process, and every injection reuses the
+// module and the memory the previous ones freed
+let postjectModule = null;
+
+function loadPostjectModule() {
+  if (!postjectModule) {
+    postjectModule = instantiatePostjectModule().catch((err) => {
+      // Let the next call try again
+      postjectModule = null;
+      throw err;
+    });
+  }
+  return postjectModule;
+}
+
+// Records how long each step of an injection takes, for `options.timings`
+class Timings {
+  constructor() {
+    this.phases = [];
+    this.start = performance.now();
+    this.last = this.start;
+  }
+
+  // Ends the current phase, which began when the previous one ended
+  phase(name) {
+    const now = performance.now();
+    this.phases.push({ name, ms: now - this.last });
+    this.last = now;
+  }
+
+  // Splits the time since the previous phase into the phases the engine
+  // measured itself, leaving the remainder to `name`
+  engine(name, stats) {
+    const now = performance.now();
+    const engineMs = stats.phases.reduce((sum, { ms }) => sum + ms, 0);
+    this.phases.push(...stats.phases);
+    this.phases.push({ name, ms: Math.max(now - this.last - engineMs, 0) });
+    this.last = now;
+  }
+
+  get totalMs() {
+    return this.last - this.start;
+  }
+}
+
+// The name a resource is stored under in the given format
+function formatResourceName(postject, executableFormat, name) {
+  switch (executableFormat) {
+    case postject.ExecutableFormat.kMachO:
+      // Mach-O section names are conventionally of the style __foo
+      return name.startsWith("__") ? name : `__${name}`;
+
+    case postject.ExecutableFormat.kPE:
+      // PE resource names appear to only work if uppercase
+      return name.toUpperCase();
+
+    default:
+      // ELF sections usually start with a dot ("."), but this is
+      // technically reserved for the system, so don't transform
+      return name;
+  }
+}
+
+function checkResourceNames(resources) {
+  if (!Array.isArray(resources) || resources.length === 0) {
+    throw new TypeError("resources must be a non-empty array");
+  }
+
+  const resourceNames = new Set();
+
+  for (const { name } of resources) {
+    if (typeof name !== "string") {
+      throw new TypeError("resource name must be a string");
+    }
+
+    if (resourceNames.has(name)) {
+      throw new Error(`Resource ${name} is specified more than once`);
+    }
+    resourceNames.add(name);
+  }
+}
+
+function checkSentinelFuseResult(postject, result, sentinelFuse) {
+  switch (result) {
+    case postject.SentinelFuseResult.kSuccess:
+      return;
+
+    case postject.SentinelFuseResult.kNotFound:
+      throw new Error(
+        `Could not find the sentinel ${sentinelFuse} in the binary`
+      );
+
+    case postject.SentinelFuseResult.kMultipleFound:
+      throw new Error(
+        `Multiple occurences of sentinel "${sentinelFuse}" found in the binary`
+      );
+
+    case postject.SentinelFuseResult.kInvalidValue:
+      throw new Error(
+        `Value after the sentinel "${sentinelFuse}" must be ':0' or ':1'`
+      );
+
+    default:
+      throw new Error("Couldn't write executable");
+  }
+}
 
 async function inject(filename, resourceName, resourceData, options) {
+  if (!Buffer.isBuffer(resourceData)) {
+    throw new TypeError("resourceData must be a buffer");
+  }
+
+  return await injectMany(
+    filename,
+    [{ name: resourceName, data: resourceData }],
+    options
+  );
+}
+
+async function injectMany(filename, resources, options) {
   const machoSegmentName = options?.machoSegmentName || "__POSTJECT";
   const overwrite = options?.overwrite || false;
+  const compress = options?.compress || false;
+  const checksum = options?.checksum || false;
+  const align = options?.align || 0;
+  const reserve = options?.reserve || 0;
+  const detach = options?.detach || false;
+  const timings = options?.timings ? new Timings() : null;
   let sentinelFuse =
     options?.sentinelFuse ||
     "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2";
 
-  if (!Buffer.isBuffer(resourceData)) {
-    throw new TypeError("resourceData must be a buffer");
+  if (
+    !Number.isSafeInteger(align) ||
+    (align !== 0 && !Number.isInteger(Math.log2(align)))
+  ) {
+    throw new TypeError("align must be a power of two");
+  }
+
+  if (!Number.isSafeInteger(reserve) || reserve < 0) {
+    throw new TypeError("reserve must be a number of bytes");
+  }
+
+  checkResourceNames(resources);
+
+  for (const { data, file } of resources) {
+    // Detached resources can be given as a file instead, which the engine
+    // streams into the executable without holding it in memory
+    if (file !== undefined) {
+      if (typeof file !== "string" || !detach || compress || checksum) {
+        throw new TypeError(
+          "Only detached resources that aren't compressed or checksummed can be given as a file"
+        );
+      }
+      continue;
+    }
+
+    if (!Buffer.isBuffer(data)) {
+      throw new TypeError("resourceData must be a buffer");
+    }
   }
 
   try {
@@ -20,16 +226,59 @@ async function inject(filename, resourceName, resourceData, options) {
     throw new Error("Can't read and write to target executable");
   }
 
-  let executable;
+  const { engine, postject } = await loadPostjectModule();
+  timings?.phase("load");
 
-  const postject = await loadPostjectModule();
+  const bytesCopied = resources.reduce(
+    (sum, { data }) => sum + (data ? data.length : 0),
+    0
+  );
 
-  try {
-    executable = await fs.readFile(filename);
-  } catch {
-    throw new Error("Couldn't read target executable");
+  if (compress) {
+    // Stored as chunked LZ4, which postject_find_resource_decompressed() in
+    // postject-api.h decompresses at runtime
+    resources = resources.map(({ name, data }) => ({
+      name,
+      data: postject.compressResource(data),
+    }));
+    timings?.phase("compress");
+  }
+
+  if (checksum) {
+    // CRC32C of every chunk of the data as stored, which
+    // postject_verify_resource() in postject-api.h checks at runtime
+    resources = resources.map(({ name, data }) => ({
+      name,
+      data: postject.checksumResource(data),
+    }));
+    timings?.phase("checksum");
+  }
+
+  if (align) {
+    // Only ELF supports the alignment for now, see postject_resource_span() in
+    // postject-api.h for what it's useful for
+    resources = resources.map((resource) => ({
+      ...resource,
+      alignment: align,
+    }));
+  }
+
+  if (reserve) {
+    // Room for overwriting the resources in place later, see `overwrite`
+    resources = resources.map((resource) => ({ ...resource, reserve }));
+  }
+
+  if (detach) {
+    // Stored after the end of the executable rather than in the loaded image,
+    // see postject_map_resource() in postject-api.h
+    resources = resources.map((resource) => ({ ...resource, detached: true }));
   }
-  const executableFormat = postject.getExecutableFormat(executable);
+
+  // The executable is read and written by the engine directly, rather than
+  // being passed back and forth as buffers, so that only about one copy of it
+  // is held in memory
+  const executableFormat = postject.getExecutableFormatOfFile(filename);
+  timings?.phase("detect");
 
   if (executableFormat === postject.ExecutableFormat.kUnknown) {
     throw new Error(
@@ -37,30 +286,42 @@ async function inject(filename, resourceName, resourceData, options) {
     );
   }
 
-  let data;
+  if (detach && executableFormat === postject.ExecutableFormat.kMachO) {
+    throw new Error("detach is only supported for ELF and PE executables");
+  }
+
+  if (align && executableFormat !== postject.ExecutableFormat.kELF) {
+    throw new Error("align is only supported for ELF executables");
+  }
+
   let result;
+  let sentinelFuseResult;
+  let stats;
+
+  resources = resources.map((resource) => ({
+    ...resource,
+    name: formatResourceName(postject, executableFormat, resource.name),
+  }));
 
   switch (executableFormat) {
     case postject.ExecutableFormat.kMachO:
       {
-        let sectionName = resourceName;
-
-        // Mach-O section names are conventionally of the style __foo
-        if (!sectionName.startsWith("__")) {
-          sectionName = `__${sectionName}`;
-        }
-
-        ({ result, data } = postject.injectIntoMachO(
-          executable,
-          machoSegmentName,
-          sectionName,
-          resourceData,
-          overwrite
-        ));
+        ({ result, sentinelFuseResult, stats } =
+          postject.injectManyIntoMachOFile(
+            filename,
+            machoSegmentName,
+            resources,
+            overwrite,
+            filename,
+            sentinelFuse
+          ));
 
         if (result === postject.InjectResult.kAlreadyExists) {
+          const sectionNames = resources
+            .map(({ name }) => `${machoSegmentName}/${name}`)
+            .join(", ");
           throw new Error(
-            `Segment and section with that name already exists: ${machoSegmentName}/${sectionName}\n` +
+            `Segment and section with that name already exists: ${sectionNames}\n` +
               "Use --overwrite to overwrite the existing content"
           );
         }
@@ -69,20 +330,19 @@ async function inject(filename, resourceName, resourceData, options) {
 
     case postject.ExecutableFormat.kELF:
       {
-        // ELF sections usually start with a dot ("."), but this is
-        // technically reserved for the system, so don't transform
-        let sectionName = resourceName;
-
-        ({ result, data } = postject.injectIntoELF(
-          executable,
-          sectionName,
-          resourceData,
-          overwrite
-        ));
+        ({ result, sentinelFuseResult, stats } =
+          postject.injectManyIntoELFFile(
+            filename,
+            resources,
+            overwrite,
+            filename,
+            sentinelFuse
+          ));
 
         if (result === postject.InjectResult.kAlreadyExists) {
+          const sectionNames = resources.map(({ name }) => name).join(", ");
           throw new Error(
-            `Section with that name already exists: ${sectionName}` +
+            `Section with that name already exists: ${sectionNames}` +
               "Use --overwrite to overwrite the existing content"
           );
         }
@@ -91,19 +351,19 @@ async function inject(filename, resourceName, resourceData, options) {
 
     case postject.ExecutableFormat.kPE:
       {
-        // PE resource names appear to only work if uppercase
-        resourceName = resourceName.toUpperCase();
-
-        ({ result, data } = postject.injectIntoPE(
-          executable,
-          resourceName,
-          resourceData,
-          overwrite
-        ));
+        ({ result, sentinelFuseResult, stats } =
+          postject.injectManyIntoPEFile(
+            filename,
+            resources,
+            overwrite,
+            filename,
+            sentinelFuse
+          ));
 
         if (result === postject.InjectResult.kAlreadyExists) {
+          const resourceNames = resources.map(({ name }) => name).join(", ");
           throw new Error(
-            `Resource with that name already exists: ${resourceName}\n` +
+            `Resource with that name already exists: ${resourceNames}\n` +
               "Use --overwrite to overwrite the existing content"
           );
         }
@@ -111,53 +371,414 @@ async function inject(filename, resourceName, resourceData, options) {
       break;
   }
 
+  if (result === postject.InjectResult.kTooLarge) {
+    throw new Error(
+      "Resource is too large for the executable format, use detach for resources of 4 GB or more"
+    );
+  }
+
+  // The engine flips the fuse along with the injection, after making sure it
+  // can before writing anything, so the executable is left as it was if not
+  checkSentinelFuseResult(postject, sentinelFuseResult, sentinelFuse);
+
   if (result !== postject.InjectResult.kSuccess) {
     throw new Error("Error when injecting resource");
   }
 
-  const buffer = Buffer.from(data.buffer);
-  const firstSentinel = buffer.indexOf(sentinelFuse);
+  // Whatever the engine didn't account for, e.g. converting the resources
+  timings?.engine("inject", stats);
 
-  if (firstSentinel === -1) {
-    throw new Error(
-      `Could not find the sentinel ${sentinelFuse} in the binary`
-    );
+  if (!timings) {
+    return;
   }
 
-  const lastSentinel = buffer.lastIndexOf(sentinelFuse);
+  // The WASM memory only grows, so its size is the peak of the WASM heap since
+  // the module was loaded, while the native addon shares the process's heap
+  // (maxRSS is in kilobytes)
+  return {
+    engine,
+    phases: timings.phases,
+    totalMs: timings.totalMs,
+    bytesCopied,
+    bytesWritten: stats.bytesWritten,
+    peakHeap:
+      engine === "wasm"
+        ? postject.getHeapSize()
+        : process.resourceUsage().maxRSS * 1024,
+  };
+}
+
+// A worker thread with its own postject module, which runs `injectMany()` on
+// the jobs it's given, one at a time
+class InjectionWorker {
+  constructor(wasmModule) {
+    this.worker = new Worker(module.filename, {
+      workerData: {
+        postjectInjectionWorker: true,
+        postjectWasmModule: wasmModule,
+      },
+    });
+    this.pending = null;
+    this.failure = null;
 
-  if (firstSentinel !== lastSentinel) {
-    throw new Error(
-      `Multiple occurences of sentinel "${sentinelFuse}" found in the binary`
+    this.worker.on("message", ({ report, error }) => {
+      const { resolve, reject } = this.pending;
+      this.pending = null;
+      if (error === undefined) {
+        resolve(report);
+      } else {
+        reject(new Error(error));
+      }
+    });
+    this.worker.on("error", (err) => this.fail(err));
+    this.worker.on("exit", () =>
+      this.fail(new Error("Injection worker exited unexpectedly"))
     );
   }
 
-  const colonIndex = firstSentinel + sentinelFuse.length;
-  if (buffer[colonIndex] !== ":".charCodeAt(0)) {
-    throw new Error(
-      `Value at index ${colonIndex} must be ':' but '${buffer[
-        colonIndex
-      ].charCodeAt(0)}' was found`
-    );
+  fail(err) {
+    this.failure = this.failure || err;
+    this.pending?.reject(this.failure);
+    this.pending = null;
   }
 
-  const hasResourceIndex = firstSentinel + sentinelFuse.length + 1;
-  const hasResourceValue = buffer[hasResourceIndex];
-  if (hasResourceValue === "0".charCodeAt(0)) {
-    buffer[hasResourceIndex] = "1".charCodeAt(0);
-  } else if (hasResourceValue != "1".charCodeAt(0)) {
+  run({ filename, resources, options }) {
+    if (this.failure) {
+      return Promise.reject(this.failure);
+    }
+
+    return new Promise((resolve, reject) => {
+      this.pending = { resolve, reject };
+      this.worker.postMessage({ filename, resources, options });
+    });
+  }
+
+  async terminate() {
+    this.failure = this.failure || new Error("Injection worker terminated");
+    await this.worker.terminate();
+  }
+}
+
+// Runs in the workers of `injectAll()`, see `InjectionWorker`
+function runInjectionWorker() {
+  parentPort.on("message", async ({ filename, resources, options }) => {
+    try {
+      // Buffers arrive as plain Uint8Arrays, and resources streamed from a
+      // file have no data at all
+      resources = resources.map(({ data, ...resource }) => ({
+        ...resource,
+        data: data
+          ? Buffer.from(data.buffer, data.byteOffset, data.byteLength)
+          : undefined,
+      }));
+      parentPort.postMessage({
+        report: await injectMany(filename, resources, options),
+      });
+    } catch (err) {
+      parentPort.postMessage({ error: err.message });
+    }
+  });
+}
+
+// Runs `injectMany()` for each of `jobs`, given as `{ filename, resources,
+// options }`, on a pool of `options.concurrency` worker threads. The rest of
+// `options` are the defaults for the jobs' options. Resolves to the reports of
+// the jobs, in order, or rejects with the first job that failed, once the
+// others already running are done.
+async function injectAll(jobs, options) {
+  const { concurrency = os.cpus().length, ...defaults } = options || {};
+
+  if (!Array.isArray(jobs)) {
+    throw new TypeError("jobs must be an array");
+  }
+
+  if (!Number.isSafeInteger(concurrency) || concurrency < 1) {
+    throw new TypeError("concurrency must be a positive integer");
+  }
+
+  for (const job of jobs) {
+    if (typeof job?.filename !== "string") {
+      throw new TypeError("job filename must be a string");
+    }
+  }
+
+  jobs = jobs.map(({ filename, resources, options }) => ({
+    filename,
+    resources,
+    options: { ...defaults, ...options },
+  }));
+
+  // Every worker loads its own module, the WASM one being compiled only once
+  // here when it's in its own file
+  const { wasmModule } = await loadPostjectModule();
+  const workerCount = Math.min(concurrency, jobs.length);
+  const workers =
+    workerCount > 1
+      ? Array.from(
+          { length: workerCount },
+          () => new InjectionWorker(wasmModule)
+        )
+      : [
+          {
+            run: ({ filename, resources, options }) =>
+              injectMany(filename, resources, options),
+          },
+        ];
+
+  // Idle workers take the next job, so that a few large executables don't
+  // hold up the rest
+  const reports = new Array(jobs.length);
+  let next = 0;
+  let failure = null;
+
+  const drain = async (worker) => {
+    while (!failure && next < jobs.length) {
+      const index = next++;
+      try {
+        reports[index] = await worker.run(jobs[index]);
+      } catch (err) {
+        failure =
+          failure || new Error(`${jobs[index].filename}: ${err.message}`);
+      }
+    }
+  };
+
+  try {
+    await Promise.all(workers.map(drain));
+  } finally {
+    await Promise.all(workers.map((worker) => worker.terminate?.()));
+  }
+
+  if (failure) {
+    throw failure;
+  }
+
+  return reports;
+}
+
+// Injects empty resources into the executable, with room for `capacity` bytes
+// of data each, and saves the result to `templateFilename`, from which
+// `stamp()` then writes executables without parsing anything
+async function createTemplate(
+  filename,
+  templateFilename,
+  resources,
+  options
+) {
+  const machoSegmentName = options?.machoSegmentName || "__POSTJECT";
+  const align = options?.align || 0;
+  const sentinelFuse =
+    options?.sentinelFuse ||
+    "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2";
+
+  if (
+    !Number.isSafeInteger(align) ||
+    (align !== 0 && !Number.isInteger(Math.log2(align)))
+  ) {
+    throw new TypeError("align must be a power of two");
+  }
+
+  checkResourceNames(resources);
+
+  for (const { capacity } of resources) {
+    if (!Number.isSafeInteger(capacity) || capacity <= 0) {
+      throw new TypeError("capacity must be a positive number of bytes");
+    }
+  }
+
+  try {
+    await fs.access(filename, constants.R_OK);
+  } catch {
+    throw new Error("Can't read the executable");
+  }
+
+  const { postject } = await loadPostjectModule();
+  const executableFormat = postject.getExecutableFormatOfFile(filename);
+
+  if (executableFormat === postject.ExecutableFormat.kUnknown) {
     throw new Error(
-      `Value at index ${hasResourceIndex} must be '0' or '1' but '${hasResourceValue.charCodeAt(
-        0
-      )}' was found`
+      "Executable must be a supported format: ELF, PE, or Mach-O"
     );
   }
 
+  if (align && executableFormat !== postject.ExecutableFormat.kELF) {
+    throw new Error("align is only supported for ELF executables");
+  }
+
+  const placeholders = resources.map(({ name, capacity }) => ({
+    name: formatResourceName(postject, executableFormat, name),
+    data: Buffer.alloc(0),
+    alignment: align,
+    reserve: capacity,
+  }));
+
+  const { result, sentinelFuseResult } = postject.createInjectionTemplate(
+    filename,
+    machoSegmentName,
+    placeholders,
+    sentinelFuse,
+    templateFilename
+  );
+
+  if (result === postject.InjectResult.kAlreadyExists) {
+    const resourceNames = placeholders.map(({ name }) => name).join(", ");
+    throw new Error(`Resource with that name already exists: ${resourceNames}`);
+  }
+
+  if (result === postject.InjectResult.kTooLarge) {
+    throw new Error("capacity is too large for the executable format");
+  }
+
+  if (result !== postject.InjectResult.kSuccess) {
+    throw new Error("Error when creating the template");
+  }
+
+  checkSentinelFuseResult(postject, sentinelFuseResult, sentinelFuse);
+}
+
+// Writes the executable of a template from `createTemplate()` to
+// `outputFilename`, with the data of `resources` in their room
+async function stamp(templateFilename, outputFilename, resources, options) {
+  const compress = options?.compress || false;
+  const checksum = options?.checksum || false;
+
+  checkResourceNames(resources);
+
+  for (const { data } of resources) {
+    if (!Buffer.isBuffer(data)) {
+      throw new TypeError("resourceData must be a buffer");
+    }
+  }
+
+  const { postject } = await loadPostjectModule();
+  const executableFormat =
+    postject.getInjectionTemplateFormat(templateFilename);
+
+  if (executableFormat === postject.ExecutableFormat.kUnknown) {
+    throw new Error("Can't read the template");
+  }
+
+  resources = resources.map(({ name, data }) => {
+    if (compress) {
+      data = postject.compressResource(data);
+    }
+    if (checksum) {
+      data = postject.checksumResource(data);
+    }
+    return { name: formatResourceName(postject, executableFormat, name), data };
+  });
+
+  switch (
+    postject.stampInjectionTemplate(templateFilename, resources, outputFilename)
+  ) {
+    case postject.StampResult.kSuccess:
+      break;
+
+    case postject.StampResult.kUnknownResource:
+      throw new Error(
+        "The template doesn't have all of these resources: " +
+          resources.map(({ name }) => name).join(", ")
+      );
+
+    case postject.StampResult.kTooLarge:
+      throw new Error(
+        "Resource data doesn't fit in the room the template left for it"
+      );
+
+    default:
+      throw new Error("Couldn't write executable");
+  }
+
+  await fs.chmod(outputFilename, 0o755);
+}
+
+// The format of an executable that's only going to be read, which the
+// functions below take from the file rather than parsing it as a whole
+async function getReadableExecutableFormat(postject, filename) {
   try {
-    await fs.writeFile(filename, buffer);
+    await fs.access(filename, constants.R_OK);
   } catch {
-    throw new Error("Couldn't write executable");
+    throw new Error("Can't read the executable");
+  }
+
+  const executableFormat = postject.getExecutableFormatOfFile(filename);
+
+  if (executableFormat === postject.ExecutableFormat.kUnknown) {
+    throw new Error(
+      "Executable must be a supported format: ELF, PE, or Mach-O"
+    );
   }
+
+  return executableFormat;
+}
+
+// Lists the resources of the executable as `{ name, offset, size, detached }`,
+// with the file offset and size of their data, reading only the headers that
+// describe them
+async function listResources(filename, options) {
+  const machoSegmentName = options?.machoSegmentName || "__POSTJECT";
+
+  const { postject } = await loadPostjectModule();
+  await getReadableExecutableFormat(postject, filename);
+
+  const resources = postject.listResourcesInFile(filename, machoSegmentName);
+  if (!resources) {
+    throw new Error("Can't read the resources of the executable");
+  }
+
+  return resources;
+}
+
+// Writes the data of a resource to `outputFilename` as it's stored, e.g. still
+// compressed, streaming it from the executable rather than reading it whole
+async function extractResource(
+  filename,
+  resourceName,
+  outputFilename,
+  options
+) {
+  const machoSegmentName = options?.machoSegmentName || "__POSTJECT";
+
+  if (typeof resourceName !== "string") {
+    throw new TypeError("resourceName must be a string");
+  }
+
+  const { postject } = await loadPostjectModule();
+  const executableFormat = await getReadableExecutableFormat(
+    postject,
+    filename
+  );
+  const name = formatResourceName(postject, executableFormat, resourceName);
+
+  switch (
+    postject.extractResourceFromFile(
+      filename,
+      machoSegmentName,
+      name,
+      outputFilename
+    )
+  ) {
+    case postject.ExtractResult.kSuccess:
+      break;
+
+    case postject.ExtractResult.kNotFound:
+      throw new Error(`Resource not found: ${name}`);
+
+    default:
+      throw new Error("Couldn't extract the resource");
+  }
+}
+
+if (!isMainThread && workerData?.postjectInjectionWorker) {
+  runInjectionWorker();
 }
 
-module.exports = { inject };
+module.exports = {
+  inject,
+  injectMany,
+  injectAll,
+  createTemplate,
+  stamp,
+  listResources,
+  extractResource,
+};
@@ -0,0 +1,88 @@
+#include "checksum.h"
+
+#include <algorithm>
+
+namespace {
+
+// Keep in sync with postject-api.h
+const uint8_t kMagic[4] = {'P', 'J', 'C', 'K'};
+const uint8_t kVersion = 1;
+const uint8_t kAlgorithmCrc32c = 1;
+const size_t kChunkSize = 1024 * 1024;
+
+// Reflected polynomial of CRC32C
+const uint32_t kPolynomial = 0x82f63b78u;
+
+void append_le(std::vector<uint8_t>* output, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    output->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+// Tables for processing 8 bytes at a time ("slicing-by-8"), where table k
+// gives the CRC of a byte followed by k zero bytes
+struct Crc32cTables {
+  uint32_t table[8][256];
+
+  Crc32cTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+      }
+      table[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++) {
+        table[k][i] =
+            (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+      }
+    }
+  }
+};
+
+}  // namespace
+
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t size) {
+  static const Crc32cTables tables;
+  const auto& table = tables.table;
+
+  crc = ~crc;
+  for (; size >= 8; size -= 8, data += 8) {
+    const uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) |
+                                static_cast<uint32_t>(data[1]) << 8 |
+                                static_cast<uint32_t>(data[2]) << 16 |
+                                static_cast<uint32_t>(data[3]) << 24);
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+          table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^
+          table[0][data[7]];
+  }
+
+  for (; size > 0; size--, data++) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xff];
+  }
+
+  return ~crc;
+}
+
+std::vector<uint8_t> add_resource_checksum(const std::vector<uint8_t>& data) {
+  const size_t chunk_count = (data.size() + kChunkSize - 1) / kChunkSize;
+  std::vector<uint8_t> output;
+  output.reserve(data.size() + chunk_count * 4 + 20);
+  output.insert(output.end(), data.begin(), data.end());
+
+  for (size_t offset = 0; offset < data.size(); offset += kChunkSize) {
+    const size_t size = std::min(kChunkSize, data.size() - offset);
+    append_le(&output, crc32c(0, data.data() + offset, size), 4);
+  }
+
+  output.insert(output.end(), kMagic, kMagic + sizeof(kMagic));
+  output.push_back(kVersion);
+  output.push_back(kAlgorithmCrc32c);
+  append_le(&output, 0, 2);
+  append_le(&output, kChunkSize, 4);
+  append_le(&output, data.size(), 8);
+  return output;
+}
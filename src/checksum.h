@@ -0,0 +1,16 @@
+#ifndef POSTJECT_CHECKSUM_H_
+#define POSTJECT_CHECKSUM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CRC32C (Castagnoli) of `size` bytes, continuing from `crc`
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t size);
+
+// Appends the checksums for `--checksum` to a resource, in the format that
+// `postject_verify_resource()` in postject-api.h understands, see the
+// description there.
+std::vector<uint8_t> add_resource_checksum(const std::vector<uint8_t>& data);
+
+#endif  // POSTJECT_CHECKSUM_H_
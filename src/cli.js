@@ -3,7 +3,12 @@
 const program = require("commander");
 const { constants, promises: fs } = require("fs");
 const path = require("path");
-const { inject } = require("./api.js");
+const {
+  injectMany,
+  injectAll,
+  listResources,
+  extractResource,
+} = require("./api.js");
 
 const logger = {
   info: (message) => console.log("\x1b[36m%s\x1b[0m", message),
@@ -11,7 +16,7 @@ const logger = {
   error: (message) => console.log("\x1b[31mError: %s\x1b[0m", message),
 };
 
-async function main(filename, resourceName, resource, options) {
+async function main(filename, resourceName, resource, moreResources, options) {
   if (options.outputApiHeader) {
     // Handles --output-api-header.
     console.log(
@@ -20,44 +25,194 @@ async function main(filename, resourceName, resource, options) {
     process.exit();
   }
 
-  let resourceData;
-
-  try {
-    await fs.access(resource, constants.R_OK);
-    resourceData = await fs.readFile(resource);
-  } catch {
-    logger.error("Can't read resource file");
+  if (moreResources.length % 2 !== 0) {
+    logger.error("Additional resources must be given as name and file pairs");
     process.exit(1);
   }
 
+  const resources = [];
+  const resourceFiles = [[resourceName, resource]];
+
+  for (let i = 0; i < moreResources.length; i += 2) {
+    resourceFiles.push([moreResources[i], moreResources[i + 1]]);
+  }
+
+  // Detached resources are streamed from their files, unless they have to be
+  // transformed first, so that they don't have to fit in memory
+  const streamed = options.detach && !options.compress && !options.checksum;
+
+  for (const [name, file] of resourceFiles) {
+    try {
+      await fs.access(file, constants.R_OK);
+      resources.push(
+        streamed ? { name, file } : { name, data: await fs.readFile(file) }
+      );
+    } catch {
+      logger.error("Can't read resource file");
+      process.exit(1);
+    }
+  }
+
   try {
+    const resourceNames = resources.map(({ name }) => name).join(", ");
     logger.info(
-      "Start injection of " + resourceName + " in " + filename + "..."
+      "Start injection of " + resourceNames + " in " + filename + "..."
     );
-    await inject(filename, resourceName, resourceData, {
+    const report = await injectMany(filename, resources, {
       machoSegmentName: options.machoSegmentName,
       overwrite: options.overwrite,
+      compress: options.compress,
+      checksum: options.checksum,
+      align: options.align,
+      reserve: options.reserve,
+      detach: options.detach,
       sentinelFuse: options.sentinelFuse,
+      timings: options.timings,
     });
     logger.success("💉 Injection done!");
+    if (report) {
+      console.log(JSON.stringify(report, null, 2));
+    }
   } catch (err) {
     logger.error(err.message);
     process.exit(1);
   }
 }
 
-if (require.main === module) {
-  program
-    .name("postject")
-    .description(
-      "Inject arbitrary read-only resources into an executable for use at runtime"
+// Handles `postject inject-all <manifest>`. The manifest is a JSON array of
+// jobs for `injectAll()`, with the resources given as files, e.g.
+// [{ "filename": "app", "resources": [{ "name": "foo", "file": "foo.bin" }],
+//    "options": { "overwrite": true } }]
+// Paths are relative to the manifest.
+async function injectFromManifest(manifest, options) {
+  let jobs;
+  try {
+    jobs = JSON.parse(await fs.readFile(manifest, "utf-8"));
+  } catch {
+    logger.error("Can't read manifest");
+    process.exit(1);
+  }
+
+  if (
+    !Array.isArray(jobs) ||
+    !jobs.every(
+      (job) =>
+        typeof job?.filename === "string" &&
+        Array.isArray(job.resources) &&
+        job.resources.every((resource) => typeof resource?.file === "string")
     )
+  ) {
+    logger.error("Manifest must be an array of jobs with files to inject");
+    process.exit(1);
+  }
+
+  // Resources shared by several jobs are only read once
+  const directory = path.dirname(manifest);
+  const resourceData = new Map();
+
+  for (const job of jobs) {
+    for (const { file } of job.resources) {
+      const resolved = path.resolve(directory, file);
+      if (resourceData.has(resolved)) {
+        continue;
+      }
+
+      try {
+        await fs.access(resolved, constants.R_OK);
+        resourceData.set(resolved, await fs.readFile(resolved));
+      } catch {
+        logger.error(`Can't read resource file ${file}`);
+        process.exit(1);
+      }
+    }
+  }
+
+  jobs = jobs.map(({ filename, resources, options }) => ({
+    filename: path.resolve(directory, filename),
+    resources: resources.map(({ name, file }) => ({
+      name,
+      data: resourceData.get(path.resolve(directory, file)),
+    })),
+    options,
+  }));
+
+  try {
+    logger.info(`Start injection into ${jobs.length} executables...`);
+    const reports = await injectAll(jobs, {
+      concurrency: options.concurrency,
+    });
+    logger.success("💉 Injection done!");
+    if (reports.some((report) => report)) {
+      console.log(JSON.stringify(reports, null, 2));
+    }
+  } catch (err) {
+    logger.error(err.message);
+    process.exit(1);
+  }
+}
+
+// Handles `postject list <filenames...>`, which only reads the headers that
+// describe the resources, so that many executables can be audited quickly
+async function listFromExecutables(filenames, options) {
+  const listings = [];
+  try {
+    for (const filename of filenames) {
+      listings.push({
+        filename,
+        resources: await listResources(filename, {
+          machoSegmentName: options.machoSegmentName,
+        }),
+      });
+    }
+  } catch (err) {
+    logger.error(`${filenames[listings.length]}: ${err.message}`);
+    process.exit(1);
+  }
+
+  if (options.json) {
+    console.log(JSON.stringify(listings, null, 2));
+    return;
+  }
+
+  for (const { filename, resources } of listings) {
+    if (filenames.length > 1) {
+      console.log(`${filename}:`);
+    }
+    for (const { name, offset, size, detached } of resources) {
+      console.log(
+        `${name}\t${size} bytes at offset ${offset}` +
+          (detached ? " (detached)" : "")
+      );
+    }
+  }
+}
+
+// Handles `postject extract <filename> <resource_name> <output>`
+async function extractFromExecutable(filename, resourceName, output, options) {
+  try {
+    await extractResource(filename, resourceName, output, {
+      machoSegmentName: options.machoSegmentName,
+    });
+  } catch (err) {
+    logger.error(err.message);
+    process.exit(1);
+  }
+}
+
+// Adds the arguments and options of an injection to `command`, which are the
+// same for `postject <filename> ...` and `postject inject <filename> ...`
+function addInjectArguments(command) {
+  return command
     .argument("<filename>", "The executable to inject into")
     .argument(
       "<resource_name>",
       "The resource name to use (section name on Mach-O and ELF, resource name for PE)"
     )
     .argument("<resource>", "The resource to inject")
+    .argument(
+      "[more_resources...]",
+      "Additional resource_name and resource pairs, injected in the same pass"
+    )
     .option(
       "--macho-segment-name <segment_name>",
       "Name for the Mach-O segment",
@@ -70,6 +225,118 @@ if (require.main === module) {
     )
     .option("--output-api-header", "Output the API header to stdout")
     .option("--overwrite", "Overwrite the resource if it already exists")
-    .action(main)
-    .parse(process.argv);
+    .option(
+      "--compress",
+      "Compress the resources, read them with postject_find_resource_decompressed()"
+    )
+    .option(
+      "--checksum",
+      "Store checksums with the resources, check them with postject_verify_resource()"
+    )
+    .option(
+      "--align <bytes>",
+      "Align the resources in the file and in memory, e.g. to the page size (ELF only)",
+      (value) => {
+        const bytes = Number(value);
+        if (
+          !Number.isSafeInteger(bytes) ||
+          !Number.isInteger(Math.log2(bytes))
+        ) {
+          throw new program.InvalidArgumentError("Must be a power of two.");
+        }
+        return bytes;
+      }
+    )
+    .option(
+      "--reserve <bytes>",
+      "Leave room for overwriting the resources in place with up to this many bytes",
+      (value) => {
+        const bytes = Number(value);
+        if (!Number.isSafeInteger(bytes) || bytes < 0) {
+          throw new program.InvalidArgumentError("Must be a number of bytes.");
+        }
+        return bytes;
+      }
+    )
+    .option(
+      "--detach",
+      "Store the resources outside the loaded image, map them with postject_map_resource() (ELF and PE only)"
+    )
+    .option(
+      "--timings",
+      "Print how long each phase took, the bytes copied and written, and the peak heap as JSON"
+    )
+    .action(main);
+}
+
+if (require.main === module) {
+  addInjectArguments(
+    program
+      .name("postject")
+      .description(
+        "Inject arbitrary read-only resources into an executable for use at runtime"
+      )
+  );
+
+  // Executables named like one of the commands below can only be injected into
+  // with an explicit `inject`, e.g. `postject inject list foo foo.bin`
+  addInjectArguments(
+    program
+      .command("inject")
+      .description(
+        "Inject resources into an executable, same as without a command"
+      )
+  );
+
+  program
+    .command("inject-all")
+    .description(
+      "Inject resources into many executables in parallel, as listed in a JSON manifest"
+    )
+    .argument("<manifest>", "The jobs to run, see injectAll()")
+    .option(
+      "--concurrency <count>",
+      "How many executables to inject into at once (default: the number of CPUs)",
+      (value) => {
+        const count = Number(value);
+        if (!Number.isSafeInteger(count) || count < 1) {
+          throw new program.InvalidArgumentError(
+            "Must be a positive integer."
+          );
+        }
+        return count;
+      }
+    )
+    .action(injectFromManifest);
+
+  program
+    .command("list")
+    .description(
+      "List the resources of executables with the offsets and sizes of their data"
+    )
+    .argument("<filenames...>", "The executables to inspect")
+    .option(
+      "--macho-segment-name <segment_name>",
+      "Name for the Mach-O segment",
+      "__POSTJECT"
+    )
+    .option("--json", "Print the resources as JSON")
+    .action(listFromExecutables);
+
+  program
+    .command("extract")
+    .description(
+      "Write the data of a resource to a file, as it's stored in the executable"
+    )
+    .argument("<filename>", "The executable to extract from")
+    .argument("<resource_name>", "The resource to extract")
+    .argument("<output>", "The file to write the data to")
+    .option(
+      "--macho-segment-name <segment_name>",
+      "Name for the Mach-O segment",
+      "__POSTJECT"
+    )
+    .action(extractFromExecutable);
+
+  program.parse(process.argv);
 }
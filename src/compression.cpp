@@ -0,0 +1,144 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Keep in sync with postject-api.h
+const uint8_t kMagic[4] = {'P', 'J', 'C', 'Z'};
+const uint8_t kVersion = 1;
+const uint8_t kCodecLz4 = 1;
+const size_t kChunkSize = 256 * 1024;
+const uint32_t kStoredFlag = 0x80000000u;
+
+// LZ4 block format constraints
+const size_t kMinMatch = 4;
+const size_t kLastLiterals = 5;
+const size_t kMatchFindLimit = 12;
+const size_t kMaxOffset = 65535;
+const int kHashBits = 14;
+
+void append_le(std::vector<uint8_t>* output, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    output->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint32_t read_u32(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t hash_sequence(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+void append_length(std::vector<uint8_t>* output, size_t length) {
+  for (; length >= 255; length -= 255) {
+    output->push_back(255);
+  }
+  output->push_back(static_cast<uint8_t>(length));
+}
+
+void append_sequence(std::vector<uint8_t>* output,
+                     const uint8_t* literals,
+                     size_t literal_length,
+                     size_t offset,
+                     size_t match_length) {
+  const size_t match_code = match_length - kMinMatch;
+  output->push_back(static_cast<uint8_t>(
+      (std::min<size_t>(literal_length, 15) << 4) |
+      std::min<size_t>(match_code, 15)));
+
+  if (literal_length >= 15) {
+    append_length(output, literal_length - 15);
+  }
+  output->insert(output->end(), literals, literals + literal_length);
+
+  append_le(output, offset, 2);
+  if (match_code >= 15) {
+    append_length(output, match_code - 15);
+  }
+}
+
+// Greedy LZ4 block compression of a single chunk, with a hash table of the
+// last position of each 4 byte sequence
+void compress_chunk(const uint8_t* data,
+                    size_t size,
+                    std::vector<uint8_t>* output) {
+  std::vector<uint32_t> table(1 << kHashBits, 0);
+  size_t anchor = 0;
+  size_t pos = 0;
+
+  if (size > kMatchFindLimit) {
+    const size_t match_start_limit = size - kMatchFindLimit;
+    const size_t match_end_limit = size - kLastLiterals;
+
+    while (pos < match_start_limit) {
+      const uint32_t sequence = read_u32(data + pos);
+      uint32_t& entry = table[hash_sequence(sequence)];
+      // Positions are stored off by one, so that 0 means empty
+      const size_t candidate = entry;
+      entry = static_cast<uint32_t>(pos + 1);
+
+      if (candidate == 0 || pos + 1 - candidate > kMaxOffset ||
+          read_u32(data + candidate - 1) != sequence) {
+        pos++;
+        continue;
+      }
+
+      const size_t match = candidate - 1;
+      size_t length = kMinMatch;
+      while (pos + length < match_end_limit &&
+             data[match + length] == data[pos + length]) {
+        length++;
+      }
+
+      append_sequence(output, data + anchor, pos - anchor, pos - match, length);
+      pos += length;
+      anchor = pos;
+    }
+  }
+
+  // The block always ends with literals
+  const size_t literal_length = size - anchor;
+  output->push_back(
+      static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4));
+  if (literal_length >= 15) {
+    append_length(output, literal_length - 15);
+  }
+  output->insert(output->end(), data + anchor, data + size);
+}
+
+}  // namespace
+
+std::vector<uint8_t> compress_resource(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> output(kMagic, kMagic + sizeof(kMagic));
+  output.push_back(kVersion);
+  output.push_back(kCodecLz4);
+  append_le(&output, 0, 2);
+  append_le(&output, kChunkSize, 4);
+  append_le(&output, data.size(), 8);
+
+  std::vector<uint8_t> block;
+
+  for (size_t offset = 0; offset < data.size(); offset += kChunkSize) {
+    const size_t size = std::min(kChunkSize, data.size() - offset);
+    block.clear();
+    compress_chunk(data.data() + offset, size, &block);
+
+    // Store chunks that don't compress as is
+    if (block.size() >= size) {
+      append_le(&output, size | kStoredFlag, 4);
+      output.insert(output.end(), data.begin() + offset,
+                    data.begin() + offset + size);
+    } else {
+      append_le(&output, block.size(), 4);
+      output.insert(output.end(), block.begin(), block.end());
+    }
+  }
+
+  return output;
+}
@@ -0,0 +1,12 @@
+#ifndef POSTJECT_COMPRESSION_H_
+#define POSTJECT_COMPRESSION_H_
+
+#include <cstdint>
+#include <vector>
+
+// Compresses a resource for `--compress`, in the chunked LZ4 format that
+// `postject_find_resource_decompressed()` and `postject_reader_next()` in
+// postject-api.h understand, see the description there.
+std::vector<uint8_t> compress_resource(const std::vector<uint8_t>& data);
+
+#endif  // POSTJECT_COMPRESSION_H_
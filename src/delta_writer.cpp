@@ -0,0 +1,274 @@
+// Make off_t 64-bit on 32-bit platforms as well
+#define _FILE_OFFSET_BITS 64
+
+#include "delta_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t kCompareChunkSize = 1024 * 1024;
+
+// Differing runs closer than this are written together, rather than as many
+// small writes
+const uint64_t kMergeDistance = 4096;
+
+// The headers of all the formats are within the first page, so runs in it are
+// header patches rather than data moved by the rebuild
+const uint64_t kHeaderSize = 4096;
+
+}  // namespace
+
+bool DeltaWriter::open(const std::string& executable_path,
+                       const std::string& output_path) {
+  output_path_ = output_path;
+  in_place_ = executable_path == output_path;
+  executable_ = open_file(executable_path, "rb");
+  return executable_ && get_file_size(executable_.get(), &size_);
+}
+
+bool DeltaWriter::write(uint64_t offset, const uint8_t* data, size_t size) {
+  return size == 0 || find_changes(offset, data, size);
+}
+
+bool DeltaWriter::write_zeros(uint64_t offset, uint64_t size) {
+  return find_changes(offset, nullptr, size);
+}
+
+bool DeltaWriter::copy(uint64_t offset, uint64_t from, uint64_t size) {
+  if (from > size_ || size > size_ - from) {
+    return false;
+  }
+
+  // Copying data onto itself changes nothing, unless earlier writes overlap it
+  if (size > 0 && (offset != from || overlaps_runs(offset, size))) {
+    runs_.push_back(Run{offset, nullptr, size, true, from});
+  }
+  return true;
+}
+
+bool DeltaWriter::commit(uint64_t size) {
+  if (!executable_) {
+    return false;
+  }
+
+  if (in_place_ && is_safe_in_place(size)) {
+    return commit_in_place(size);
+  }
+
+  return commit_to_temp_file(size);
+}
+
+bool DeltaWriter::find_changes(uint64_t offset,
+                               const uint8_t* data,
+                               uint64_t size) {
+  const uint64_t compared =
+      offset < size_ ? std::min(size, size_ - offset) : 0;
+  std::vector<uint8_t> chunk(
+      static_cast<size_t>(std::min<uint64_t>(compared, kCompareChunkSize)));
+
+  // Earlier writes that overlap this one are compared with, rather than the
+  // executable, since they're only written on commit
+  const size_t earlier_runs = runs_.size();
+
+  // The differing run waiting to be recorded, relative to `offset`
+  bool pending = false;
+  uint64_t run_start = 0;
+  uint64_t run_end = 0;
+
+  for (uint64_t position = 0; position < compared;) {
+    const size_t chunk_size = static_cast<size_t>(
+        std::min<uint64_t>(compared - position, chunk.size()));
+    if (!read_at(executable_.get(), offset + position, chunk_size,
+                 chunk.data())) {
+      return false;
+    }
+    if (!overlay_runs(earlier_runs, offset + position, chunk_size,
+                      chunk.data())) {
+      return false;
+    }
+
+    const bool unchanged =
+        data != nullptr
+            ? std::memcmp(chunk.data(), data + position, chunk_size) == 0
+            : std::all_of(chunk.begin(), chunk.begin() + chunk_size,
+                          [](uint8_t byte) { return byte == 0; });
+
+    for (size_t i = 0; !unchanged && i < chunk_size; i++) {
+      if (chunk[i] == (data != nullptr ? data[position + i] : 0)) {
+        continue;
+      }
+
+      const uint64_t difference = position + i;
+      if (pending && difference - run_end <= kMergeDistance) {
+        run_end = difference + 1;
+        continue;
+      }
+
+      if (pending) {
+        runs_.push_back(Run{offset + run_start,
+                            data != nullptr ? data + run_start : nullptr,
+                            run_end - run_start, false, 0});
+      }
+
+      pending = true;
+      run_start = difference;
+      run_end = difference + 1;
+    }
+
+    position += chunk_size;
+  }
+
+  if (pending) {
+    runs_.push_back(Run{offset + run_start,
+                        data != nullptr ? data + run_start : nullptr,
+                        run_end - run_start, false, 0});
+  }
+
+  // What's past the end of the file is written as is, except zeros, which
+  // `commit()` extends the file with, unless they're over earlier writes
+  if (compared < size && data != nullptr) {
+    runs_.push_back(
+        Run{offset + compared, data + compared, size - compared, false, 0});
+  } else if (compared < size) {
+    const uint64_t appended = offset + compared;
+    uint64_t start = offset + size;
+    uint64_t end = appended;
+    for (size_t i = 0; i < earlier_runs; i++) {
+      const Run& run = runs_[i];
+      if (run.offset < offset + size && appended < run.offset + run.size) {
+        start = std::min(start, std::max(run.offset, appended));
+        end = std::max(end, std::min(run.offset + run.size, offset + size));
+      }
+    }
+    if (start < end) {
+      runs_.push_back(Run{start, nullptr, end - start, false, 0});
+    }
+  }
+
+  return true;
+}
+
+bool DeltaWriter::overlaps_runs(uint64_t offset, uint64_t size) const {
+  return std::any_of(runs_.begin(), runs_.end(), [&](const Run& run) {
+    return run.offset < offset + size && offset < run.offset + run.size;
+  });
+}
+
+bool DeltaWriter::overlay_runs(size_t count,
+                               uint64_t offset,
+                               size_t size,
+                               uint8_t* chunk) const {
+  for (size_t i = 0; i < count; i++) {
+    const Run& run = runs_[i];
+    const uint64_t start = std::max(run.offset, offset);
+    const uint64_t end = std::min(run.offset + run.size, offset + size);
+    if (start >= end) {
+      continue;
+    }
+
+    uint8_t* destination = chunk + (start - offset);
+    const size_t length = static_cast<size_t>(end - start);
+    if (run.copied) {
+      if (!read_at(executable_.get(), run.from + (start - run.offset), length,
+                   destination)) {
+        return false;
+      }
+    } else if (run.data != nullptr) {
+      std::memcpy(destination, run.data + (start - run.offset), length);
+    } else {
+      std::memset(destination, 0, length);
+    }
+  }
+
+  return true;
+}
+
+bool DeltaWriter::is_safe_in_place(uint64_t size) const {
+  // Copies are read from the file being written, so they can't be copied
+  // from the headers, which are only written last
+  return size >= size_ &&
+         std::all_of(runs_.begin(), runs_.end(), [&](const Run& run) {
+           return (run.offset >= size_ ||
+                   run.offset + run.size <= kHeaderSize) &&
+                  (!run.copied || run.from >= kHeaderSize);
+         });
+}
+
+bool DeltaWriter::commit_in_place(uint64_t size) {
+  FilePtr file = open_file(output_path_, "r+b");
+  if (!file) {
+    // E.g. the executable is running
+    return commit_to_temp_file(size);
+  }
+
+  // The appended data first, so that the headers only point at it once it's
+  // all there
+  std::stable_partition(runs_.begin(), runs_.end(),
+                        [&](const Run& run) { return run.offset >= size_; });
+  const bool written = write_runs(file.get(), executable_.get());
+  executable_.reset();
+  return written && resize_file(file.get(), size) &&
+         std::fclose(file.release()) == 0;
+}
+
+bool DeltaWriter::commit_to_temp_file(uint64_t size) {
+  const std::string temp_path = output_path_ + ".postject-tmp";
+  FilePtr temp = open_file(temp_path, "w+b");
+  if (!temp) {
+    return false;
+  }
+
+  const bool cloned = clone_file(executable_.get(), temp.get());
+  bool committed =
+      (cloned ||
+       copy_file_contents(executable_.get(), temp.get(), size_)) &&
+      copy_file_mode(executable_.get(), temp.get()) &&
+      write_runs(temp.get(), executable_.get()) &&
+      resize_file(temp.get(), size) &&
+      std::fclose(temp.release()) == 0;
+  if (!cloned) {
+    written_ += size_;
+  }
+
+  // Windows can't replace a file that's still open
+  executable_.reset();
+  committed = committed && replace_file(temp_path, output_path_);
+
+  if (!committed) {
+    temp.reset();
+    std::remove(temp_path.c_str());
+  }
+  return committed;
+}
+
+bool DeltaWriter::write_runs(std::FILE* file, std::FILE* source) {
+  static const uint8_t zeros[64 * 1024] = {};
+
+  for (const Run& run : runs_) {
+    if (run.copied &&
+        !copy_file_contents(source, file, run.size, run.from, run.offset)) {
+      return false;
+    }
+
+    for (uint64_t position = 0; !run.copied && position < run.size;) {
+      const size_t chunk_size =
+          run.data != nullptr
+              ? static_cast<size_t>(run.size - position)
+              : static_cast<size_t>(
+                    std::min<uint64_t>(run.size - position, sizeof(zeros)));
+      if (!write_at(file, run.offset + position,
+                    run.data != nullptr ? run.data + position : zeros,
+                    chunk_size)) {
+        return false;
+      }
+      position += chunk_size;
+    }
+    written_ += run.size;
+  }
+
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef POSTJECT_DELTA_WRITER_H_
+#define POSTJECT_DELTA_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file_io.h"
+
+// Writes the build of a rebuilt executable over the executable, only writing
+// the ranges that actually differ from it. Rebuilding usually leaves most of
+// the executable as it was, e.g. appending a section and patching a few header
+// fields, so on network file systems and CI caches this saves rewriting all of
+// it on every injection.
+//
+// The differing ranges are collected first and only written on `commit()`.
+// They're written to the executable in place only when that's safe, i.e. when
+// it's the output, can be opened for writing, and the ranges are all appended
+// after its end or patch its headers, which are written last, so that an
+// interrupted write leaves a working executable with extra data after it.
+// Otherwise, e.g. when a rebuild moved data around or the executable is
+// running, the output is prepared in a temporary file next to it, which starts
+// as a copy of the executable, reflinked on file systems that support it so
+// that unchanged data is shared, and then replaces the output atomically.
+class DeltaWriter {
+ public:
+  DeltaWriter() = default;
+
+  DeltaWriter(const DeltaWriter&) = delete;
+  DeltaWriter& operator=(const DeltaWriter&) = delete;
+
+  bool open(const std::string& executable_path, const std::string& output_path);
+
+  // Makes the `size` bytes at `offset` hold `data`, only writing the parts
+  // that differ from what's there. The data isn't copied, it has to outlive
+  // `commit()`.
+  bool write(uint64_t offset, const uint8_t* data, size_t size);
+
+  // Same as `write()`, with `size` zero bytes
+  bool write_zeros(uint64_t offset, uint64_t size);
+
+  // Makes the `size` bytes at `offset` hold the ones the executable holds at
+  // `from`, e.g. data that a rebuild moves without having it in memory. They
+  // are copied as the executable holds them before any of the writes.
+  bool copy(uint64_t offset, uint64_t from, uint64_t size);
+
+  // Writes the differing ranges and truncates or extends the output to `size`
+  // bytes, either in place or by replacing the output with a temporary file
+  bool commit(uint64_t size);
+
+  // The bytes written, including copying the executable when it couldn't be
+  // reflinked
+  uint64_t written() const { return written_; }
+
+ private:
+  // A differing range, of `data`, or zeros if it's null, unless it's `copied`
+  // from the executable at `from`
+  struct Run {
+    uint64_t offset;
+    const uint8_t* data;
+    uint64_t size;
+    bool copied;
+    uint64_t from;
+  };
+
+  // Collects the runs of `data`, or zeros if it's null, that differ
+  bool find_changes(uint64_t offset, const uint8_t* data, uint64_t size);
+
+  // Whether any of the runs overlap the `size` bytes at `offset`
+  bool overlaps_runs(uint64_t offset, uint64_t size) const;
+
+  // Replaces what `chunk`, read from `offset`, holds with the first `count`
+  // runs where they overlap it
+  bool overlay_runs(size_t count,
+                    uint64_t offset,
+                    size_t size,
+                    uint8_t* chunk) const;
+
+  // Whether the runs only append to the executable or patch its headers, and
+  // it isn't truncated to `size`
+  bool is_safe_in_place(uint64_t size) const;
+
+  bool commit_in_place(uint64_t size);
+  bool commit_to_temp_file(uint64_t size);
+  // Writes the runs to `file`, copying the copied ones from `source`
+  bool write_runs(std::FILE* file, std::FILE* source);
+
+  FilePtr executable_;
+  // Where the executable ends, beyond which nothing needs to be compared
+  uint64_t size_ = 0;
+  uint64_t written_ = 0;
+  bool in_place_ = false;
+  std::string output_path_;
+  std::vector<Run> runs_;
+};
+
+#endif  // POSTJECT_DELTA_WRITER_H_
@@ -0,0 +1,963 @@
+#include "elf_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "file_io.h"
+
+namespace {
+
+const uint32_t kPtLoad = 1;
+const uint32_t kPtNote = 4;
+const uint32_t kPtPhdr = 6;
+const uint32_t kPfR = 0x4;
+const uint16_t kPnXnum = 0xffff;
+
+const uint64_t kNoteHeaderSize = 12;
+
+// Notes replaced with `overwrite` by earlier versions kept their contents but
+// got this type, which lookups skip. They're turned into padding notes now.
+const uint32_t kReplacedNoteType = 0x504a;
+const uint64_t kMinPageSize = 0x1000;
+
+// Don't pad the file by more than this to line up the new segment's offset
+// with its address, let LIEF relayout the binary instead
+const uint64_t kMaxPadding = 64 * 1024 * 1024;
+
+// Resources can be aligned to at most a 1 GB huge page
+const uint64_t kMaxAlignment = 1024 * 1024 * 1024;
+
+struct ElfHeader {
+  bool is_64;
+  bool big_endian;
+  uint64_t phoff;
+  uint16_t phentsize;
+  uint16_t phnum;
+};
+
+struct ProgramHeader {
+  uint32_t type;
+  uint32_t flags;
+  uint64_t offset;
+  uint64_t vaddr;
+  uint64_t paddr;
+  uint64_t filesz;
+  uint64_t memsz;
+  uint64_t align;
+};
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+  return alignment > 1 ? (value + alignment - 1) / alignment * alignment
+                       : value;
+}
+
+uint64_t read_uint(const uint8_t* p, size_t size, bool big_endian) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= static_cast<uint64_t>(p[big_endian ? size - 1 - i : i]) << (8 * i);
+  }
+  return value;
+}
+
+void write_uint(uint8_t* p, size_t size, uint64_t value, bool big_endian) {
+  for (size_t i = 0; i < size; i++) {
+    p[big_endian ? size - 1 - i : i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+std::vector<uint8_t> encode_uint(size_t size, uint64_t value, bool big_endian) {
+  std::vector<uint8_t> bytes(size);
+  write_uint(bytes.data(), size, value, big_endian);
+  return bytes;
+}
+
+bool read_elf_header(const ExecutableInput& executable, ElfHeader* header) {
+  uint8_t data[0x40];
+  if (!executable.read(0, sizeof(data), data) || data[0] != 0x7f ||
+      data[1] != 'E' || data[2] != 'L' || data[3] != 'F') {
+    return false;
+  }
+
+  // EI_CLASS and EI_DATA
+  if ((data[4] != 1 && data[4] != 2) || (data[5] != 1 && data[5] != 2)) {
+    return false;
+  }
+
+  header->is_64 = data[4] == 2;
+  header->big_endian = data[5] == 2;
+
+  if (header->is_64) {
+    header->phoff = read_uint(data + 0x20, 8, header->big_endian);
+    header->phentsize = read_uint(data + 0x36, 2, header->big_endian);
+    header->phnum = read_uint(data + 0x38, 2, header->big_endian);
+  } else {
+    header->phoff = read_uint(data + 0x1c, 4, header->big_endian);
+    header->phentsize = read_uint(data + 0x2a, 2, header->big_endian);
+    header->phnum = read_uint(data + 0x2c, 2, header->big_endian);
+  }
+
+  return header->phentsize == (header->is_64 ? 56 : 32) &&
+         header->phnum != kPnXnum && header->phoff <= executable.size() &&
+         static_cast<uint64_t>(header->phnum) * header->phentsize <=
+             executable.size() - header->phoff;
+}
+
+ProgramHeader read_program_header(const uint8_t* p, const ElfHeader& header) {
+  const bool be = header.big_endian;
+  ProgramHeader phdr;
+  phdr.type = read_uint(p, 4, be);
+
+  if (header.is_64) {
+    phdr.flags = read_uint(p + 4, 4, be);
+    phdr.offset = read_uint(p + 8, 8, be);
+    phdr.vaddr = read_uint(p + 16, 8, be);
+    phdr.paddr = read_uint(p + 24, 8, be);
+    phdr.filesz = read_uint(p + 32, 8, be);
+    phdr.memsz = read_uint(p + 40, 8, be);
+    phdr.align = read_uint(p + 48, 8, be);
+  } else {
+    phdr.offset = read_uint(p + 4, 4, be);
+    phdr.vaddr = read_uint(p + 8, 4, be);
+    phdr.paddr = read_uint(p + 12, 4, be);
+    phdr.filesz = read_uint(p + 16, 4, be);
+    phdr.memsz = read_uint(p + 20, 4, be);
+    phdr.flags = read_uint(p + 24, 4, be);
+    phdr.align = read_uint(p + 28, 4, be);
+  }
+
+  return phdr;
+}
+
+void write_program_header(uint8_t* p,
+                          const ProgramHeader& phdr,
+                          const ElfHeader& header) {
+  const bool be = header.big_endian;
+  write_uint(p, 4, phdr.type, be);
+
+  if (header.is_64) {
+    write_uint(p + 4, 4, phdr.flags, be);
+    write_uint(p + 8, 8, phdr.offset, be);
+    write_uint(p + 16, 8, phdr.vaddr, be);
+    write_uint(p + 24, 8, phdr.paddr, be);
+    write_uint(p + 32, 8, phdr.filesz, be);
+    write_uint(p + 40, 8, phdr.memsz, be);
+    write_uint(p + 48, 8, phdr.align, be);
+  } else {
+    write_uint(p + 4, 4, phdr.offset, be);
+    write_uint(p + 8, 4, phdr.vaddr, be);
+    write_uint(p + 12, 4, phdr.paddr, be);
+    write_uint(p + 16, 4, phdr.filesz, be);
+    write_uint(p + 20, 4, phdr.memsz, be);
+    write_uint(p + 24, 4, phdr.flags, be);
+    write_uint(p + 28, 4, phdr.align, be);
+  }
+}
+
+// Looks for a note with the given name in a PT_NOTE segment. Only the note
+// headers and names are read, not the descriptions.
+// Stores the offset of the note named `note_name` in `note_offset`, ignoring
+// notes that were already replaced
+bool find_note(const ExecutableInput& executable,
+               const ProgramHeader& segment,
+               const ElfHeader& header,
+               const std::string& note_name,
+               uint64_t* note_offset) {
+  // GNU property notes use 8 byte alignment, everything else uses 4
+  const uint64_t alignment = segment.align == 8 ? 8 : 4;
+
+  if (segment.offset > executable.size() ||
+      segment.filesz > executable.size() - segment.offset) {
+    return false;
+  }
+
+  uint64_t pos = segment.offset;
+  const uint64_t end = segment.offset + segment.filesz;
+  std::vector<uint8_t> name(note_name.size() + 1);
+
+  while (end - pos >= kNoteHeaderSize) {
+    uint8_t note[kNoteHeaderSize];
+    if (!executable.read(pos, kNoteHeaderSize, note)) {
+      break;
+    }
+
+    const uint64_t namesz = read_uint(note, 4, header.big_endian);
+    const uint64_t descsz = read_uint(note + 4, 4, header.big_endian);
+    const uint64_t type = read_uint(note + 8, 4, header.big_endian);
+    const uint64_t name_pos = pos + kNoteHeaderSize;
+
+    if (namesz > end - name_pos) {
+      break;
+    }
+
+    // Names are NUL-terminated, so only the first `note_name.size() + 1`
+    // bytes can tell whether they match
+    const size_t compare_size =
+        static_cast<size_t>(std::min<uint64_t>(namesz, name.size()));
+    if (!executable.read(name_pos, compare_size, name.data())) {
+      break;
+    }
+
+    const char* name_chars = reinterpret_cast<const char*>(name.data());
+    if (namesz != 0 && type != kReplacedNoteType &&
+        strnlen(name_chars, compare_size) == note_name.size() &&
+        note_name.compare(0, note_name.size(), name_chars, note_name.size()) ==
+            0) {
+      *note_offset = pos;
+      return true;
+    }
+
+    pos = align_up(name_pos + namesz, alignment);
+    if (pos > end || descsz > end - pos) {
+      break;
+    }
+    pos = align_up(pos + descsz, alignment);
+  }
+
+  return false;
+}
+
+// Notes with longer names aren't postject's, so their names aren't read
+const uint64_t kMaxNoteNameSize = 4096;
+
+// Appends the notes of a PT_NOTE segment that lookups consider resources, i.e.
+// the notes of type 0 with a NUL-terminated name and a description. Like
+// lookups, it stops at the first note that doesn't fit in the segment.
+void list_notes(const ExecutableInput& executable,
+                const ProgramHeader& segment,
+                const ElfHeader& header,
+                std::vector<ResourceInfo>* notes) {
+  // GNU property notes use 8 byte alignment, everything else uses 4
+  const uint64_t alignment = segment.align == 8 ? 8 : 4;
+
+  if (segment.offset > executable.size() ||
+      segment.filesz > executable.size() - segment.offset) {
+    return;
+  }
+
+  uint64_t pos = segment.offset;
+  const uint64_t end = segment.offset + segment.filesz;
+
+  while (end - pos >= kNoteHeaderSize) {
+    uint8_t note[kNoteHeaderSize];
+    if (!executable.read(pos, kNoteHeaderSize, note)) {
+      return;
+    }
+
+    const uint64_t namesz = read_uint(note, 4, header.big_endian);
+    const uint64_t descsz = read_uint(note + 4, 4, header.big_endian);
+    const uint64_t type = read_uint(note + 8, 4, header.big_endian);
+    const uint64_t name_pos = pos + kNoteHeaderSize;
+
+    if (namesz > end - name_pos) {
+      return;
+    }
+
+    const uint64_t desc_pos = align_up(name_pos + namesz, alignment);
+    if (desc_pos > end || descsz > end - desc_pos) {
+      return;
+    }
+
+    if (type == 0 && namesz != 0 && namesz <= kMaxNoteNameSize &&
+        descsz != 0) {
+      std::vector<char> name(static_cast<size_t>(namesz));
+      if (!executable.read(name_pos, name.size(),
+                           reinterpret_cast<uint8_t*>(name.data()))) {
+        return;
+      }
+
+      if (name.back() == '\0') {
+        ResourceInfo info;
+        info.name = name.data();
+        info.offset = desc_pos;
+        info.size = descsz;
+        notes->push_back(info);
+      }
+    }
+
+    pos = std::min(align_up(desc_pos + descsz, alignment), end);
+  }
+}
+
+// Note header and name, padded so that the description starts 4 byte aligned
+std::vector<uint8_t> encode_note_header(const std::string& note_name,
+                                        uint64_t data_size,
+                                        const ElfHeader& header) {
+  const uint64_t namesz = note_name.size() + 1;
+  std::vector<uint8_t> bytes(kNoteHeaderSize + align_up(namesz, 4), 0);
+  write_uint(bytes.data(), 4, namesz, header.big_endian);
+  write_uint(bytes.data() + 4, 4, data_size, header.big_endian);
+  write_uint(bytes.data() + 8, 4, 0 /* NT_UNKNOWN, like LIEF */,
+             header.big_endian);
+  std::copy(note_name.begin(), note_name.end(),
+            bytes.begin() + kNoteHeaderSize);
+  return bytes;
+}
+
+// Header of an unnamed note taking up `size` bytes in total, which lookups
+// skip. `size` has to be at least `kNoteHeaderSize`.
+std::vector<uint8_t> encode_padding_note_header(uint64_t size,
+                                                const ElfHeader& header) {
+  std::vector<uint8_t> bytes(kNoteHeaderSize, 0);
+  write_uint(bytes.data() + 4, 4, size - kNoteHeaderSize, header.big_endian);
+  return bytes;
+}
+
+// Header turning the note at `note_offset` into an unnamed padding note of the
+// same size. Lookups that only compare names, like those of older copies of
+// postject-api.h, skip it as well.
+bool encode_padding_over_note(const ExecutableInput& executable,
+                              const ProgramHeader& segment,
+                              const ElfHeader& header,
+                              uint64_t note_offset,
+                              std::vector<uint8_t>* bytes) {
+  const uint64_t alignment = segment.align == 8 ? 8 : 4;
+  const uint64_t end = segment.offset + segment.filesz;
+
+  uint8_t note[kNoteHeaderSize];
+  if (!executable.read(note_offset, kNoteHeaderSize, note)) {
+    return false;
+  }
+
+  const uint64_t namesz = read_uint(note, 4, header.big_endian);
+  const uint64_t descsz = read_uint(note + 4, 4, header.big_endian);
+  const uint64_t desc = align_up(note_offset + kNoteHeaderSize + namesz,
+                                 alignment);
+  if (desc > end || descsz > end - desc) {
+    return false;
+  }
+
+  // The description of the padding note starts right after its header
+  const uint64_t note_end = std::min(align_up(desc + descsz, alignment), end);
+  *bytes = encode_padding_note_header(
+      note_end - align_up(note_offset + kNoteHeaderSize, alignment) +
+          kNoteHeaderSize,
+      header);
+  return true;
+}
+
+// Room to leave after the description of a note, as a padding note, so that
+// the note can later grow to `Resource::reserve` bytes in place
+uint64_t reserved_room(const Resource& note) {
+  if (note.reserve <= note.data->size()) {
+    return 0;
+  }
+
+  const uint64_t room =
+      align_up(note.reserve, 4) - align_up(note.data->size(), 4);
+  return room != 0 && room < kNoteHeaderSize ? room + kNoteHeaderSize : room;
+}
+
+// Fills in `plan->notes` for the notes that aren't written in place, starting
+// at `offset`, and returns their total size. Data that has to be aligned
+// further than the usual 4 bytes is preceded by an unnamed padding note.
+uint64_t layout_notes(const std::vector<Resource>& notes,
+                      const std::vector<bool>& in_place,
+                      uint64_t offset,
+                      const ElfHeader& header,
+                      ElfNotePlan* plan) {
+  const uint64_t start = offset;
+
+  for (size_t i = 0; i < notes.size(); i++) {
+    if (in_place[i]) {
+      continue;
+    }
+
+    const Resource& note = notes[i];
+    ElfNoteLayout& layout = plan->notes[i];
+    layout.offset = offset;
+    layout.prefix = encode_note_header(note.name, note.data->size(), header);
+
+    if (note.alignment > 4) {
+      uint64_t padding =
+          align_up(offset + layout.prefix.size(), note.alignment) -
+          (offset + layout.prefix.size());
+      if (padding != 0 && padding < kNoteHeaderSize) {
+        padding += note.alignment;
+      }
+
+      if (padding != 0) {
+        std::vector<uint8_t> padding_note =
+            encode_padding_note_header(padding, header);
+        padding_note.resize(padding, 0);
+        layout.prefix.insert(layout.prefix.begin(), padding_note.begin(),
+                             padding_note.end());
+      }
+    }
+
+    const uint64_t room = reserved_room(note);
+    if (room != 0) {
+      layout.suffix = encode_padding_note_header(room, header);
+      layout.reserved = room - kNoteHeaderSize;
+    }
+
+    offset += layout.prefix.size() + align_up(note.data->size(), 4) + room;
+  }
+
+  return offset - start;
+}
+
+// Where the slot of the note at `note_offset` ends, i.e. that note and the
+// unnamed or replaced notes right after it
+uint64_t find_slot_end(const ExecutableInput& executable,
+                       const ProgramHeader& segment,
+                       const ElfHeader& header,
+                       uint64_t note_offset) {
+  const uint64_t end = segment.offset + segment.filesz;
+  uint64_t slot_end = note_offset;
+
+  while (end - slot_end >= kNoteHeaderSize) {
+    uint8_t bytes[kNoteHeaderSize];
+    if (!executable.read(slot_end, kNoteHeaderSize, bytes)) {
+      break;
+    }
+
+    const uint64_t namesz = read_uint(bytes, 4, header.big_endian);
+    const uint64_t descsz = read_uint(bytes + 4, 4, header.big_endian);
+    const uint64_t type = read_uint(bytes + 8, 4, header.big_endian);
+    if (slot_end != note_offset && namesz != 0 && type != kReplacedNoteType) {
+      break;
+    }
+
+    const uint64_t desc = align_up(slot_end + kNoteHeaderSize + namesz, 4);
+    if (desc > end || descsz > end - desc) {
+      break;
+    }
+    slot_end = std::min(align_up(desc + descsz, 4), end);
+  }
+
+  return slot_end;
+}
+
+// Lays out `note` over the slot of the note at `note_offset` that it
+// replaces, if it fits, see `layout_note_in_slot()`
+bool fit_note_in_slot(const ExecutableInput& executable,
+                      const ProgramHeader& segment,
+                      const ElfHeader& header,
+                      uint64_t note_offset,
+                      const Resource& note,
+                      ElfNoteLayout* layout) {
+  // find_note() already checked that the segment is within the file
+  if (segment.align > 4 ||
+      (note.alignment > 4 &&
+       (segment.vaddr - segment.offset) % note.alignment != 0)) {
+    return false;
+  }
+
+  ElfNoteSlot slot;
+  slot.offset = note_offset;
+  slot.size =
+      find_slot_end(executable, segment, header, note_offset) - note_offset;
+  slot.big_endian = header.big_endian;
+  return layout_note_in_slot(slot, note, layout);
+}
+
+void patch_program_header(const ProgramHeader& phdr,
+                          size_t index,
+                          const ElfHeader& header,
+                          ElfNotePlan* plan) {
+  std::vector<uint8_t> bytes(header.phentsize);
+  write_program_header(bytes.data(), phdr, header);
+  plan->patches.emplace_back(header.phoff + index * header.phentsize,
+                             std::move(bytes));
+}
+
+// ELF32 offsets and sizes are 32-bit, so the output can't grow past 4 GB
+ElfPlanResult check_plan_size(const ElfHeader& header,
+                              const ElfNotePlan& plan) {
+  return header.is_64 || plan.size <= std::numeric_limits<uint32_t>::max()
+             ? ElfPlanResult::kSuccess
+             : ElfPlanResult::kTooLarge;
+}
+
+}  // namespace
+
+ElfPlanResult plan_elf_notes(const ExecutableInput& executable,
+                             const std::vector<Resource>& notes,
+                             bool overwrite,
+                             ElfNotePlan* plan) {
+  ElfHeader header;
+  if (notes.empty() || !read_elf_header(executable, &header)) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  std::vector<uint8_t> table(static_cast<size_t>(header.phnum) *
+                             header.phentsize);
+  if (!executable.read(header.phoff, table.size(), table.data())) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  std::vector<ProgramHeader> phdrs;
+  for (uint16_t i = 0; i < header.phnum; i++) {
+    phdrs.push_back(
+        read_program_header(table.data() + i * header.phentsize, header));
+  }
+
+  *plan = ElfNotePlan();
+  plan->notes.resize(notes.size());
+  std::vector<bool> in_place(notes.size(), false);
+  uint64_t max_alignment = 1;
+  const uint64_t size = executable.size();
+
+  // A replaced note whose slot ends the file, which the appended notes can be
+  // written over instead
+  uint64_t trailing_note = size;
+
+  for (size_t i = 0; i < notes.size(); i++) {
+    const Resource& note = notes[i];
+    if (std::max<uint64_t>(note.data->size(), note.reserve) >
+        std::numeric_limits<uint32_t>::max()) {
+      return ElfPlanResult::kTooLarge;
+    }
+    if (note.name.empty() ||
+        (note.alignment & (note.alignment - 1)) != 0 ||
+        note.alignment > kMaxAlignment) {
+      return ElfPlanResult::kUnsupported;
+    }
+    max_alignment = std::max(max_alignment, note.alignment);
+
+    // Existing notes are written over if the new one fits, or else replaced
+    // by a padding note, which only touches their header, rather than
+    // removed, which would require a relayout of the binary
+    for (const ProgramHeader& phdr : phdrs) {
+      uint64_t note_offset = 0;
+      if (phdr.type != kPtNote ||
+          !find_note(executable, phdr, header, note.name, &note_offset)) {
+        continue;
+      }
+
+      if (!overwrite) {
+        return ElfPlanResult::kAlreadyExists;
+      }
+
+      if (in_place[i] && plan->notes[i].offset == note_offset) {
+        // Another PT_NOTE segment covering the same note
+        continue;
+      }
+
+      if (!in_place[i] && fit_note_in_slot(executable, phdr, header,
+                                           note_offset, note,
+                                           &plan->notes[i])) {
+        in_place[i] = true;
+        continue;
+      }
+
+      if (!in_place[i]) {
+        plan->notes[i] = ElfNoteLayout();
+      }
+      std::vector<uint8_t> padding;
+      if (!encode_padding_over_note(executable, phdr, header, note_offset,
+                                    &padding)) {
+        return ElfPlanResult::kUnsupported;
+      }
+      plan->patches.emplace_back(note_offset, std::move(padding));
+
+      if (phdr.align <= 4 &&
+          find_slot_end(executable, phdr, header, note_offset) == size) {
+        trailing_note = std::min(trailing_note, note_offset);
+      }
+    }
+
+    // Leave duplicates within `notes` to LIEF when overwriting, the last one
+    // has to win
+    for (size_t j = 0; j < i; j++) {
+      if (notes[j].name == note.name) {
+        return overwrite ? ElfPlanResult::kUnsupported
+                         : ElfPlanResult::kAlreadyExists;
+      }
+    }
+  }
+
+  plan->append_offset = size;
+  plan->size = size;
+
+  if (std::all_of(in_place.begin(), in_place.end(),
+                  [](bool note_in_place) { return note_in_place; })) {
+    return ElfPlanResult::kSuccess;
+  }
+
+  // Collect what we need to know about the loadable segments
+  const ProgramHeader* first_load = nullptr;
+  size_t last_load_index = 0;
+  size_t highest_load_index = 0;
+  uint64_t max_align = kMinPageSize;
+  uint64_t max_end = 0;
+
+  for (size_t i = 0; i < phdrs.size(); i++) {
+    const ProgramHeader& phdr = phdrs[i];
+    if (phdr.type != kPtLoad) {
+      continue;
+    }
+
+    if (first_load == nullptr) {
+      first_load = &phdr;
+    }
+    last_load_index = i;
+    max_align = std::max(max_align, phdr.align);
+
+    if (phdr.vaddr + phdr.memsz >= max_end) {
+      max_end = phdr.vaddr + phdr.memsz;
+      highest_load_index = i;
+    }
+  }
+
+  if (first_load == nullptr || first_load->vaddr < first_load->offset ||
+      (max_align & (max_align - 1)) != 0) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  // The loader only aligns the whole image to the largest PT_LOAD alignment,
+  // so larger resource alignments need the new segment to raise it
+  const uint64_t bias = first_load->vaddr - first_load->offset;
+  const uint64_t load_align = std::max(max_align, max_alignment);
+  if (bias % load_align != 0) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  // Extend the segments appended by a previous injection if the file still
+  // ends with them
+  const ProgramHeader& highest_load = phdrs[highest_load_index];
+  if (size % 4 == 0 && highest_load.offset + highest_load.filesz == size &&
+      highest_load.filesz == highest_load.memsz && max_alignment <= max_align &&
+      (highest_load.vaddr - highest_load.offset) % max_alignment == 0) {
+    for (size_t i = 0; i < phdrs.size(); i++) {
+      ProgramHeader note_segment = phdrs[i];
+      if (note_segment.type != kPtNote || note_segment.align > 4 ||
+          note_segment.offset + note_segment.filesz != size ||
+          note_segment.filesz != note_segment.memsz ||
+          note_segment.offset < highest_load.offset ||
+          note_segment.vaddr - note_segment.offset !=
+              highest_load.vaddr - highest_load.offset) {
+        continue;
+      }
+
+      // Write over a note replaced at the end of these segments, so that
+      // overwriting the last note again and again doesn't grow the file. It
+      // only ends up in here if the new notes are larger than its slot.
+      uint64_t notes_offset = size;
+      if (trailing_note >= note_segment.offset && trailing_note < size &&
+          trailing_note +
+                  layout_notes(notes, in_place, trailing_note, header, plan) >=
+              size) {
+        notes_offset = trailing_note;
+        auto is_padding_over_note =
+            [notes_offset](
+                const std::pair<uint64_t, std::vector<uint8_t>>& patch) {
+              return patch.first == notes_offset;
+            };
+        plan->patches.erase(std::remove_if(plan->patches.begin(),
+                                           plan->patches.end(),
+                                           is_padding_over_note),
+                            plan->patches.end());
+      }
+
+      const uint64_t end =
+          notes_offset +
+          layout_notes(notes, in_place, notes_offset, header, plan);
+      const uint64_t growth = end - size;
+
+      ProgramHeader load_segment = highest_load;
+      load_segment.filesz += growth;
+      load_segment.memsz += growth;
+      note_segment.filesz += growth;
+      note_segment.memsz += growth;
+
+      patch_program_header(load_segment, highest_load_index, header, plan);
+      patch_program_header(note_segment, i, header, plan);
+
+      plan->size = end;
+      return check_plan_size(header, *plan);
+    }
+  }
+
+  // Otherwise append a new program header table with a PT_LOAD segment
+  // covering itself and a PT_NOTE segment for the note
+  if (header.phnum + 2 >= kPnXnum) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  const uint64_t min_vaddr = align_up(max_end, load_align);
+  const uint64_t start =
+      std::max(align_up(size, 8), min_vaddr > bias ? min_vaddr - bias : 0);
+
+  if (start - size > kMaxPadding) {
+    return ElfPlanResult::kUnsupported;
+  }
+
+  const uint64_t table_size =
+      static_cast<uint64_t>(header.phnum + 2) * header.phentsize;
+  const uint64_t note_offset = align_up(start + table_size, 4);
+  const uint64_t notes_size =
+      layout_notes(notes, in_place, note_offset, header, plan);
+  const uint64_t end = note_offset + notes_size;
+
+  ProgramHeader load_segment;
+  load_segment.type = kPtLoad;
+  load_segment.flags = kPfR;
+  load_segment.offset = start;
+  load_segment.vaddr = start + bias;
+  load_segment.paddr = start + bias;
+  load_segment.filesz = end - start;
+  load_segment.memsz = end - start;
+  load_segment.align = load_align;
+
+  ProgramHeader note_segment;
+  note_segment.type = kPtNote;
+  note_segment.flags = kPfR;
+  note_segment.offset = note_offset;
+  note_segment.vaddr = note_offset + bias;
+  note_segment.paddr = note_offset + bias;
+  note_segment.filesz = notes_size;
+  note_segment.memsz = notes_size;
+  note_segment.align = 4;
+
+  // PT_LOAD entries have to stay sorted by address, so the new one goes right
+  // after the existing ones, and the PT_PHDR entry has to describe the new
+  // table
+  std::vector<ProgramHeader> new_phdrs;
+  for (size_t i = 0; i < phdrs.size(); i++) {
+    ProgramHeader phdr = phdrs[i];
+    if (phdr.type == kPtPhdr) {
+      phdr.offset = start;
+      phdr.vaddr = start + bias;
+      phdr.paddr = start + bias;
+      phdr.filesz = table_size;
+      phdr.memsz = table_size;
+    }
+    new_phdrs.push_back(phdr);
+
+    if (i == last_load_index) {
+      new_phdrs.push_back(load_segment);
+    }
+  }
+  new_phdrs.push_back(note_segment);
+
+  std::vector<uint8_t> new_table(note_offset - start, 0);
+  for (size_t i = 0; i < new_phdrs.size(); i++) {
+    write_program_header(new_table.data() + i * header.phentsize, new_phdrs[i],
+                         header);
+  }
+
+  plan->append_offset = start;
+  plan->size = end;
+  plan->patches.emplace_back(start, std::move(new_table));
+
+  const size_t phoff_size = header.is_64 ? 8 : 4;
+  plan->patches.emplace_back(
+      header.is_64 ? 0x20 : 0x1c,
+      encode_uint(phoff_size, start, header.big_endian));
+  plan->patches.emplace_back(
+      header.is_64 ? 0x38 : 0x2c,
+      encode_uint(2, new_phdrs.size(), header.big_endian));
+
+  return check_plan_size(header, *plan);
+}
+
+bool find_elf_note_slot(const ExecutableInput& executable,
+                        const std::string& note_name,
+                        ElfNoteSlot* slot) {
+  ElfHeader header;
+  if (!read_elf_header(executable, &header)) {
+    return false;
+  }
+
+  std::vector<uint8_t> table(static_cast<size_t>(header.phnum) *
+                             header.phentsize);
+  if (!executable.read(header.phoff, table.size(), table.data())) {
+    return false;
+  }
+
+  for (uint16_t i = 0; i < header.phnum; i++) {
+    const ProgramHeader phdr =
+        read_program_header(table.data() + i * header.phentsize, header);
+    uint64_t note_offset = 0;
+    if (phdr.type != kPtNote || phdr.align > 4 ||
+        !find_note(executable, phdr, header, note_name, &note_offset)) {
+      continue;
+    }
+
+    slot->offset = note_offset;
+    slot->size =
+        find_slot_end(executable, phdr, header, note_offset) - note_offset;
+    slot->big_endian = header.big_endian;
+    return true;
+  }
+
+  return false;
+}
+
+bool list_elf_notes(const ExecutableInput& executable,
+                    std::vector<ResourceInfo>* notes) {
+  ElfHeader header;
+  if (!read_elf_header(executable, &header)) {
+    return false;
+  }
+
+  std::vector<uint8_t> table(static_cast<size_t>(header.phnum) *
+                             header.phentsize);
+  if (!executable.read(header.phoff, table.size(), table.data())) {
+    return false;
+  }
+
+  notes->clear();
+  for (uint16_t i = 0; i < header.phnum; i++) {
+    const ProgramHeader phdr =
+        read_program_header(table.data() + i * header.phentsize, header);
+    if (phdr.type == kPtNote) {
+      list_notes(executable, phdr, header, notes);
+    }
+  }
+
+  return true;
+}
+
+bool layout_note_in_slot(const ElfNoteSlot& slot,
+                         const Resource& note,
+                         ElfNoteLayout* layout) {
+  ElfHeader header = ElfHeader();
+  header.big_endian = slot.big_endian;
+
+  const uint64_t data_size = note.data->size();
+  layout->offset = slot.offset;
+  layout->prefix = encode_note_header(note.name, data_size, header);
+  layout->suffix.clear();
+  layout->reserved = 0;
+
+  const uint64_t needed =
+      layout->prefix.size() + align_up(data_size, 4) + reserved_room(note);
+  if (needed > slot.size ||
+      (note.alignment > 4 &&
+       (slot.offset + layout->prefix.size()) % note.alignment != 0)) {
+    return false;
+  }
+
+  const uint64_t room =
+      slot.size - layout->prefix.size() - align_up(data_size, 4);
+  if (room >= kNoteHeaderSize) {
+    layout->suffix = encode_padding_note_header(room, header);
+    layout->reserved = room - kNoteHeaderSize;
+  } else if (room != 0) {
+    // Lookups only compare names up to the first NUL byte, but more of them
+    // would move aligned data
+    if (note.alignment > 4) {
+      return false;
+    }
+    write_uint(layout->prefix.data(), 4,
+               align_up(note.name.size() + 1, 4) + room, header.big_endian);
+    layout->prefix.resize(layout->prefix.size() + room, 0);
+  }
+
+  return true;
+}
+
+uint64_t reserved_note_size(const Resource& note) {
+  const uint64_t room = reserved_room(note);
+  return room == 0 ? note.data->size() : align_up(note.data->size(), 4) + room;
+}
+
+bool find_reserved_note_patches(
+    const ExecutableInput& build,
+    const Resource& note,
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>>* patches) {
+  ElfNoteSlot slot;
+  ElfNoteLayout layout;
+  if (!find_elf_note_slot(build, note.name, &slot) ||
+      !layout_note_in_slot(slot, note, &layout)) {
+    return false;
+  }
+
+  // The data and the zeros after it are already in place
+  patches->emplace_back(layout.offset, std::move(layout.prefix));
+  if (!layout.suffix.empty()) {
+    patches->emplace_back(layout.offset + patches->back().second.size() +
+                              align_up(note.data->size(), 4),
+                          std::move(layout.suffix));
+  }
+  return true;
+}
+
+void apply_elf_note_plan(const std::vector<uint8_t>& executable,
+                         const ElfNotePlan& plan,
+                         const std::vector<Resource>& notes,
+                         std::vector<uint8_t>* output) {
+  output->reserve(plan.size);
+  output->assign(executable.begin(), executable.end());
+  output->resize(plan.size, 0);
+
+  for (const auto& patch : plan.patches) {
+    std::copy(patch.second.begin(), patch.second.end(),
+              output->begin() + patch.first);
+  }
+
+  for (size_t i = 0; i < notes.size(); i++) {
+    const ElfNoteLayout& layout = plan.notes[i];
+    const std::vector<uint8_t>& data = *notes[i].data;
+    auto position = std::copy(layout.prefix.begin(), layout.prefix.end(),
+                              output->begin() + layout.offset);
+    position = std::copy(data.begin(), data.end(), position);
+    position = std::fill_n(position, align_up(data.size(), 4) - data.size(), 0);
+    position = std::copy(layout.suffix.begin(), layout.suffix.end(), position);
+    std::fill_n(position, layout.reserved, 0);
+  }
+}
+
+bool write_elf_note_plan(std::FILE* executable,
+                         uint64_t executable_size,
+                         const ElfNotePlan& plan,
+                         const std::vector<Resource>& notes,
+                         std::FILE* output) {
+  if (output != executable &&
+      !copy_file_contents(executable, output, executable_size)) {
+    return false;
+  }
+
+  const std::vector<uint8_t> padding(
+      static_cast<size_t>(plan.append_offset - executable_size), 0);
+  if (!append(output, padding.data(), padding.size())) {
+    return false;
+  }
+
+  for (const auto& patch : plan.patches) {
+    if (!write_at(output, patch.first, patch.second.data(),
+                  patch.second.size())) {
+      return false;
+    }
+  }
+
+  // Everything after the prefix follows it directly
+  auto write_next = [output](const std::vector<uint8_t>& bytes) {
+    return bytes.empty() ||
+           std::fwrite(bytes.data(), 1, bytes.size(), output) == bytes.size();
+  };
+
+  for (size_t i = 0; i < notes.size(); i++) {
+    const ElfNoteLayout& layout = plan.notes[i];
+    const std::vector<uint8_t>& data = *notes[i].data;
+    if (!write_at(output, layout.offset, layout.prefix.data(),
+                  layout.prefix.size()) ||
+        !write_next(data) ||
+        !write_zeros(output, align_up(data.size(), 4) - data.size()) ||
+        !write_next(layout.suffix) || !write_zeros(output, layout.reserved)) {
+      return false;
+    }
+  }
+
+  return std::fflush(output) == 0;
+}
+
+uint64_t elf_note_plan_write_size(const ElfNotePlan& plan,
+                                  const std::vector<Resource>& notes,
+                                  uint64_t executable_size) {
+  uint64_t size = plan.append_offset - executable_size;
+  for (const auto& patch : plan.patches) {
+    size += patch.second.size();
+  }
+
+  for (size_t i = 0; i < notes.size(); i++) {
+    const ElfNoteLayout& layout = plan.notes[i];
+    size += layout.prefix.size() + align_up(notes[i].data->size(), 4) +
+            layout.suffix.size() + layout.reserved;
+  }
+
+  return size;
+}
@@ -0,0 +1,143 @@
+#ifndef POSTJECT_ELF_WRITER_H_
+#define POSTJECT_ELF_WRITER_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file_io.h"
+#include "postject.h"
+
+// Direct ELF writer used as the fast path of `inject_into_elf()`. Instead of
+// parsing and rebuilding the whole binary with LIEF, it only reads the ELF
+// header, the program headers and the existing notes, and appends the new
+// notes at the end of the file:
+//
+// * If the file already ends with a read-only PT_LOAD segment covering a
+//   PT_NOTE segment (i.e. a previous fast path injection), both are extended
+//   to cover the new notes.
+// * Otherwise a copy of the program header table with a new PT_LOAD and
+//   PT_NOTE segment is appended, followed by the notes, and the ELF header is
+//   pointed at it. The new segment is mapped with the same offset to address
+//   delta as the first PT_LOAD segment, so that kernels computing AT_PHDR
+//   from `e_phoff` still find the relocated program headers.
+// * Notes being overwritten are written over in place when the new note fits
+//   in their slot, i.e. the old note and the unnamed padding notes right
+//   after it, such as the room left with `Resource::reserve`. The rest of the
+//   slot is kept as a padding note, so only the slot itself is written.
+// * Otherwise they're turned into unnamed padding notes of the same size,
+//   which lookups skip, and the new notes are appended as above. If the old
+//   note is the last one of segments that are extended, the new notes are
+//   written over it instead, so that overwriting it doesn't grow the file.
+//
+// The cost is proportional to the size of the resources rather than to the
+// size and complexity of the binary. Since only the headers and notes are
+// read, the executable doesn't have to be loaded in memory, see
+// `ExecutableInput`.
+
+// Where and how a single note is written
+struct ElfNoteLayout {
+  // File offset of the note, either after the input or over the slot of the
+  // note it replaces
+  uint64_t offset = 0;
+
+  // Alignment padding, the note header and the name, which are followed by
+  // the description (i.e. the resource data) and zero padding up to a
+  // multiple of 4 bytes
+  std::vector<uint8_t> prefix;
+
+  // Then the header of an unnamed note holding the room left after the
+  // description, if any, followed by `reserved` zero bytes
+  std::vector<uint8_t> suffix;
+  uint64_t reserved = 0;
+};
+
+// The slot of an existing note, i.e. the note and the unnamed or replaced
+// notes right after it, which a new note can be written over
+struct ElfNoteSlot {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  bool big_endian = false;
+};
+
+struct ElfNotePlan {
+  // Header fields to rewrite, as (file offset, new bytes). This includes the
+  // new program header table, if there is one, which is appended.
+  std::vector<std::pair<uint64_t, std::vector<uint8_t>>> patches;
+
+  // The input is zero-padded up to `append_offset`, where the appended notes
+  // start, and the output is `size` bytes
+  uint64_t append_offset = 0;
+  uint64_t size = 0;
+
+  // One for each note
+  std::vector<ElfNoteLayout> notes;
+};
+
+enum class ElfPlanResult {
+  kSuccess,
+  kAlreadyExists,
+  // The fast path can't handle this binary, use LIEF instead
+  kUnsupported,
+  // A note is larger than its 32-bit size field, or an ELF32 output would be
+  // larger than its 32-bit offsets, which LIEF can't handle either
+  kTooLarge
+};
+
+ElfPlanResult plan_elf_notes(const ExecutableInput& executable,
+                             const std::vector<Resource>& notes,
+                             bool overwrite,
+                             ElfNotePlan* plan);
+
+// Finds the slot of the note named `note_name` in the PT_NOTE segments
+bool find_elf_note_slot(const ExecutableInput& executable,
+                        const std::string& note_name,
+                        ElfNoteSlot* slot);
+
+// Lists the notes in the PT_NOTE segments that lookups consider resources,
+// with the offsets and sizes of their descriptions
+bool list_elf_notes(const ExecutableInput& executable,
+                    std::vector<ResourceInfo>* notes);
+
+// Lays out `note` over `slot` if it fits along with the room it reserves. The
+// rest of the slot becomes a padding note, or extra NUL bytes after the name
+// when it's too small for a note header, which doesn't move aligned data.
+bool layout_note_in_slot(const ElfNoteSlot& slot,
+                         const Resource& note,
+                         ElfNoteLayout* layout);
+
+// The size of the description to have LIEF lay out for `note`, i.e. the data
+// followed by the room it reserves, if any, with space for the header of the
+// padding note that holds the room
+uint64_t reserved_note_size(const Resource& note);
+
+// Patches the note LIEF laid out for `note` in `build`, with a description of
+// `reserved_note_size()` bytes, into the note itself followed by a padding note
+// holding the room it reserves, as `layout_note_in_slot()` does
+bool find_reserved_note_patches(
+    const ExecutableInput& build,
+    const Resource& note,
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>>* patches);
+
+void apply_elf_note_plan(const std::vector<uint8_t>& executable,
+                         const ElfNotePlan& plan,
+                         const std::vector<Resource>& notes,
+                         std::vector<uint8_t>* output);
+
+// Streams the planned output to `output`. If it's the same file as
+// `executable`, only the patched headers and the notes are written.
+bool write_elf_note_plan(std::FILE* executable,
+                         uint64_t executable_size,
+                         const ElfNotePlan& plan,
+                         const std::vector<Resource>& notes,
+                         std::FILE* output);
+
+// The number of bytes `write_elf_note_plan()` writes when the output is the
+// executable itself, i.e. everything but the unchanged parts of the input
+uint64_t elf_note_plan_write_size(const ElfNotePlan& plan,
+                                  const std::vector<Resource>& notes,
+                                  uint64_t executable_size);
+
+#endif  // POSTJECT_ELF_WRITER_H_
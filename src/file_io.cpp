@@ -0,0 +1,204 @@
+// Make off_t 64-bit on 32-bit platforms as well
+#define _FILE_OFFSET_BITS 64
+
+#include "file_io.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+const size_t kCopyChunkSize = 1024 * 1024;
+
+int seek(std::FILE* file, uint64_t offset, int origin) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), origin);
+#else
+  return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+int64_t tell(std::FILE* file) {
+#ifdef _WIN32
+  return _ftelli64(file);
+#else
+  return ftello(file);
+#endif
+}
+
+// Copies `size` bytes from the current position of `from` to the current
+// position of `to`
+bool copy_chunks(std::FILE* from, std::FILE* to, uint64_t size) {
+  std::vector<uint8_t> chunk(
+      static_cast<size_t>(std::min<uint64_t>(size, kCopyChunkSize)));
+
+  while (size > 0) {
+    const size_t chunk_size =
+        static_cast<size_t>(std::min<uint64_t>(size, chunk.size()));
+
+    if (std::fread(chunk.data(), 1, chunk_size, from) != chunk_size ||
+        std::fwrite(chunk.data(), 1, chunk_size, to) != chunk_size) {
+      return false;
+    }
+
+    size -= chunk_size;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+FilePtr open_file(const std::string& filename, const char* mode) {
+  return FilePtr(std::fopen(filename.c_str(), mode));
+}
+
+bool get_file_size(std::FILE* file, uint64_t* size) {
+  if (seek(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+
+  int64_t position = tell(file);
+  if (position < 0) {
+    return false;
+  }
+
+  *size = static_cast<uint64_t>(position);
+  return true;
+}
+
+bool read_at(std::FILE* file, uint64_t offset, size_t size, uint8_t* output) {
+  return seek(file, offset, SEEK_SET) == 0 &&
+         std::fread(output, 1, size, file) == size;
+}
+
+bool write_at(std::FILE* file,
+              uint64_t offset,
+              const uint8_t* data,
+              size_t size) {
+  return seek(file, offset, SEEK_SET) == 0 &&
+         std::fwrite(data, 1, size, file) == size;
+}
+
+bool append(std::FILE* file, const uint8_t* data, size_t size) {
+  return size == 0 || (seek(file, 0, SEEK_END) == 0 &&
+                       std::fwrite(data, 1, size, file) == size);
+}
+
+bool write_zeros(std::FILE* file, uint64_t size) {
+  static const uint8_t zeros[64 * 1024] = {};
+
+  while (size > 0) {
+    const size_t chunk_size =
+        static_cast<size_t>(std::min<uint64_t>(size, sizeof(zeros)));
+    if (std::fwrite(zeros, 1, chunk_size, file) != chunk_size) {
+      return false;
+    }
+    size -= chunk_size;
+  }
+
+  return true;
+}
+
+bool copy_file_contents(std::FILE* from,
+                        std::FILE* to,
+                        uint64_t size,
+                        uint64_t from_offset,
+                        uint64_t to_offset) {
+  if (seek(from, from_offset, SEEK_SET) != 0 ||
+      seek(to, to_offset, SEEK_SET) != 0) {
+    return false;
+  }
+
+  return copy_chunks(from, to, size);
+}
+
+bool append_file_contents(std::FILE* from, std::FILE* to, uint64_t size) {
+  if (seek(from, 0, SEEK_SET) != 0 || seek(to, 0, SEEK_END) != 0) {
+    return false;
+  }
+
+  return copy_chunks(from, to, size);
+}
+
+bool is_regular_file(std::FILE* file) {
+#ifdef _WIN32
+  struct _stat64 info;
+  return _fstat64(_fileno(file), &info) == 0 && (info.st_mode & _S_IFREG) != 0;
+#else
+  struct stat info;
+  return fstat(fileno(file), &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+bool resize_file(std::FILE* file, uint64_t size) {
+  if (std::fflush(file) != 0) {
+    return false;
+  }
+
+#ifdef _WIN32
+  return _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+#else
+  return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool clone_file(std::FILE* from, std::FILE* to) {
+#if defined(FICLONE) && !defined(__EMSCRIPTEN__)
+  return ioctl(fileno(to), FICLONE, fileno(from)) == 0;
+#else
+  (void)from;
+  (void)to;
+  return false;
+#endif
+}
+
+bool copy_file_mode(std::FILE* from, std::FILE* to) {
+#ifdef _WIN32
+  (void)from;
+  (void)to;
+  return true;
+#else
+  struct stat info;
+  return fstat(fileno(from), &info) == 0 &&
+         fchmod(fileno(to), info.st_mode & 07777) == 0;
+#endif
+}
+
+bool replace_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool BufferInput::read(uint64_t offset, size_t size, uint8_t* output) const {
+  if (offset > executable_.size() || size > executable_.size() - offset) {
+    return false;
+  }
+
+  std::copy(executable_.begin() + offset, executable_.begin() + offset + size,
+            output);
+  return true;
+}
+
+bool FileInput::read(uint64_t offset, size_t size, uint8_t* output) const {
+  return offset <= size_ && size <= size_ - offset &&
+         read_at(file_, offset, size, output);
+}
@@ -0,0 +1,99 @@
+#ifndef POSTJECT_FILE_IO_H_
+#define POSTJECT_FILE_IO_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Small helpers around stdio used by the file-based injection functions, with
+// 64-bit offsets so that executables larger than 2 GB work on all platforms.
+
+struct FileCloser {
+  void operator()(std::FILE* file) const { std::fclose(file); }
+};
+
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+FilePtr open_file(const std::string& filename, const char* mode);
+
+bool get_file_size(std::FILE* file, uint64_t* size);
+
+bool read_at(std::FILE* file, uint64_t offset, size_t size, uint8_t* output);
+
+bool write_at(std::FILE* file,
+              uint64_t offset,
+              const uint8_t* data,
+              size_t size);
+
+// Appends `size` bytes at the end of the file
+bool append(std::FILE* file, const uint8_t* data, size_t size);
+
+// Writes `size` zero bytes at the current position, e.g. after `write_at()`
+bool write_zeros(std::FILE* file, uint64_t size);
+
+// Copies `size` bytes of `from`, starting at `from_offset`, to `to`, starting
+// at `to_offset`, in chunks
+bool copy_file_contents(std::FILE* from,
+                        std::FILE* to,
+                        uint64_t size,
+                        uint64_t from_offset = 0,
+                        uint64_t to_offset = 0);
+
+// Appends the first `size` bytes of `from` to the end of `to`, in chunks
+bool append_file_contents(std::FILE* from, std::FILE* to, uint64_t size);
+
+// Whether the file is a regular file, rather than e.g. a directory, which
+// `get_file_size()` can't tell apart
+bool is_regular_file(std::FILE* file);
+
+// Truncates or extends the file to `size` bytes
+bool resize_file(std::FILE* file, uint64_t size);
+
+// Makes `to` share the data of `from`, on file systems that support it
+bool clone_file(std::FILE* from, std::FILE* to);
+
+// Gives `to` the permissions of `from`, which replacing the output would lose
+bool copy_file_mode(std::FILE* from, std::FILE* to);
+
+// Atomically replaces the file at `to` with the one at `from`
+bool replace_file(const std::string& from, const std::string& to);
+
+// Random access to an executable, so that the fast paths only have to read its
+// headers rather than load it in memory as a whole
+class ExecutableInput {
+ public:
+  virtual ~ExecutableInput() = default;
+
+  virtual uint64_t size() const = 0;
+
+  // Reads `size` bytes at `offset`, returns false if they're out of bounds
+  virtual bool read(uint64_t offset, size_t size, uint8_t* output) const = 0;
+};
+
+class BufferInput : public ExecutableInput {
+ public:
+  explicit BufferInput(const std::vector<uint8_t>& executable)
+      : executable_(executable) {}
+
+  uint64_t size() const override { return executable_.size(); }
+  bool read(uint64_t offset, size_t size, uint8_t* output) const override;
+
+ private:
+  const std::vector<uint8_t>& executable_;
+};
+
+class FileInput : public ExecutableInput {
+ public:
+  FileInput(std::FILE* file, uint64_t size) : file_(file), size_(size) {}
+
+  uint64_t size() const override { return size_; }
+  bool read(uint64_t offset, size_t size, uint8_t* output) const override;
+
+ private:
+  std::FILE* file_;
+  uint64_t size_;
+};
+
+#endif  // POSTJECT_FILE_IO_H_
@@ -0,0 +1,353 @@
+// Native command line interface for postject. It mirrors src/cli.js, but
+// calls the injection logic directly instead of going through the WASM build,
+// so it runs LIEF at native speed and isn't limited by the 4 GB WASM heap.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "checksum.h"
+#include "compression.h"
+#include "file_io.h"
+#include "postject.h"
+
+namespace {
+
+const char kDefaultSentinelFuse[] =
+    "POSTJECT_SENTINEL_fce680ab2cc467b6e072b8b5df1996b2";
+
+void print_usage() {
+  std::cout
+      << "Usage: postject [options] <filename> <resource_name> <resource> "
+         "[more_resources...]\n"
+         "\n"
+         "Inject arbitrary read-only resources into an executable for use at "
+         "runtime\n"
+         "\n"
+         "Arguments:\n"
+         "  filename                             The executable to inject "
+         "into\n"
+         "  resource_name                        The resource name to use "
+         "(section name on Mach-O and ELF, resource name for PE)\n"
+         "  resource                             The resource to inject\n"
+         "  more_resources                       Additional resource_name and "
+         "resource pairs, injected in the same pass\n"
+         "\n"
+         "Options:\n"
+         "  --macho-segment-name <segment_name>  Name for the Mach-O segment "
+         "(default: \"__POSTJECT\")\n"
+         "  --sentinel-fuse <sentinel_fuse>      Sentinel fuse for resource "
+         "presence detection\n"
+         "  --overwrite                          Overwrite the resource if it "
+         "already exists\n"
+         "  --compress                           Compress the resources, read "
+         "them with postject_find_resource_decompressed()\n"
+         "  --checksum                           Store checksums with the "
+         "resources, check them with postject_verify_resource()\n"
+         "  --align <bytes>                      Align the resources in the "
+         "file and in memory, e.g. to the page size (ELF only)\n"
+         "  --reserve <bytes>                    Leave room for the resources "
+         "to later be overwritten in place with up to this many bytes\n"
+         "  --detach                             Store the resources outside "
+         "the loaded image, map them with postject_map_resource() (ELF and "
+         "PE only)\n"
+         "  --timings                            Print how long each phase "
+         "took and the bytes copied and written as JSON\n"
+         "  -h, --help                           display help for command\n";
+}
+
+void print_error(const std::string& message) {
+  std::cout << "\x1b[31mError: " << message << "\x1b[0m" << std::endl;
+}
+
+bool read_file(const std::string& filename, std::vector<uint8_t>* contents) {
+  // 64-bit sizes, since `long` is 32-bit on Windows and resources can be
+  // larger than 2 GB
+  FilePtr file = open_file(filename, "rb");
+  uint64_t size = 0;
+  if (!file || !get_file_size(file.get(), &size) ||
+      size > std::numeric_limits<size_t>::max()) {
+    return false;
+  }
+
+  // Read the whole file with a single call, rather than going through a
+  // stream, since the executables we deal with can be hundreds of MB
+  contents->resize(static_cast<size_t>(size));
+  return read_at(file.get(), 0, contents->size(), contents->data());
+}
+
+bool print_sentinel_fuse_error(SentinelFuseResult result,
+                               const std::string& sentinel_fuse) {
+  switch (result) {
+    case SentinelFuseResult::kSuccess:
+      return false;
+
+    case SentinelFuseResult::kNotFound:
+      print_error("Could not find the sentinel " + sentinel_fuse +
+                  " in the binary");
+      break;
+
+    case SentinelFuseResult::kMultipleFound:
+      print_error("Multiple occurences of sentinel \"" + sentinel_fuse +
+                  "\" found in the binary");
+      break;
+
+    case SentinelFuseResult::kInvalidValue:
+      print_error("Value after the sentinel must be ':0' or ':1'");
+      break;
+
+    case SentinelFuseResult::kError:
+      print_error("Couldn't write executable");
+      break;
+  }
+
+  return true;
+}
+
+// Same fields as the report `--timings` prints in src/cli.js, except for the
+// peak heap, which only the Node.js process knows about
+void print_timings(const InjectStats& stats, uint64_t bytes_copied) {
+  double total_milliseconds = 0;
+  std::cout << "{\n  \"engine\": \"native\",\n  \"phases\": [";
+  for (size_t i = 0; i < stats.phases.size(); i++) {
+    const InjectStats::Phase& phase = stats.phases[i];
+    total_milliseconds += phase.milliseconds;
+    std::cout << (i > 0 ? ",\n" : "\n") << "    { \"name\": \"" << phase.name
+              << "\", \"ms\": " << phase.milliseconds << " }";
+  }
+  std::cout << "\n  ],\n  \"totalMs\": " << total_milliseconds
+            << ",\n  \"bytesCopied\": " << bytes_copied
+            << ",\n  \"bytesWritten\": " << stats.bytes_written << "\n}"
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> arguments;
+  std::string macho_segment_name = "__POSTJECT";
+  std::string sentinel_fuse = kDefaultSentinelFuse;
+  bool overwrite = false;
+  bool compress = false;
+  bool checksum = false;
+  bool detached = false;
+  bool timings = false;
+  uint64_t alignment = 0;
+  uint64_t reserve = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "-h" || arg == "--help") {
+      print_usage();
+      return 0;
+    } else if (arg == "--overwrite") {
+      overwrite = true;
+    } else if (arg == "--compress") {
+      compress = true;
+    } else if (arg == "--checksum") {
+      checksum = true;
+    } else if (arg == "--detach") {
+      detached = true;
+    } else if (arg == "--timings") {
+      timings = true;
+    } else if (arg == "--align" && i + 1 < argc) {
+      char* end = nullptr;
+      alignment = std::strtoull(argv[++i], &end, 10);
+      if (*end != '\0' || alignment == 0 ||
+          (alignment & (alignment - 1)) != 0) {
+        std::cerr << "error: --align must be a power of two" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--reserve" && i + 1 < argc) {
+      char* end = nullptr;
+      reserve = std::strtoull(argv[++i], &end, 10);
+      if (*end != '\0') {
+        std::cerr << "error: --reserve must be a number of bytes" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--macho-segment-name" && i + 1 < argc) {
+      macho_segment_name = argv[++i];
+    } else if (arg == "--sentinel-fuse" && i + 1 < argc) {
+      sentinel_fuse = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      std::cerr << "error: unknown option '" << arg << "'" << std::endl;
+      return 1;
+    } else {
+      arguments.push_back(arg);
+    }
+  }
+
+  if (arguments.size() < 3 || arguments.size() % 2 != 1) {
+    std::cerr << "error: missing required arguments" << std::endl;
+    print_usage();
+    return 1;
+  }
+
+  const std::string& filename = arguments[0];
+  std::vector<std::string> resource_names;
+  std::vector<std::vector<uint8_t>> resource_data(arguments.size() / 2);
+  std::vector<std::string> resource_files(arguments.size() / 2);
+  uint64_t bytes_copied = 0;
+
+  // Detached resources are streamed from their files, unless they have to be
+  // transformed first, so that they don't have to fit in memory
+  const bool streamed = detached && !compress && !checksum;
+
+  for (size_t i = 1; i < arguments.size(); i += 2) {
+    resource_names.push_back(arguments[i]);
+    if (streamed) {
+      FilePtr file = open_file(arguments[i + 1], "rb");
+      uint64_t size = 0;
+      if (!file || !get_file_size(file.get(), &size)) {
+        print_error("Can't read resource file");
+        return 1;
+      }
+      resource_files[i / 2] = arguments[i + 1];
+      bytes_copied += size;
+      continue;
+    }
+
+    if (!read_file(arguments[i + 1], &resource_data[i / 2])) {
+      print_error("Can't read resource file");
+      return 1;
+    }
+
+    if (compress) {
+      resource_data[i / 2] = compress_resource(resource_data[i / 2]);
+    }
+
+    // Of the data as stored, i.e. after compressing it
+    if (checksum) {
+      resource_data[i / 2] = add_resource_checksum(resource_data[i / 2]);
+    }
+  }
+
+  std::string joined_names;
+  for (const std::string& name : resource_names) {
+    joined_names += (joined_names.empty() ? "" : ", ") + name;
+  }
+
+  std::cout << "\x1b[36mStart injection of " << joined_names << " in "
+            << filename << "...\x1b[0m" << std::endl;
+
+  if (!open_file(filename, "r+b")) {
+    print_error("Can't read and write to target executable");
+    return 1;
+  }
+
+  // The executable is injected into in place, without loading it in memory
+  // as a whole when the format allows it
+  ExecutableFormat format = get_executable_format_of_file(filename);
+  std::vector<Resource> resources;
+
+  if (detached && format == ExecutableFormat::kMachO) {
+    print_error("--detach is only supported for ELF and PE executables");
+    return 1;
+  }
+
+  if (alignment != 0 && format != ExecutableFormat::kELF) {
+    print_error("--align is only supported for ELF executables");
+    return 1;
+  }
+
+  for (size_t i = 0; i < resource_names.size(); i++) {
+    std::string name = resource_names[i];
+
+    if (format == ExecutableFormat::kMachO && name.compare(0, 2, "__") != 0) {
+      // Mach-O section names are conventionally of the style __foo
+      name = "__" + name;
+    } else if (format == ExecutableFormat::kPE) {
+      // PE resource names appear to only work if uppercase
+      std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    }
+
+    Resource resource;
+    resource.name = name;
+    resource.data = streamed ? nullptr : &resource_data[i];
+    resource.alignment = alignment;
+    resource.reserve = reserve;
+    resource.detached = detached;
+    resource.file = resource_files[i];
+    resources.push_back(resource);
+    bytes_copied += resource_data[i].size();
+  }
+
+  InjectResult result = InjectResult::kError;
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+
+  switch (format) {
+    case ExecutableFormat::kMachO:
+      result = inject_many_into_macho_file(
+          filename, macho_segment_name, resources, overwrite, filename,
+          sentinel_fuse, &fuse_result, &stats);
+
+      if (result == InjectResult::kAlreadyExists) {
+        print_error("Segment and section with that name already exists: " +
+                    macho_segment_name + "/" + joined_names +
+                    "\nUse --overwrite to overwrite the existing content");
+        return 1;
+      }
+      break;
+
+    case ExecutableFormat::kELF:
+      result = inject_many_into_elf_file(filename, resources, overwrite,
+                                         filename, sentinel_fuse, &fuse_result,
+                                         &stats);
+
+      if (result == InjectResult::kAlreadyExists) {
+        print_error("Section with that name already exists: " + joined_names +
+                    "\nUse --overwrite to overwrite the existing content");
+        return 1;
+      }
+      break;
+
+    case ExecutableFormat::kPE:
+      result = inject_many_into_pe_file(filename, resources, overwrite,
+                                        filename, sentinel_fuse, &fuse_result,
+                                        &stats);
+
+      if (result == InjectResult::kAlreadyExists) {
+        print_error("Resource with that name already exists: " + joined_names +
+                    "\nUse --overwrite to overwrite the existing content");
+        return 1;
+      }
+      break;
+
+    case ExecutableFormat::kUnknown:
+      print_error("Executable must be a supported format: ELF, PE, or Mach-O");
+      return 1;
+  }
+
+  if (result == InjectResult::kTooLarge) {
+    print_error(
+        "Resource is too large for the executable format, use --detach for "
+        "resources of 4 GB or more");
+    return 1;
+  }
+
+  // The fuse is checked before anything is written, so the executable is
+  // left as it was if it can't be flipped
+  if (print_sentinel_fuse_error(fuse_result, sentinel_fuse)) {
+    return 1;
+  }
+
+  if (result != InjectResult::kSuccess) {
+    print_error("Error when injecting resource");
+    return 1;
+  }
+
+  std::cout << "\x1b[32m\xF0\x9F\x92\x89 Injection done!\x1b[0m" << std::endl;
+
+  if (timings) {
+    print_timings(stats, bytes_copied);
+  }
+  return 0;
+}
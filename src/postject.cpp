@@ -1,135 +1,491 @@
 #include <algorithm>
+#include <chrono>
 #include <codecvt>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <locale>
 #include <memory>
 #include <vector>
 
-#include <emscripten/bind.h>
-#include <emscripten/val.h>
+// The WASM build isn't linked with pthreads, so Mach-O slices are built one
+// after the other there
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define POSTJECT_HAS_THREADS
+#include <thread>
+#endif
 
 #include <LIEF/LIEF.hpp>
 
-enum class ExecutableFormat { kELF, kMachO, kPE, kUnknown };
+#include "delta_writer.h"
+#include "elf_writer.h"
+#include "file_io.h"
+#include "postject.h"
+#include "slot_writer.h"
 
-enum class InjectResult { kAlreadyExists, kError, kSuccess };
-
-std::vector<uint8_t> vec_from_val(const emscripten::val& value) {
-  // We are using `convertJSArrayToNumberVector()` instead of `vecFromJSArray()`
-  // because it is faster. It is okay if we use it without additional type
-  // checking because this function is only called on Node.js Buffer instances
-  // which is expected to contain elements that are safe to pass to the JS
-  // function, `Number()`.
-  return emscripten::convertJSArrayToNumberVector<uint8_t>(value);
-}
-
-ExecutableFormat get_executable_format(const emscripten::val& executable) {
-  std::vector<uint8_t> buffer = vec_from_val(executable);
-
-  if (LIEF::ELF::is_elf(buffer)) {
+ExecutableFormat get_executable_format(const std::vector<uint8_t>& executable) {
+  if (LIEF::ELF::is_elf(executable)) {
     return ExecutableFormat::kELF;
-  } else if (LIEF::MachO::is_macho(buffer)) {
+  } else if (LIEF::MachO::is_macho(executable)) {
     return ExecutableFormat::kMachO;
-  } else if (LIEF::PE::is_pe(buffer)) {
+  } else if (LIEF::PE::is_pe(executable)) {
     return ExecutableFormat::kPE;
   }
 
   return ExecutableFormat::kUnknown;
 }
 
-emscripten::val inject_into_elf(const emscripten::val& executable,
-                                const std::string& note_name,
-                                const emscripten::val& data,
-                                bool overwrite = false) {
-  emscripten::val object = emscripten::val::object();
-  object.set("data", emscripten::val::undefined());
+namespace {
 
-  std::unique_ptr<LIEF::ELF::Binary> binary =
-      LIEF::ELF::Parser::parse(vec_from_val(executable));
+// Records consecutive phases of an injection into `stats`, unless it's null.
+// Starting a phase ends the previous one, and the last one ends with the
+// recorder.
+class PhaseRecorder {
+ public:
+  explicit PhaseRecorder(InjectStats* stats) : stats_(stats) {}
+  ~PhaseRecorder() { end(); }
 
-  if (!binary) {
-    object.set("result", emscripten::val(InjectResult::kError));
-    return object;
+  void phase(const char* name) {
+    end();
+    name_ = name;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void written(uint64_t bytes) {
+    if (stats_ != nullptr) {
+      stats_->bytes_written += bytes;
+    }
+  }
+
+ private:
+  void end() {
+    if (stats_ != nullptr && name_ != nullptr) {
+      const std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start_;
+      stats_->phases.push_back(InjectStats::Phase{name_, elapsed.count()});
+    }
+    name_ = nullptr;
+  }
+
+  InjectStats* stats_;
+  const char* name_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Header fields to rewrite in a build, as (offset, new bytes)
+using Patches = std::vector<std::pair<uint64_t, std::vector<uint8_t>>>;
+
+void apply_patches(const Patches& patches, std::vector<uint8_t>* build) {
+  for (const auto& patch : patches) {
+    std::copy(patch.second.begin(), patch.second.end(),
+              build->begin() + patch.first);
+  }
+}
+
+bool write_patches(const Patches& patches, std::FILE* output) {
+  for (const auto& patch : patches) {
+    if (!write_at(output, patch.first, patch.second.data(),
+                  patch.second.size())) {
+      return false;
+    }
+  }
+  return patches.empty() || std::fflush(output) == 0;
+}
+
+const size_t kFuseChunkSize = 1024 * 1024;
+
+// Finds the fuse in a single pass, stopping at the second occurrence since
+// there must only be one. Candidates are found with memchr(), which the C
+// library vectorizes, and only those are compared in full. Returns the number
+// of occurrences found, and stores the offset of the first one in `offset`.
+size_t find_sentinel_fuse(const uint8_t* data,
+                          size_t size,
+                          const std::string& sentinel_fuse,
+                          size_t* offset) {
+  const size_t fuse_size = sentinel_fuse.size();
+  const uint8_t* position = data;
+  const uint8_t* const end = data + size;
+  size_t count = 0;
+
+  while (count < 2 && static_cast<size_t>(end - position) >= fuse_size) {
+    const size_t candidates = end - position - fuse_size + 1;
+    position = static_cast<const uint8_t*>(
+        std::memchr(position, sentinel_fuse[0], candidates));
+    if (position == nullptr) {
+      break;
+    }
+
+    if (std::memcmp(position, sentinel_fuse.data(), fuse_size) == 0) {
+      if (count == 0) {
+        *offset = position - data;
+      }
+      count++;
+    }
+    position++;
+  }
+
+  return count;
+}
+
+// The two bytes after the fuse must be ':0' or ':1'
+bool is_sentinel_fuse_value(const uint8_t* value) {
+  return value[0] == ':' && (value[1] == '0' || value[1] == '1');
+}
+
+// Finds the fuse in `data`, which must hold it exactly once, and stores the
+// offset of the '0' or '1' after it in `value_offset`
+SentinelFuseResult find_sentinel_fuse_value(const uint8_t* data,
+                                            size_t size,
+                                            const std::string& sentinel_fuse,
+                                            uint64_t* value_offset) {
+  size_t fuse_offset = 0;
+  switch (find_sentinel_fuse(data, size, sentinel_fuse, &fuse_offset)) {
+    case 0:
+      return SentinelFuseResult::kNotFound;
+    case 1:
+      break;
+    default:
+      return SentinelFuseResult::kMultipleFound;
+  }
+
+  const size_t value = fuse_offset + sentinel_fuse.size();
+  if (size - value < 2 || !is_sentinel_fuse_value(data + value)) {
+    return SentinelFuseResult::kInvalidValue;
+  }
+
+  *value_offset = value + 1;
+  return SentinelFuseResult::kSuccess;
+}
+
+// Same as find_sentinel_fuse_value(), but reads the `size` bytes of the file at
+// `start` in chunks. `value_offset` is relative to the file.
+SentinelFuseResult find_sentinel_fuse_value_in_file(
+    std::FILE* file,
+    uint64_t start,
+    uint64_t size,
+    const std::string& sentinel_fuse,
+    uint64_t* value_offset) {
+  // Consecutive chunks overlap by one byte less than the fuse, so that every
+  // occurrence is seen exactly once
+  const size_t overlap = sentinel_fuse.size() - 1;
+  std::vector<uint8_t> chunk(overlap + kFuseChunkSize);
+  uint64_t chunk_offset = 0;
+  size_t carried = 0;
+  bool found = false;
+  uint64_t fuse_offset = 0;
+
+  for (uint64_t position = 0; position < size;) {
+    const size_t read_size = static_cast<size_t>(
+        std::min<uint64_t>(size - position, kFuseChunkSize));
+    if (!read_at(file, start + position, read_size, chunk.data() + carried)) {
+      return SentinelFuseResult::kError;
+    }
+
+    const auto end = chunk.begin() + carried + read_size;
+    size_t match = 0;
+    const size_t count = find_sentinel_fuse(chunk.data(), carried + read_size,
+                                            sentinel_fuse, &match);
+
+    if (count > 0) {
+      if (found || count > 1) {
+        return SentinelFuseResult::kMultipleFound;
+      }
+
+      found = true;
+      fuse_offset = chunk_offset + match;
+    }
+
+    position += read_size;
+    carried = std::min<size_t>(overlap, carried + read_size);
+    std::copy(end - carried, end, chunk.begin());
+    chunk_offset = position - carried;
+  }
+
+  if (!found) {
+    return SentinelFuseResult::kNotFound;
+  }
+
+  uint8_t value[2];
+  const uint64_t value_start = fuse_offset + sentinel_fuse.size();
+  if (size - value_start < sizeof(value) ||
+      !read_at(file, start + value_start, sizeof(value), value) ||
+      !is_sentinel_fuse_value(value)) {
+    return SentinelFuseResult::kInvalidValue;
+  }
+
+  *value_offset = start + value_start + 1;
+  return SentinelFuseResult::kSuccess;
+}
+
+// Adds flipping the fuse from `:0` to `:1` to the patches of the injection,
+// unless `sentinel_fuse` is empty, so that it's written along with the
+// resources. Returns false, with the reason in `result`, if the fuse can't be
+// flipped, before anything was written.
+bool add_sentinel_fuse_patch(const uint8_t* data,
+                             size_t size,
+                             const std::string& sentinel_fuse,
+                             Patches* patches,
+                             SentinelFuseResult* result) {
+  uint64_t value_offset = 0;
+  if (!sentinel_fuse.empty()) {
+    *result =
+        find_sentinel_fuse_value(data, size, sentinel_fuse, &value_offset);
+    if (*result != SentinelFuseResult::kSuccess) {
+      return false;
+    }
+    patches->emplace_back(value_offset, std::vector<uint8_t>{'1'});
+  }
+  return true;
+}
+
+// Same as add_sentinel_fuse_patch(), for an executable that's only partially
+// rewritten in place, which is scanned in chunks. Every slice of a fat binary
+// has a fuse of its own, as when LIEF rebuilds the slices, see
+// inject_many_into_macho_file().
+bool add_sentinel_fuse_patch_in_file(std::FILE* file,
+                                     uint64_t size,
+                                     const std::string& sentinel_fuse,
+                                     Patches* patches,
+                                     SentinelFuseResult* result) {
+  if (sentinel_fuse.empty()) {
+    return true;
+  }
+
+  std::vector<MachOSlice> slices;
+  if (!read_macho_slices(FileInput(file, size), &slices)) {
+    *result = SentinelFuseResult::kError;
+    return false;
+  }
+
+  for (const MachOSlice& slice : slices) {
+    uint64_t value_offset = 0;
+    *result = find_sentinel_fuse_value_in_file(file, slice.offset, slice.size,
+                                               sentinel_fuse, &value_offset);
+    if (*result != SentinelFuseResult::kSuccess) {
+      return false;
+    }
+    patches->emplace_back(value_offset, std::vector<uint8_t>{'1'});
+  }
+  return true;
+}
+
+// The data LIEF lays out for a resource, which is zero-padded to the room the
+// resource reserves. The size is set back to that of the data after the
+// build, see find_reserved_size_patches().
+std::vector<uint8_t> resource_content(const Resource& resource) {
+  std::vector<uint8_t> content(*resource.data);
+  if (resource.reserve > content.size()) {
+    content.resize(resource.reserve, 0);
+  }
+  return content;
+}
+
+// Same as resource_content(), for an ELF note, which also leaves room for the
+// padding note holding the room, see reserved_note_size()
+std::vector<uint8_t> note_content(const Resource& resource) {
+  std::vector<uint8_t> content(*resource.data);
+  content.resize(static_cast<size_t>(reserved_note_size(resource)), 0);
+  return content;
+}
+
+bool find_reserved_size_patches(ExecutableFormat format,
+                                const std::vector<uint8_t>& build,
+                                const std::string& segment_name,
+                                const std::vector<Resource>& resources,
+                                Patches* patches) {
+  for (const Resource& resource : resources) {
+    if (resource.reserve <= resource.data->size()) {
+      continue;
+    }
+
+    if (format == ExecutableFormat::kELF) {
+      if (!find_reserved_note_patches(BufferInput(build), resource, patches)) {
+        return false;
+      }
+      continue;
+    }
+
+    std::vector<ResourceSlot> slots(1);
+    if (format == ExecutableFormat::kMachO
+            ? !find_macho_slots(BufferInput(build), segment_name,
+                                resource.name, &slots)
+            : !find_pe_slot(BufferInput(build), resource.name, &slots[0])) {
+      return false;
+    }
+
+    for (const ResourceSlot& slot : slots) {
+      patches->emplace_back(slot.size_field,
+                            encode_slot_size(slot, resource.data->size()));
+    }
+  }
+
+  return true;
+}
+
+// `plan_macho_overwrite()` or `plan_pe_overwrite()`, bound to the resources
+using OverwritePlanner =
+    std::function<bool(const ExecutableInput&, std::vector<SlotWrite>*)>;
+
+// Writes the resources over their slots if they all fit, see slot_writer.h.
+// Returns false if they don't, leaving the injection to LIEF.
+bool overwrite_slots(const std::vector<uint8_t>& executable,
+                     const OverwritePlanner& plan,
+                     PhaseRecorder* recorder,
+                     std::vector<uint8_t>* output) {
+  std::vector<SlotWrite> writes;
+  recorder->phase("plan");
+  if (!plan(BufferInput(executable), &writes)) {
+    return false;
+  }
+
+  recorder->phase("write");
+  apply_slot_writes(executable, writes, output);
+  recorder->written(output->size());
+  return true;
+}
+
+// Same as overwrite_slots(), but only writes the slots when the output is the
+// executable itself, along with flipping the fuse, see
+// add_sentinel_fuse_patch(). Sets `result` unless it returns false.
+bool overwrite_slots_in_file(const std::string& executable_path,
+                             const std::string& output_path,
+                             const OverwritePlanner& plan,
+                             const std::string& sentinel_fuse,
+                             SentinelFuseResult* sentinel_fuse_result,
+                             PhaseRecorder* recorder,
+                             InjectResult* result) {
+  const bool in_place = executable_path == output_path;
+  FilePtr executable = open_file(executable_path, in_place ? "r+b" : "rb");
+  uint64_t size = 0;
+  std::vector<SlotWrite> writes;
+
+  recorder->phase("plan");
+  if (!executable || !get_file_size(executable.get(), &size) ||
+      !plan(FileInput(executable.get(), size), &writes)) {
+    return false;
+  }
+
+  recorder->phase("fuse");
+  Patches patches;
+  if (!add_sentinel_fuse_patch_in_file(executable.get(), size, sentinel_fuse,
+                                       &patches, sentinel_fuse_result)) {
+    *result = InjectResult::kError;
+    return true;
+  }
+
+  recorder->phase("write");
+  FilePtr output;
+  if (!in_place && !(output = open_file(output_path, "wb"))) {
+    *result = InjectResult::kError;
+    return true;
   }
 
+  std::FILE* destination = in_place ? executable.get() : output.get();
+  if (!write_slot_writes(executable.get(), size, writes, destination) ||
+      !write_patches(patches, destination)) {
+    *result = InjectResult::kError;
+    return true;
+  }
+
+  recorder->written(in_place ? slot_writes_size(writes) + patches.size()
+                             : size);
+  *result = InjectResult::kSuccess;
+  return true;
+}
+
+InjectResult add_elf_note(LIEF::ELF::Binary* binary,
+                          const Resource& resource,
+                          bool overwrite) {
   LIEF::ELF::Note* existing_note = nullptr;
 
   for (LIEF::ELF::Note& note : binary->notes()) {
-    if (note.name() == note_name) {
+    if (note.name() == resource.name) {
       existing_note = &note;
     }
   }
 
   if (existing_note) {
     if (!overwrite) {
-      object.set("result", emscripten::val(InjectResult::kAlreadyExists));
-      return object;
+      return InjectResult::kAlreadyExists;
     } else {
       binary->remove(*existing_note);
     }
   }
 
+  // LIEF lays the notes out itself, only 4-byte aligned
+  if (resource.alignment > 4) {
+    return InjectResult::kError;
+  }
+
   LIEF::ELF::Note note;
-  note.name(note_name);
-  note.description(vec_from_val(data));
+  note.name(resource.name);
+  note.description(note_content(resource));
   binary->add(note);
 
-  // Construct a new Uint8Array in JS
-  std::vector<uint8_t> output = binary->raw();
-  emscripten::val view{
-      emscripten::typed_memory_view(output.size(), output.data())};
-  auto output_data = emscripten::val::global("Uint8Array").new_(output.size());
-  output_data.call<void>("set", view);
+  return InjectResult::kSuccess;
+}
 
-  object.set("data", output_data);
-  object.set("result", emscripten::val(InjectResult::kSuccess));
+InjectResult add_elf_notes(LIEF::ELF::Binary* binary,
+                           const std::vector<Resource>& resources,
+                           bool overwrite) {
+  for (const Resource& resource : resources) {
+    InjectResult result = add_elf_note(binary, resource, overwrite);
+    if (result != InjectResult::kSuccess) {
+      return result;
+    }
+  }
 
-  return object;
+  return InjectResult::kSuccess;
 }
 
-emscripten::val inject_into_macho(const emscripten::val& executable,
-                                  const std::string& segment_name,
-                                  const std::string& section_name,
-                                  const emscripten::val& data,
-                                  bool overwrite = false) {
-  emscripten::val object = emscripten::val::object();
-  object.set("data", emscripten::val::undefined());
+InjectResult add_macho_section(LIEF::MachO::Binary* binary,
+                               const std::string& segment_name,
+                               const Resource& resource,
+                               bool overwrite) {
+  const std::string& section_name = resource.name;
+  LIEF::MachO::Section* existing_section =
+      binary->get_section(segment_name, section_name);
 
-  std::unique_ptr<LIEF::MachO::FatBinary> fat_binary =
-      LIEF::MachO::Parser::parse(vec_from_val(executable));
+  if (existing_section) {
+    if (!overwrite) {
+      return InjectResult::kAlreadyExists;
+    }
 
-  if (!fat_binary) {
-    object.set("result", emscripten::val(InjectResult::kError));
-    return object;
+    binary->remove_section(segment_name, section_name, true);
   }
 
-  // Inject into all Mach-O binaries if there's more than one in a fat binary
-  for (LIEF::MachO::Binary& binary : *fat_binary) {
-    LIEF::MachO::Section* existing_section =
-        binary.get_section(segment_name, section_name);
-
-    if (existing_section) {
-      if (!overwrite) {
-        object.set("result", emscripten::val(InjectResult::kAlreadyExists));
-        return object;
-      }
+  LIEF::MachO::SegmentCommand* segment = binary->get_segment(segment_name);
+  LIEF::MachO::Section section(section_name, resource_content(resource));
 
-      binary.remove_section(segment_name, section_name, true);
-    }
+  if (!segment) {
+    // Create the segment and mark it read-only
+    LIEF::MachO::SegmentCommand new_segment(segment_name);
+    new_segment.max_protection(
+        static_cast<uint32_t>(LIEF::MachO::VM_PROTECTIONS::VM_PROT_READ));
+    new_segment.init_protection(
+        static_cast<uint32_t>(LIEF::MachO::VM_PROTECTIONS::VM_PROT_READ));
+    new_segment.add_section(section);
+    binary->add(new_segment);
+  } else {
+    binary->add_section(*segment, section);
+  }
 
-    LIEF::MachO::SegmentCommand* segment = binary.get_segment(segment_name);
-    LIEF::MachO::Section section(section_name, vec_from_val(data));
+  return InjectResult::kSuccess;
+}
 
-    if (!segment) {
-      // Create the segment and mark it read-only
-      LIEF::MachO::SegmentCommand new_segment(segment_name);
-      new_segment.max_protection(
-          static_cast<uint32_t>(LIEF::MachO::VM_PROTECTIONS::VM_PROT_READ));
-      new_segment.init_protection(
-          static_cast<uint32_t>(LIEF::MachO::VM_PROTECTIONS::VM_PROT_READ));
-      new_segment.add_section(section);
-      binary.add(new_segment);
-    } else {
-      binary.add_section(*segment, section);
+InjectResult add_macho_sections(LIEF::MachO::FatBinary* fat_binary,
+                                const std::string& segment_name,
+                                const std::vector<Resource>& resources,
+                                bool overwrite) {
+  // Inject into all Mach-O binaries if there's more than one in a fat binary
+  for (LIEF::MachO::Binary& binary : *fat_binary) {
+    for (const Resource& resource : resources) {
+      InjectResult result =
+          add_macho_section(&binary, segment_name, resource, overwrite);
+      if (result != InjectResult::kSuccess) {
+        return result;
+      }
     }
 
     // It will need to be signed again anyway, so remove the signature
@@ -138,45 +494,96 @@ emscripten::val inject_into_macho(const emscripten::val& executable,
     }
   }
 
-  // Construct a new Uint8Array in JS
-  std::vector<uint8_t> output = fat_binary->raw();
-  emscripten::val view{
-      emscripten::typed_memory_view(output.size(), output.data())};
-  auto output_data = emscripten::val::global("Uint8Array").new_(output.size());
-  output_data.call<void>("set", view);
+  return InjectResult::kSuccess;
+}
+
+// Slices of fat binaries are aligned to 2^14 bytes, as LIEF does
+const uint32_t kFatAlignment = 14;
+const uint32_t kFatMagic = 0xcafebabe;
+
+// Builds every slice of the fat binary. The builds are independent, so each
+// slice gets its own thread when threads are available.
+bool build_macho_slices(LIEF::MachO::FatBinary* fat_binary,
+                        std::vector<std::vector<uint8_t>>* slices) {
+  const size_t count = fat_binary->size();
+  slices->assign(count, std::vector<uint8_t>());
+  std::unique_ptr<bool[]> built(new bool[count]());
 
-  object.set("data", output_data);
-  object.set("result", emscripten::val(InjectResult::kSuccess));
+  auto build_slice = [&](size_t i) {
+    built[i] = static_cast<bool>(
+        LIEF::MachO::Builder::write(*fat_binary->at(i), (*slices)[i]));
+  };
+
+#ifdef POSTJECT_HAS_THREADS
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; i++) {
+    threads.emplace_back(build_slice, i);
+  }
+  build_slice(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    build_slice(i);
+  }
+#endif
 
-  return object;
+  return std::all_of(built.get(), built.get() + count,
+                     [](bool ok) { return ok; });
 }
 
-emscripten::val inject_into_pe(const emscripten::val& executable,
-                               const std::string& resource_name,
-                               const emscripten::val& data,
-                               bool overwrite = false) {
-  emscripten::val object = emscripten::val::object();
-  object.set("data", emscripten::val::undefined());
+void append_uint32_be(std::vector<uint8_t>* output, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    output->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
 
-  std::unique_ptr<LIEF::PE::Binary> binary =
-      LIEF::PE::Parser::parse(vec_from_val(executable));
+// Lays out the slices after a fat header, returning the header and storing
+// the offset of each slice in `offsets`. A single slice is written as is,
+// without a fat header.
+bool build_fat_header(const LIEF::MachO::FatBinary& fat_binary,
+                      const std::vector<std::vector<uint8_t>>& slices,
+                      std::vector<uint8_t>* header,
+                      std::vector<uint64_t>* offsets) {
+  header->clear();
+  offsets->clear();
 
-  if (!binary) {
-    object.set("result", emscripten::val(InjectResult::kError));
-    return object;
+  if (slices.size() == 1) {
+    offsets->push_back(0);
+    return true;
   }
 
-  // TODO - lief.PE.ResourcesManager doesn't support RCDATA it seems, add
-  // support so this is simpler?
+  // fat_header is followed by a fat_arch entry for each slice, all big-endian
+  const uint64_t alignment = uint64_t{1} << kFatAlignment;
+  uint64_t offset = 8 + slices.size() * 20;
+  append_uint32_be(header, kFatMagic);
+  append_uint32_be(header, static_cast<uint32_t>(slices.size()));
 
-  if (!binary->has_resources()) {
-    // TODO - Handle this edge case by creating the resource tree
-    object.set("result", emscripten::val(InjectResult::kError));
-    return object;
+  for (size_t i = 0; i < slices.size(); i++) {
+    offset = (offset + alignment - 1) & ~(alignment - 1);
+    if (offset + slices[i].size() > std::numeric_limits<uint32_t>::max()) {
+      return false;
+    }
+
+    const LIEF::MachO::Header& slice_header = fat_binary.at(i)->header();
+    append_uint32_be(header, static_cast<uint32_t>(slice_header.cpu_type()));
+    append_uint32_be(header, slice_header.cpu_subtype());
+    append_uint32_be(header, static_cast<uint32_t>(offset));
+    append_uint32_be(header, static_cast<uint32_t>(slices[i].size()));
+    append_uint32_be(header, kFatAlignment);
+
+    offsets->push_back(offset);
+    offset += slices[i].size();
   }
 
-  LIEF::PE::ResourceNode* resources = binary->resources();
+  return true;
+}
 
+InjectResult add_pe_resource(LIEF::PE::ResourceNode* resources,
+                             const Resource& resource,
+                             bool overwrite) {
+  const std::string& resource_name = resource.name;
   LIEF::PE::ResourceNode* rcdata_node = nullptr;
   LIEF::PE::ResourceNode* id_node = nullptr;
 
@@ -199,7 +606,7 @@ emscripten::val inject_into_pe(const emscripten::val& executable,
   // Second level => ID (ResourceDirectory node)
   auto id_node_iter = std::find_if(
       std::begin(rcdata_node->childs()), std::end(rcdata_node->childs()),
-      [resource_name](const LIEF::PE::ResourceNode& node) {
+      [&resource_name](const LIEF::PE::ResourceNode& node) {
         return node.name() ==
                std::wstring_convert<std::codecvt_utf8_utf16<char16_t>,
                                     char16_t>{}
@@ -221,73 +628,1453 @@ emscripten::val inject_into_pe(const emscripten::val& executable,
   // Third level => Lang (ResourceData node)
   if (id_node->childs() != std::end(id_node->childs())) {
     if (!overwrite) {
-      object.set("result", emscripten::val(InjectResult::kAlreadyExists));
-      return object;
+      return InjectResult::kAlreadyExists;
     }
 
     id_node->delete_child(*id_node->childs());
   }
 
   LIEF::PE::ResourceData lang_node;
-  lang_node.content(vec_from_val(data));
+  lang_node.content(resource_content(resource));
   id_node->add_child(lang_node);
 
+  return InjectResult::kSuccess;
+}
+
+InjectResult add_pe_resources(LIEF::PE::Binary* binary,
+                              const std::vector<Resource>& resources,
+                              bool overwrite) {
+  // TODO - lief.PE.ResourcesManager doesn't support RCDATA it seems, add
+  // support so this is simpler?
+
+  if (!binary->has_resources()) {
+    // TODO - Handle this edge case by creating the resource tree
+    return InjectResult::kError;
+  }
+
+  for (const Resource& resource : resources) {
+    InjectResult result =
+        add_pe_resource(binary->resources(), resource, overwrite);
+    if (result != InjectResult::kSuccess) {
+      return result;
+    }
+  }
+
   binary->remove_section(".rsrc", true);
 
-  // Write out the binary, only modifying the resources
-  LIEF::PE::Builder builder(*binary);
-  builder.build_dos_stub(true);
-  builder.build_imports(false);
-  builder.build_overlay(false);
-  builder.build_relocations(false);
-  builder.build_resources(true);
-  builder.build_tls(false);
-  builder.build();
+  return InjectResult::kSuccess;
+}
+
+// Finds the header of a section in the section table of a built PE binary
+bool find_pe_section_header(const std::vector<uint8_t>& binary,
+                            const std::string& name,
+                            size_t* header_offset) {
+  const size_t kSectionNameSize = 8;
+  const size_t kSectionHeaderSize = 40;
+  const size_t kFileHeaderSize = 20;
+
+  auto read_u16 = [&binary](size_t offset) {
+    return static_cast<uint32_t>(binary[offset]) |
+           static_cast<uint32_t>(binary[offset + 1]) << 8;
+  };
+
+  if (binary.size() < 0x40 || name.size() > kSectionNameSize) {
+    return false;
+  }
+
+  const size_t pe_offset = read_u16(0x3c) | read_u16(0x3e) << 16;
+  if (pe_offset > binary.size() - 4 - kFileHeaderSize ||
+      std::memcmp(binary.data() + pe_offset, "PE\0\0", 4) != 0) {
+    return false;
+  }
+
+  const size_t file_header = pe_offset + 4;
+  const size_t number_of_sections = read_u16(file_header + 2);
+  const size_t section_table =
+      file_header + kFileHeaderSize + read_u16(file_header + 16);
+
+  std::string padded_name = name;
+  padded_name.resize(kSectionNameSize, '\0');
+
+  for (size_t i = 0; i < number_of_sections; i++) {
+    const size_t header = section_table + i * kSectionHeaderSize;
+    if (header + kSectionHeaderSize > binary.size()) {
+      return false;
+    }
+
+    if (std::memcmp(binary.data() + header, padded_name.data(),
+                    kSectionNameSize) == 0) {
+      *header_offset = header;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Section name field of the rebuilt resource section, NUL-padded to 8 bytes
+const uint8_t kPeResourceSectionName[8] = {'.', 'r', 's', 'r', 'c', 0, 0, 0};
+
+// Writes out the binary, only modifying the resources. On success
+// `rsrc_header` is the offset of the rebuilt resource section's header in the
+// build, which still has to be renamed to `kPeResourceSectionName`.
+bool build_pe_resources(LIEF::PE::Builder* builder, size_t* rsrc_header) {
+  builder->build_dos_stub(true);
+  builder->build_imports(false);
+  builder->build_overlay(false);
+  builder->build_relocations(false);
+  builder->build_resources(true);
+  builder->build_tls(false);
+  builder->build();
 
   // TODO - Why doesn't LIEF just replace the .rsrc section?
   //        Can we at least change build_resources to take a section name?
 
-  // Re-parse the output so the .l2 section is available
-  binary = LIEF::PE::Parser::parse(builder.get_build());
-
-  // Rename the rebuilt resource section
-  LIEF::PE::Section* section = binary->get_section(".l2");
-  section->name(".rsrc");
-
-  LIEF::PE::Builder builder2(*binary);
-  builder2.build_dos_stub(true);
-  builder2.build_imports(false);
-  builder2.build_overlay(false);
-  builder2.build_relocations(false);
-  builder2.build_resources(false);
-  builder2.build_tls(false);
-  builder2.build();
-
-  // Construct a new Uint8Array in JS
-  const std::vector<uint8_t>& output = builder2.get_build();
-  emscripten::val view{
-      emscripten::typed_memory_view(output.size(), output.data())};
-  auto output_data = emscripten::val::global("Uint8Array").new_(output.size());
-  output_data.call<void>("set", view);
-
-  object.set("data", output_data);
-  object.set("result", emscripten::val(InjectResult::kSuccess));
-
-  return object;
-}
-
-EMSCRIPTEN_BINDINGS(postject) {
-  emscripten::enum_<ExecutableFormat>("ExecutableFormat")
-      .value("kELF", ExecutableFormat::kELF)
-      .value("kMachO", ExecutableFormat::kMachO)
-      .value("kPE", ExecutableFormat::kPE)
-      .value("kUnknown", ExecutableFormat::kUnknown);
-  emscripten::enum_<InjectResult>("InjectResult")
-      .value("kAlreadyExists", InjectResult::kAlreadyExists)
-      .value("kError", InjectResult::kError)
-      .value("kSuccess", InjectResult::kSuccess);
-  emscripten::function("getExecutableFormat", &get_executable_format);
-  emscripten::function("injectIntoELF", &inject_into_elf);
-  emscripten::function("injectIntoMachO", &inject_into_macho);
-  emscripten::function("injectIntoPE", &inject_into_pe);
+  // The section is renamed directly in the output, rather than re-parsing
+  // and building the whole binary a second time just for that
+  return find_pe_section_header(builder->get_build(), ".l2", rsrc_header);
+}
+
+// Detached resources are stored after the end of the executable, at an offset
+// aligned to this so that they can be mapped on their own (64 KB being the
+// allocation granularity of Windows), and are followed by a copy of their
+// descriptor, which postject_map_resource() in postject-api.h checks.
+const uint64_t kDetachedAlignment = 64 * 1024;
+
+// "PJDT", the version, 3 reserved bytes, and then the offset and size of the
+// data, as little-endian 64-bit integers
+const size_t kDetachedDescriptorSize = 24;
+
+std::vector<uint8_t> encode_detached_descriptor(uint64_t offset,
+                                                uint64_t size) {
+  std::vector<uint8_t> descriptor = {'P', 'J', 'D', 'T', 1, 0, 0, 0};
+  for (uint64_t value : {offset, size}) {
+    for (int i = 0; i < 8; i++) {
+      descriptor.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+  return descriptor;
+}
+
+bool has_detached_resources(const std::vector<Resource>& resources) {
+  return std::any_of(
+      resources.begin(), resources.end(),
+      [](const Resource& resource) { return resource.detached; });
+}
+
+// The data of a detached resource, which is opened before anything is
+// injected, so that a resource file that can't be read fails the injection up
+// front rather than once the executable is written
+struct DetachedData {
+  // Null if the data is in memory
+  FilePtr file;
+  uint64_t size = 0;
+};
+
+// Opens the files the detached resources are streamed from, if they have one,
+// and gets the size of their data either way, in the order of the resources
+bool open_detached_data(const std::vector<Resource>& resources,
+                        std::vector<DetachedData>* data) {
+  for (const Resource& resource : resources) {
+    if (!resource.detached) {
+      continue;
+    }
+
+    DetachedData detached;
+    if (resource.file.empty()) {
+      if (resource.data == nullptr) {
+        return false;
+      }
+      detached.size = resource.data->size();
+    } else {
+      // The size of anything but a regular file, e.g. a directory, isn't
+      // that of its data
+      detached.file = open_file(resource.file, "rb");
+      if (!detached.file || !is_regular_file(detached.file.get()) ||
+          !get_file_size(detached.file.get(), &detached.size)) {
+        return false;
+      }
+    }
+    data->push_back(std::move(detached));
+  }
+  return true;
+}
+
+// Finds where the descriptor injected as the resource named `name` is, which
+// is a note on ELF and a resource on PE
+bool find_detached_descriptor(ExecutableFormat format,
+                              const ExecutableInput& executable,
+                              const std::string& name,
+                              uint64_t* offset) {
+  if (format == ExecutableFormat::kPE) {
+    ResourceSlot slot;
+    if (!find_pe_slot(executable, name, &slot) ||
+        slot.size != kDetachedDescriptorSize) {
+      return false;
+    }
+    *offset = slot.offset;
+    return true;
+  }
+
+  // The note header is the name size, the description size and the type,
+  // and the description follows the name padded to 4 bytes
+  ElfNoteSlot slot;
+  uint8_t header[12];
+  if (!find_elf_note_slot(executable, name, &slot) ||
+      !executable.read(slot.offset, sizeof(header), header)) {
+    return false;
+  }
+
+  uint64_t fields[2] = {};
+  for (int field = 0; field < 2; field++) {
+    for (int i = 0; i < 4; i++) {
+      const uint8_t byte = header[field * 4 + (slot.big_endian ? i : 3 - i)];
+      fields[field] = (fields[field] << 8) | byte;
+    }
+  }
+
+  if (fields[1] != kDetachedDescriptorSize) {
+    return false;
+  }
+  *offset = slot.offset + sizeof(header) + ((fields[0] + 3) & ~uint64_t{3});
+  return true;
+}
+
+// Points a listed resource at its data if it's the descriptor of a detached
+// resource, which is only trusted if the copy after the data matches it, the
+// same as postject_map_resource() does
+void resolve_detached_resource(const ExecutableInput& executable,
+                               ResourceInfo* resource) {
+  uint8_t descriptor[kDetachedDescriptorSize];
+  if (resource->size != kDetachedDescriptorSize ||
+      !executable.read(resource->offset, sizeof(descriptor), descriptor) ||
+      std::memcmp(descriptor, "PJDT\x01", 5) != 0) {
+    return;
+  }
+
+  uint64_t fields[2] = {};
+  for (int field = 0; field < 2; field++) {
+    for (int i = 7; i >= 0; i--) {
+      fields[field] = (fields[field] << 8) | descriptor[8 + field * 8 + i];
+    }
+  }
+
+  const uint64_t offset = fields[0];
+  const uint64_t size = fields[1];
+  uint8_t trailer[kDetachedDescriptorSize];
+  if (offset > executable.size() || size > executable.size() - offset ||
+      executable.size() - offset - size < sizeof(trailer) ||
+      !executable.read(offset + size, sizeof(trailer), trailer) ||
+      std::memcmp(trailer, descriptor, sizeof(trailer)) != 0) {
+    return;
+  }
+
+  resource->offset = offset;
+  resource->size = size;
+  resource->detached = true;
+}
+
+// Finds the detached resource named `name` in the executable, i.e. its
+// descriptor and where the descriptor points, if the copy after the data
+// matches it
+bool find_detached_resource(ExecutableFormat format,
+                            const ExecutableInput& executable,
+                            const std::string& name,
+                            uint64_t* descriptor_offset,
+                            ResourceInfo* resource) {
+  resource->size = kDetachedDescriptorSize;
+  if (!find_detached_descriptor(format, executable, name, descriptor_offset)) {
+    return false;
+  }
+
+  resource->offset = *descriptor_offset;
+  resolve_detached_resource(executable, resource);
+  return resource->detached;
+}
+
+// The resources to inject first, with a descriptor of the right size in place
+// of the data of detached ones, which is only filled in once the data is
+// appended and its offset known, see append_detached_resources(). It's zeroed,
+// unless the resource is detached in the executable already, whose descriptor
+// is kept so that its data can be reused. The placeholders are stored in
+// `placeholders`, which has to outlive the resources.
+std::vector<Resource> with_detached_placeholders(
+    ExecutableFormat format,
+    const ExecutableInput& executable,
+    const std::vector<Resource>& resources,
+    std::vector<std::vector<uint8_t>>* placeholders) {
+  // The resources point into it, so it must not reallocate
+  placeholders->reserve(resources.size());
+
+  std::vector<Resource> injected;
+  for (const Resource& resource : resources) {
+    if (!resource.detached) {
+      injected.push_back(resource);
+      continue;
+    }
+
+    std::vector<uint8_t> placeholder(kDetachedDescriptorSize, 0);
+    uint64_t descriptor_offset = 0;
+    ResourceInfo existing;
+    if (find_detached_resource(format, executable, resource.name,
+                               &descriptor_offset, &existing) &&
+        !executable.read(descriptor_offset, placeholder.size(),
+                         placeholder.data())) {
+      placeholder.assign(kDetachedDescriptorSize, 0);
+    }
+    placeholders->push_back(placeholder);
+
+    Resource descriptor;
+    descriptor.name = resource.name;
+    descriptor.data = &placeholders->back();
+    injected.push_back(descriptor);
+  }
+  return injected;
+}
+
+// Same as with_detached_placeholders(), reading the executable file
+bool with_detached_placeholders_in_file(
+    ExecutableFormat format,
+    const std::string& executable_path,
+    const std::vector<Resource>& resources,
+    std::vector<std::vector<uint8_t>>* placeholders,
+    std::vector<Resource>* injected) {
+  FilePtr executable = open_file(executable_path, "rb");
+  uint64_t size = 0;
+  if (!executable || !get_file_size(executable.get(), &size)) {
+    return false;
+  }
+
+  *injected = with_detached_placeholders(
+      format, FileInput(executable.get(), size), resources, placeholders);
+  return true;
+}
+
+// Where the output ends without the data of the detached resources that are
+// injected again, if it's at the end, so that it's replaced rather than left
+// behind. Their placeholders kept their descriptors for this.
+uint64_t find_reusable_detached_end(ExecutableFormat format,
+                                    const ExecutableInput& output,
+                                    const std::vector<Resource>& resources) {
+  uint64_t end = output.size();
+  for (bool dropped = true; dropped;) {
+    dropped = false;
+    for (const Resource& resource : resources) {
+      uint64_t descriptor_offset = 0;
+      ResourceInfo existing;
+      if (resource.detached &&
+          find_detached_resource(format, output, resource.name,
+                                 &descriptor_offset, &existing) &&
+          existing.offset + existing.size + kDetachedDescriptorSize == end) {
+        end = existing.offset;
+        dropped = true;
+      }
+    }
+  }
+  return end;
+}
+
+// Where a rebuild puts the detached data of the executable, which is after
+// its end, so LIEF either moves it with the rest of the overlay, as on ELF,
+// or drops it, as build_pe_resources() does. Everything from the first
+// detached data on is taken over from the executable, and left where it is if
+// the build still ends before it, or else moved to the next aligned offset,
+// in which case the descriptors and their copies after the data are patched.
+struct DetachedLayout {
+  // How much of the build is written, which is up to the data if it kept it
+  uint64_t build_size = 0;
+  // Where the data is in the executable, and where it goes in the output
+  uint64_t from = 0;
+  uint64_t to = 0;
+  uint64_t size = 0;
+  Patches patches;
+};
+
+bool plan_detached_layout(ExecutableFormat format,
+                          const ExecutableInput& executable,
+                          const std::vector<uint8_t>& build,
+                          DetachedLayout* layout) {
+  std::vector<ResourceInfo> resources;
+  if (!(format == ExecutableFormat::kPE
+            ? list_pe_resources(executable, &resources)
+            : list_elf_notes(executable, &resources))) {
+    return false;
+  }
+
+  std::vector<ResourceInfo> detached;
+  for (ResourceInfo& resource : resources) {
+    resolve_detached_resource(executable, &resource);
+    if (resource.detached) {
+      detached.push_back(resource);
+    }
+  }
+
+  layout->build_size = build.size();
+  layout->from = executable.size();
+  layout->to = build.size();
+  layout->size = 0;
+  if (detached.empty()) {
+    return true;
+  }
+
+  for (const ResourceInfo& resource : detached) {
+    layout->from = std::min(layout->from, resource.offset);
+  }
+  layout->size = executable.size() - layout->from;
+
+  // The build kept the data if the copies of the descriptors are still after
+  // it, at the end of the build
+  const uint64_t kept_from = layout->from + build.size() - executable.size();
+  const bool kept =
+      build.size() >= layout->size &&
+      std::all_of(detached.begin(), detached.end(),
+                  [&](const ResourceInfo& resource) {
+                    const std::vector<uint8_t> descriptor =
+                        encode_detached_descriptor(resource.offset,
+                                                   resource.size);
+                    const uint64_t trailer =
+                        resource.offset - layout->from + kept_from +
+                        resource.size;
+                    return std::equal(descriptor.begin(), descriptor.end(),
+                                      build.begin() + trailer);
+                  });
+  if (kept) {
+    layout->build_size = kept_from;
+  }
+
+  layout->to = layout->build_size <= layout->from
+                   ? layout->from
+                   : (layout->build_size + kDetachedAlignment - 1) &
+                         ~(kDetachedAlignment - 1);
+  if (layout->to == layout->from) {
+    return true;
+  }
+
+  // Descriptors that aren't in the build anymore, e.g. overwritten with a
+  // resource that isn't detached, are left pointing at the old offset
+  for (const ResourceInfo& resource : detached) {
+    const std::vector<uint8_t> descriptor =
+        encode_detached_descriptor(resource.offset, resource.size);
+    uint64_t descriptor_offset = 0;
+    if (!find_detached_descriptor(format, BufferInput(build), resource.name,
+                                  &descriptor_offset) ||
+        descriptor_offset + descriptor.size() > layout->build_size ||
+        !std::equal(descriptor.begin(), descriptor.end(),
+                    build.begin() + descriptor_offset)) {
+      continue;
+    }
+
+    const uint64_t offset = resource.offset - layout->from + layout->to;
+    const std::vector<uint8_t> moved =
+        encode_detached_descriptor(offset, resource.size);
+    layout->patches.emplace_back(descriptor_offset, moved);
+    layout->patches.emplace_back(offset + resource.size, moved);
+  }
+
+  return true;
+}
+
+// Lays the output, which holds the build, out as planned by
+// plan_detached_layout()
+void apply_detached_layout(const DetachedLayout& layout,
+                           const std::vector<uint8_t>& executable,
+                           std::vector<uint8_t>* output) {
+  output->resize(static_cast<size_t>(layout.build_size));
+  output->resize(static_cast<size_t>(layout.to), 0);
+  output->insert(output->end(), executable.begin() + layout.from,
+                 executable.begin() + layout.from + layout.size);
+  apply_patches(layout.patches, output);
+}
+
+// Same as plan_detached_layout(), reading the executable file
+bool plan_detached_layout_in_file(ExecutableFormat format,
+                                  const std::string& executable_path,
+                                  const std::vector<uint8_t>& build,
+                                  DetachedLayout* layout) {
+  FilePtr executable = open_file(executable_path, "rb");
+  uint64_t size = 0;
+  return executable && get_file_size(executable.get(), &size) &&
+         plan_detached_layout(format, FileInput(executable.get(), size), build,
+                              layout);
+}
+
+// Same as apply_detached_layout(), writing the output
+bool write_detached_layout(const DetachedLayout& layout,
+                           const std::vector<uint8_t>& build,
+                           DeltaWriter* output) {
+  if (!output->write(0, build.data(), layout.build_size) ||
+      !output->write_zeros(layout.build_size,
+                           layout.to - layout.build_size) ||
+      !output->copy(layout.to, layout.from, layout.size)) {
+    return false;
+  }
+
+  for (const auto& patch : layout.patches) {
+    if (!output->write(patch.first, patch.second.data(),
+                       patch.second.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Appends the data of the detached resources, from `data` as opened by
+// open_detached_data(), to the output, which has them injected with
+// placeholders, each followed by its descriptor, and writes the descriptors
+// over the placeholders
+InjectResult append_detached_resources(ExecutableFormat format,
+                                       const std::vector<Resource>& resources,
+                                       const std::vector<DetachedData>& data,
+                                       std::vector<uint8_t>* output,
+                                       InjectStats* stats) {
+  PhaseRecorder recorder(stats);
+  recorder.phase("detach");
+
+  output->resize(static_cast<size_t>(
+      find_reusable_detached_end(format, BufferInput(*output), resources)));
+
+  size_t next = 0;
+  for (const Resource& resource : resources) {
+    if (!resource.detached) {
+      continue;
+    }
+
+    const DetachedData& source = data[next++];
+    uint64_t descriptor_offset = 0;
+    if (!find_detached_descriptor(format, BufferInput(*output), resource.name,
+                                  &descriptor_offset)) {
+      return InjectResult::kError;
+    }
+
+    const uint64_t offset =
+        (output->size() + kDetachedAlignment - 1) & ~(kDetachedAlignment - 1);
+    const std::vector<uint8_t> descriptor =
+        encode_detached_descriptor(offset, source.size);
+    if (source.size > output->max_size() - offset - descriptor.size()) {
+      return InjectResult::kTooLarge;
+    }
+
+    recorder.written(offset - output->size() + source.size +
+                     descriptor.size() * 2);
+    output->resize(offset, 0);
+    if (source.file) {
+      output->resize(static_cast<size_t>(offset + source.size));
+      if (!read_at(source.file.get(), 0, static_cast<size_t>(source.size),
+                   output->data() + offset)) {
+        return InjectResult::kError;
+      }
+    } else {
+      output->insert(output->end(), resource.data->begin(),
+                     resource.data->end());
+    }
+    output->insert(output->end(), descriptor.begin(), descriptor.end());
+    std::copy(descriptor.begin(), descriptor.end(),
+              output->begin() + descriptor_offset);
+  }
+
+  return InjectResult::kSuccess;
+}
+
+// Same as append_detached_resources(), but appends to the output file
+InjectResult append_detached_resources_to_file(
+    ExecutableFormat format,
+    const std::vector<Resource>& resources,
+    const std::vector<DetachedData>& data,
+    const std::string& output_path,
+    InjectStats* stats) {
+  PhaseRecorder recorder(stats);
+  recorder.phase("detach");
+
+  FilePtr output = open_file(output_path, "r+b");
+  uint64_t output_size = 0;
+  if (!output || !get_file_size(output.get(), &output_size) ||
+      !resize_file(output.get(),
+                   find_reusable_detached_end(
+                       format, FileInput(output.get(), output_size),
+                       resources))) {
+    return InjectResult::kError;
+  }
+
+  size_t next = 0;
+  for (const Resource& resource : resources) {
+    if (!resource.detached) {
+      continue;
+    }
+
+    const DetachedData& source = data[next++];
+    uint64_t size = 0;
+    uint64_t descriptor_offset = 0;
+    if (!get_file_size(output.get(), &size) ||
+        !find_detached_descriptor(format, FileInput(output.get(), size),
+                                  resource.name, &descriptor_offset)) {
+      return InjectResult::kError;
+    }
+
+    const uint64_t offset =
+        (size + kDetachedAlignment - 1) & ~(kDetachedAlignment - 1);
+    const std::vector<uint8_t> descriptor =
+        encode_detached_descriptor(offset, source.size);
+
+    // Finding the descriptor moved the position, which get_file_size() moves
+    // back to the end, where the data goes. Data from a file is streamed in
+    // chunks, so it never has to fit in memory.
+    if (!get_file_size(output.get(), &size) ||
+        !write_zeros(output.get(), offset - size) ||
+        !(source.file ? append_file_contents(source.file.get(), output.get(),
+                                             source.size)
+                      : append(output.get(), resource.data->data(),
+                               resource.data->size())) ||
+        !append(output.get(), descriptor.data(), descriptor.size()) ||
+        !write_at(output.get(), descriptor_offset, descriptor.data(),
+                  descriptor.size())) {
+      return InjectResult::kError;
+    }
+
+    recorder.written(offset - size + source.size + descriptor.size() * 2);
+  }
+
+  if (std::fflush(output.get()) != 0) {
+    return InjectResult::kError;
+  }
+
+  return InjectResult::kSuccess;
+}
+
+// Injects the resources into the executable with `inject`, in place
+using FileInjector = std::function<InjectResult(const std::vector<Resource>&,
+                                                const std::string&)>;
+
+// Injects the resources with placeholders for the detached ones into a copy of
+// the executable next to the output, appends their data to it, and only then
+// replaces the output with it. A failure along the way, e.g. reading the data,
+// thus leaves the executable as it was, rather than with zeroed descriptors
+// and a flipped fuse. The copy is reflinked where the file system supports it,
+// as DeltaWriter's temporary files are.
+InjectResult inject_detached_into_file(ExecutableFormat format,
+                                       const std::string& executable_path,
+                                       const std::vector<Resource>& resources,
+                                       const std::string& output_path,
+                                       const FileInjector& inject,
+                                       InjectStats* stats) {
+  std::vector<DetachedData> data;
+  std::vector<std::vector<uint8_t>> placeholders;
+  std::vector<Resource> injected;
+  if (!open_detached_data(resources, &data) ||
+      !with_detached_placeholders_in_file(format, executable_path, resources,
+                                          &placeholders, &injected)) {
+    return InjectResult::kError;
+  }
+
+  const std::string staged_path = output_path + ".postject-tmp";
+  {
+    PhaseRecorder recorder(stats);
+    recorder.phase("write");
+
+    FilePtr executable = open_file(executable_path, "rb");
+    uint64_t size = 0;
+    if (!executable || !get_file_size(executable.get(), &size)) {
+      return InjectResult::kError;
+    }
+
+    FilePtr staged = open_file(staged_path, "w+b");
+    if (!staged) {
+      return InjectResult::kError;
+    }
+
+    const bool cloned = clone_file(executable.get(), staged.get());
+    const bool copied =
+        (cloned || copy_file_contents(executable.get(), staged.get(), size)) &&
+        copy_file_mode(executable.get(), staged.get()) &&
+        std::fclose(staged.release()) == 0;
+    if (!cloned) {
+      recorder.written(size);
+    }
+
+    if (!copied) {
+      staged.reset();
+      std::remove(staged_path.c_str());
+      return InjectResult::kError;
+    }
+  }
+
+  InjectResult result = inject(injected, staged_path);
+  if (result == InjectResult::kSuccess) {
+    result = append_detached_resources_to_file(format, resources, data,
+                                               staged_path, stats);
+  }
+  if (result == InjectResult::kSuccess &&
+      !replace_file(staged_path, output_path)) {
+    result = InjectResult::kError;
+  }
+
+  if (result != InjectResult::kSuccess) {
+    std::remove(staged_path.c_str());
+  }
+  return result;
+}
+
+// The formats describe resources with 32-bit fields: the `n_descsz` of ELF
+// notes (which is 32-bit in ELF64 as well), the `Size` of PE resource data
+// entries, and the `offset` of Mach-O sections, as well as the `size` of
+// 32-bit ones. Larger resources have to be detached, since descriptors hold
+// 64-bit offsets and sizes.
+InjectResult check_resource_sizes(const std::vector<Resource>& resources) {
+  for (const Resource& resource : resources) {
+    if (resource.detached) {
+      continue;
+    }
+
+    // Only detached resources can be streamed from a file
+    if (resource.data == nullptr) {
+      return InjectResult::kError;
+    }
+
+    if (std::max<uint64_t>(resource.data->size(), resource.reserve) >
+        std::numeric_limits<uint32_t>::max()) {
+      return InjectResult::kTooLarge;
+    }
+  }
+
+  return InjectResult::kSuccess;
+}
+
+bool list_resources(const std::string& filename,
+                    const ExecutableInput& executable,
+                    const std::string& segment_name,
+                    std::vector<ResourceInfo>* resources) {
+  switch (get_executable_format_of_file(filename)) {
+    case ExecutableFormat::kELF:
+      if (!list_elf_notes(executable, resources)) {
+        return false;
+      }
+      break;
+
+    case ExecutableFormat::kMachO:
+      return list_macho_resources(executable, segment_name, resources);
+
+    case ExecutableFormat::kPE:
+      if (!list_pe_resources(executable, resources)) {
+        return false;
+      }
+      break;
+
+    default:
+      return false;
+  }
+
+  // Only ELF and PE executables have detached resources
+  for (ResourceInfo& resource : *resources) {
+    resolve_detached_resource(executable, &resource);
+  }
+  return true;
+}
+
+}  // namespace
+
+InjectResult inject_into_elf(const std::vector<uint8_t>& executable,
+                             const std::string& note_name,
+                             const std::vector<uint8_t>& data,
+                             bool overwrite,
+                             std::vector<uint8_t>* output) {
+  Resource resource;
+  resource.name = note_name;
+  resource.data = &data;
+  return inject_many_into_elf(executable, {resource}, overwrite, output);
+}
+
+InjectResult inject_many_into_elf(const std::vector<uint8_t>& executable,
+                                  const std::vector<Resource>& resources,
+                                  bool overwrite,
+                                  std::vector<uint8_t>* output,
+                                  InjectStats* stats) {
+  if (has_detached_resources(resources)) {
+    std::vector<DetachedData> data;
+    if (!open_detached_data(resources, &data)) {
+      return InjectResult::kError;
+    }
+
+    std::vector<std::vector<uint8_t>> placeholders;
+    const InjectResult result = inject_many_into_elf(
+        executable,
+        with_detached_placeholders(ExecutableFormat::kELF,
+                                   BufferInput(executable), resources,
+                                   &placeholders),
+        overwrite, output, stats);
+    return result != InjectResult::kSuccess
+               ? result
+               : append_detached_resources(ExecutableFormat::kELF, resources,
+                                           data, output, stats);
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  PhaseRecorder recorder(stats);
+
+  // Try appending the notes directly first, it's much cheaper than having
+  // LIEF parse and rebuild the whole binary
+  ElfNotePlan plan;
+  recorder.phase("plan");
+  switch (plan_elf_notes(BufferInput(executable), resources, overwrite,
+                         &plan)) {
+    case ElfPlanResult::kSuccess:
+      recorder.phase("write");
+      apply_elf_note_plan(executable, plan, resources, output);
+      recorder.written(output->size());
+      return InjectResult::kSuccess;
+
+    case ElfPlanResult::kAlreadyExists:
+      return InjectResult::kAlreadyExists;
+
+    case ElfPlanResult::kTooLarge:
+      return InjectResult::kTooLarge;
+
+    case ElfPlanResult::kUnsupported:
+      break;
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::ELF::Binary> binary =
+      LIEF::ELF::Parser::parse(executable);
+
+  if (!binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_elf_notes(binary.get(), resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  *output = binary->raw();
+
+  Patches patches;
+  DetachedLayout layout;
+  if (!find_reserved_size_patches(ExecutableFormat::kELF, *output, "",
+                                  resources, &patches) ||
+      !plan_detached_layout(ExecutableFormat::kELF, BufferInput(executable),
+                            *output, &layout)) {
+    return InjectResult::kError;
+  }
+  apply_detached_layout(layout, executable, output);
+  apply_patches(patches, output);
+  recorder.written(output->size());
+
+  return InjectResult::kSuccess;
+}
+
+InjectResult inject_into_macho(const std::vector<uint8_t>& executable,
+                               const std::string& segment_name,
+                               const std::string& section_name,
+                               const std::vector<uint8_t>& data,
+                               bool overwrite,
+                               std::vector<uint8_t>* output) {
+  Resource resource;
+  resource.name = section_name;
+  resource.data = &data;
+  return inject_many_into_macho(executable, segment_name, {resource}, overwrite,
+                                output);
+}
+
+InjectResult inject_many_into_macho(const std::vector<uint8_t>& executable,
+                                    const std::string& segment_name,
+                                    const std::vector<Resource>& resources,
+                                    bool overwrite,
+                                    std::vector<uint8_t>* output,
+                                    InjectStats* stats) {
+  // Data after the end of a Mach-O binary isn't covered by its code
+  // signature, or part of a slice of a fat binary, so detached resources
+  // aren't supported
+  if (has_detached_resources(resources)) {
+    return InjectResult::kError;
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  PhaseRecorder recorder(stats);
+
+  // Sections that are only overwritten may fit where they are, which only
+  // touches their data and section headers
+  if (overwrite &&
+      overwrite_slots(
+          executable,
+          [&](const ExecutableInput& input, std::vector<SlotWrite>* writes) {
+            return plan_macho_overwrite(input, segment_name, resources,
+                                        writes);
+          },
+          &recorder, output)) {
+    return InjectResult::kSuccess;
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::MachO::FatBinary> fat_binary =
+      LIEF::MachO::Parser::parse(executable);
+
+  if (!fat_binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_macho_sections(fat_binary.get(), segment_name,
+                                           resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  std::vector<std::vector<uint8_t>> slices;
+  std::vector<uint64_t> offsets;
+  if (!build_macho_slices(fat_binary.get(), &slices) ||
+      !build_fat_header(*fat_binary, slices, output, &offsets)) {
+    return InjectResult::kError;
+  }
+
+  for (std::vector<uint8_t>& slice : slices) {
+    Patches patches;
+    if (!find_reserved_size_patches(ExecutableFormat::kMachO, slice,
+                                    segment_name, resources, &patches)) {
+      return InjectResult::kError;
+    }
+    apply_patches(patches, &slice);
+  }
+
+  recorder.phase("write");
+  for (size_t i = 0; i < slices.size(); i++) {
+    output->resize(offsets[i]);
+    output->insert(output->end(), slices[i].begin(), slices[i].end());
+    std::vector<uint8_t>().swap(slices[i]);
+  }
+  recorder.written(output->size());
+
+  return InjectResult::kSuccess;
+}
+
+InjectResult inject_into_pe(const std::vector<uint8_t>& executable,
+                            const std::string& resource_name,
+                            const std::vector<uint8_t>& data,
+                            bool overwrite,
+                            std::vector<uint8_t>* output) {
+  Resource resource;
+  resource.name = resource_name;
+  resource.data = &data;
+  return inject_many_into_pe(executable, {resource}, overwrite, output);
+}
+
+InjectResult inject_many_into_pe(const std::vector<uint8_t>& executable,
+                                 const std::vector<Resource>& resources,
+                                 bool overwrite,
+                                 std::vector<uint8_t>* output,
+                                 InjectStats* stats) {
+  if (has_detached_resources(resources)) {
+    std::vector<DetachedData> data;
+    if (!open_detached_data(resources, &data)) {
+      return InjectResult::kError;
+    }
+
+    std::vector<std::vector<uint8_t>> placeholders;
+    const InjectResult result = inject_many_into_pe(
+        executable,
+        with_detached_placeholders(ExecutableFormat::kPE,
+                                   BufferInput(executable), resources,
+                                   &placeholders),
+        overwrite, output, stats);
+    return result != InjectResult::kSuccess
+               ? result
+               : append_detached_resources(ExecutableFormat::kPE, resources,
+                                           data, output, stats);
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  PhaseRecorder recorder(stats);
+
+  // Resources that are only overwritten may fit where they are, which only
+  // touches their data and data entries
+  if (overwrite &&
+      overwrite_slots(
+          executable,
+          [&](const ExecutableInput& input, std::vector<SlotWrite>* writes) {
+            return plan_pe_overwrite(input, resources, writes);
+          },
+          &recorder, output)) {
+    return InjectResult::kSuccess;
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::PE::Binary> binary =
+      LIEF::PE::Parser::parse(executable);
+
+  if (!binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_pe_resources(binary.get(), resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  LIEF::PE::Builder builder(*binary);
+  size_t rsrc_header = 0;
+  if (!build_pe_resources(&builder, &rsrc_header)) {
+    return InjectResult::kError;
+  }
+
+  Patches patches;
+  DetachedLayout layout;
+  if (!find_reserved_size_patches(ExecutableFormat::kPE, builder.get_build(),
+                                  "", resources, &patches) ||
+      !plan_detached_layout(ExecutableFormat::kPE, BufferInput(executable),
+                            builder.get_build(), &layout)) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("write");
+  *output = builder.get_build();
+  std::copy(std::begin(kPeResourceSectionName),
+            std::end(kPeResourceSectionName), output->begin() + rsrc_header);
+  apply_detached_layout(layout, executable, output);
+  apply_patches(patches, output);
+  recorder.written(output->size());
+
+  return InjectResult::kSuccess;
+}
+
+ExecutableFormat get_executable_format_of_file(const std::string& filename) {
+  // These only read the headers, not the whole file
+  if (LIEF::ELF::is_elf(filename)) {
+    return ExecutableFormat::kELF;
+  } else if (LIEF::MachO::is_macho(filename)) {
+    return ExecutableFormat::kMachO;
+  } else if (LIEF::PE::is_pe(filename)) {
+    return ExecutableFormat::kPE;
+  }
+
+  return ExecutableFormat::kUnknown;
+}
+
+bool list_resources_in_file(const std::string& filename,
+                            const std::string& segment_name,
+                            std::vector<ResourceInfo>* resources) {
+  FilePtr file = open_file(filename, "rb");
+  uint64_t size = 0;
+  return file && get_file_size(file.get(), &size) &&
+         list_resources(filename, FileInput(file.get(), size), segment_name,
+                        resources);
+}
+
+ExtractResult extract_resource_from_file(const std::string& filename,
+                                         const std::string& segment_name,
+                                         const std::string& name,
+                                         const std::string& output_path) {
+  FilePtr file = open_file(filename, "rb");
+  uint64_t size = 0;
+  std::vector<ResourceInfo> resources;
+  if (!file || !get_file_size(file.get(), &size) ||
+      !list_resources(filename, FileInput(file.get(), size), segment_name,
+                      &resources)) {
+    return ExtractResult::kError;
+  }
+
+  // The first one is what lookups find, if there are several
+  const auto resource =
+      std::find_if(resources.begin(), resources.end(),
+                   [&](const ResourceInfo& info) { return info.name == name; });
+  if (resource == resources.end()) {
+    return ExtractResult::kNotFound;
+  }
+
+  // The data is copied in chunks, so it never has to fit in memory
+  FilePtr output = open_file(output_path, "wb");
+  if (!output ||
+      !copy_file_contents(file.get(), output.get(), resource->size,
+                          resource->offset) ||
+      std::fclose(output.release()) != 0) {
+    return ExtractResult::kError;
+  }
+
+  return ExtractResult::kSuccess;
+}
+
+InjectResult inject_many_into_elf_file(
+    const std::string& executable_path,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats) {
+  if (has_detached_resources(resources)) {
+    return inject_detached_into_file(
+        ExecutableFormat::kELF, executable_path, resources, output_path,
+        [&](const std::vector<Resource>& injected, const std::string& staged) {
+          return inject_many_into_elf_file(staged, injected, overwrite, staged,
+                                          sentinel_fuse, sentinel_fuse_result,
+                                          stats);
+        },
+        stats);
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  const bool in_place = executable_path == output_path;
+  PhaseRecorder recorder(stats);
+
+  {
+    FilePtr executable = open_file(executable_path, in_place ? "r+b" : "rb");
+    uint64_t size = 0;
+
+    if (!executable || !get_file_size(executable.get(), &size)) {
+      return InjectResult::kError;
+    }
+
+    // Only the headers and notes are read to plan the injection, then the
+    // notes are streamed to the output
+    ElfNotePlan plan;
+    recorder.phase("plan");
+    switch (plan_elf_notes(FileInput(executable.get(), size), resources,
+                           overwrite, &plan)) {
+      case ElfPlanResult::kSuccess: {
+        // The input is left as is up to where the notes are appended, except
+        // for the headers, so the fuse is where it is in the input
+        recorder.phase("fuse");
+        if (!add_sentinel_fuse_patch_in_file(executable.get(), size,
+                                             sentinel_fuse, &plan.patches,
+                                             sentinel_fuse_result)) {
+          return InjectResult::kError;
+        }
+
+        recorder.phase("write");
+        FilePtr output;
+        if (!in_place && !(output = open_file(output_path, "wb"))) {
+          return InjectResult::kError;
+        }
+
+        std::FILE* destination = in_place ? executable.get() : output.get();
+        if (!write_elf_note_plan(executable.get(), size, plan, resources,
+                                 destination)) {
+          return InjectResult::kError;
+        }
+
+        recorder.written(in_place
+                             ? elf_note_plan_write_size(plan, resources, size)
+                             : plan.size);
+        return InjectResult::kSuccess;
+      }
+
+      case ElfPlanResult::kAlreadyExists:
+        return InjectResult::kAlreadyExists;
+
+      case ElfPlanResult::kTooLarge:
+        return InjectResult::kTooLarge;
+
+      case ElfPlanResult::kUnsupported:
+        break;
+    }
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::ELF::Binary> binary =
+      LIEF::ELF::Parser::parse(executable_path);
+
+  if (!binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_elf_notes(binary.get(), resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  LIEF::ELF::Builder builder(*binary);
+  builder.build();
+
+  const std::vector<uint8_t>& build = builder.get_build();
+  Patches patches;
+  DetachedLayout layout;
+  if (!find_reserved_size_patches(ExecutableFormat::kELF, build, "", resources,
+                                  &patches) ||
+      !plan_detached_layout_in_file(ExecutableFormat::kELF, executable_path,
+                                    build, &layout)) {
+    return InjectResult::kError;
+  }
+
+  // The detached data is skipped, it could hold anything
+  recorder.phase("fuse");
+  if (!add_sentinel_fuse_patch(build.data(), layout.build_size, sentinel_fuse,
+                               &patches, sentinel_fuse_result)) {
+    return InjectResult::kError;
+  }
+
+  // Only what changed is written, see delta_writer.h
+  recorder.phase("write");
+  DeltaWriter output;
+  if (!output.open(executable_path, output_path) ||
+      !write_detached_layout(layout, build, &output)) {
+    return InjectResult::kError;
+  }
+
+  for (const auto& patch : patches) {
+    if (!output.write(patch.first, patch.second.data(), patch.second.size())) {
+      return InjectResult::kError;
+    }
+  }
+
+  if (!output.commit(layout.to + layout.size)) {
+    return InjectResult::kError;
+  }
+
+  recorder.written(output.written());
+  return InjectResult::kSuccess;
+}
+
+InjectResult inject_many_into_macho_file(
+    const std::string& executable_path,
+    const std::string& segment_name,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats) {
+  // See inject_many_into_macho()
+  if (has_detached_resources(resources)) {
+    return InjectResult::kError;
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  PhaseRecorder recorder(stats);
+  InjectResult overwrite_result = InjectResult::kError;
+
+  if (overwrite &&
+      overwrite_slots_in_file(
+          executable_path, output_path,
+          [&](const ExecutableInput& input, std::vector<SlotWrite>* writes) {
+            return plan_macho_overwrite(input, segment_name, resources,
+                                        writes);
+          },
+          sentinel_fuse, sentinel_fuse_result, &recorder, &overwrite_result)) {
+    return overwrite_result;
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::MachO::FatBinary> fat_binary =
+      LIEF::MachO::Parser::parse(executable_path);
+
+  if (!fat_binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_macho_sections(fat_binary.get(), segment_name,
+                                           resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  std::vector<std::vector<uint8_t>> slices;
+  std::vector<uint8_t> header;
+  std::vector<uint64_t> offsets;
+  if (!build_macho_slices(fat_binary.get(), &slices) ||
+      !build_fat_header(*fat_binary, slices, &header, &offsets)) {
+    return InjectResult::kError;
+  }
+
+  for (std::vector<uint8_t>& slice : slices) {
+    Patches patches;
+    if (!find_reserved_size_patches(ExecutableFormat::kMachO, slice,
+                                    segment_name, resources, &patches)) {
+      return InjectResult::kError;
+    }
+    apply_patches(patches, &slice);
+  }
+
+  // Every slice has a fuse of its own
+  recorder.phase("fuse");
+  for (std::vector<uint8_t>& slice : slices) {
+    Patches patches;
+    if (!add_sentinel_fuse_patch(slice.data(), slice.size(), sentinel_fuse,
+                                 &patches, sentinel_fuse_result)) {
+      return InjectResult::kError;
+    }
+    apply_patches(patches, &slice);
+  }
+
+  // The slices are written straight to their offsets, rather than being
+  // assembled into another copy of the whole fat binary first, and only what
+  // changed is written, see delta_writer.h
+  recorder.phase("write");
+  DeltaWriter output;
+  if (!output.open(executable_path, output_path) ||
+      !output.write(0, header.data(), header.size())) {
+    return InjectResult::kError;
+  }
+
+  uint64_t end = header.size();
+  for (size_t i = 0; i < slices.size(); i++) {
+    // The slices are aligned, with zeros in between
+    if (!output.write_zeros(end, offsets[i] - end) ||
+        !output.write(offsets[i], slices[i].data(), slices[i].size())) {
+      return InjectResult::kError;
+    }
+    end = offsets[i] + slices[i].size();
+  }
+
+  if (!output.commit(end)) {
+    return InjectResult::kError;
+  }
+
+  recorder.written(output.written());
+  return InjectResult::kSuccess;
+}
+
+InjectResult inject_many_into_pe_file(
+    const std::string& executable_path,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats) {
+  if (has_detached_resources(resources)) {
+    return inject_detached_into_file(
+        ExecutableFormat::kPE, executable_path, resources, output_path,
+        [&](const std::vector<Resource>& injected, const std::string& staged) {
+          return inject_many_into_pe_file(staged, injected, overwrite, staged,
+                                          sentinel_fuse, sentinel_fuse_result,
+                                          stats);
+        },
+        stats);
+  }
+
+  const InjectResult size_result = check_resource_sizes(resources);
+  if (size_result != InjectResult::kSuccess) {
+    return size_result;
+  }
+
+  PhaseRecorder recorder(stats);
+  InjectResult overwrite_result = InjectResult::kError;
+
+  if (overwrite &&
+      overwrite_slots_in_file(
+          executable_path, output_path,
+          [&](const ExecutableInput& input, std::vector<SlotWrite>* writes) {
+            return plan_pe_overwrite(input, resources, writes);
+          },
+          sentinel_fuse, sentinel_fuse_result, &recorder, &overwrite_result)) {
+    return overwrite_result;
+  }
+
+  recorder.phase("parse");
+  std::unique_ptr<LIEF::PE::Binary> binary =
+      LIEF::PE::Parser::parse(executable_path);
+
+  if (!binary) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("modify");
+  InjectResult result = add_pe_resources(binary.get(), resources, overwrite);
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  recorder.phase("build");
+  LIEF::PE::Builder builder(*binary);
+  size_t rsrc_header = 0;
+  if (!build_pe_resources(&builder, &rsrc_header)) {
+    return InjectResult::kError;
+  }
+
+  const std::vector<uint8_t>& build = builder.get_build();
+  Patches patches;
+  DetachedLayout layout;
+  if (!find_reserved_size_patches(ExecutableFormat::kPE, build, "", resources,
+                                  &patches) ||
+      !plan_detached_layout_in_file(ExecutableFormat::kPE, executable_path,
+                                    build, &layout)) {
+    return InjectResult::kError;
+  }
+
+  recorder.phase("fuse");
+  if (!add_sentinel_fuse_patch(build.data(), layout.build_size, sentinel_fuse,
+                               &patches, sentinel_fuse_result)) {
+    return InjectResult::kError;
+  }
+
+  // Write the build as is and only patch the section name, sizes and fuse in
+  // the file. Only what changed is written, see delta_writer.h.
+  recorder.phase("write");
+  DeltaWriter output;
+
+  if (!output.open(executable_path, output_path) ||
+      !write_detached_layout(layout, build, &output) ||
+      !output.write(rsrc_header, kPeResourceSectionName,
+                    sizeof(kPeResourceSectionName))) {
+    return InjectResult::kError;
+  }
+
+  for (const auto& patch : patches) {
+    if (!output.write(patch.first, patch.second.data(), patch.second.size())) {
+      return InjectResult::kError;
+    }
+  }
+
+  if (!output.commit(layout.to + layout.size)) {
+    return InjectResult::kError;
+  }
+
+  recorder.written(output.written());
+  return InjectResult::kSuccess;
+}
+
+SentinelFuseResult patch_sentinel_fuse(std::vector<uint8_t>* executable,
+                                       const std::string& sentinel_fuse) {
+  if (sentinel_fuse.empty()) {
+    return SentinelFuseResult::kNotFound;
+  }
+
+  // Every slice of a fat binary has a fuse of its own, the same as when
+  // injecting into files, see add_sentinel_fuse_patch_in_file()
+  std::vector<MachOSlice> slices;
+  if (!read_macho_slices(BufferInput(*executable), &slices)) {
+    return SentinelFuseResult::kError;
+  }
+
+  Patches patches;
+  for (const MachOSlice& slice : slices) {
+    uint64_t value_offset = 0;
+    const SentinelFuseResult result = find_sentinel_fuse_value(
+        executable->data() + slice.offset, static_cast<size_t>(slice.size),
+        sentinel_fuse, &value_offset);
+    if (result != SentinelFuseResult::kSuccess) {
+      return result;
+    }
+    patches.emplace_back(slice.offset + value_offset,
+                         std::vector<uint8_t>{'1'});
+  }
+
+  apply_patches(patches, executable);
+  return SentinelFuseResult::kSuccess;
 }
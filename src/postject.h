@@ -0,0 +1,201 @@
+#ifndef POSTJECT_H_
+#define POSTJECT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The injection logic shared by the WASM build (src/wasm.cpp), the native CLI
+// (src/main.cpp) and the native Node.js addon (src/addon.cpp). On success the
+// injected executable is stored in `output`.
+
+enum class ExecutableFormat { kELF, kMachO, kPE, kUnknown };
+
+enum class InjectResult {
+  kAlreadyExists,
+  kError,
+  kSuccess,
+  // A resource or the output is larger than the format's 32-bit size and
+  // offset fields can describe, which only detached resources aren't bound by
+  kTooLarge
+};
+
+enum class SentinelFuseResult {
+  kSuccess,
+  kNotFound,
+  kMultipleFound,
+  // The sentinel isn't followed by ':' and then '0' or '1'
+  kInvalidValue,
+  kError
+};
+
+// A resource to inject. The data isn't copied, it has to outlive the call.
+struct Resource {
+  std::string name;
+  // Null if the data is streamed from `file`
+  const std::vector<uint8_t>* data = nullptr;
+  // If not 0, a power of two the data should be aligned to, both in the file
+  // and in memory, e.g. the page size so that the data can be mapped or
+  // madvise()d directly. Only ELF executables support this for now, and the
+  // injection fails if it can't be honored, e.g. when LIEF has to rebuild the
+  // executable, which doesn't keep it.
+  uint64_t alignment = 0;
+  // If larger than the data, the room to leave for the resource, so that it
+  // can later be overwritten in place with up to this many bytes instead of
+  // relaying out the executable
+  uint64_t reserve = 0;
+  // Whether to store the data after the end of the executable, outside of
+  // anything the loader maps, and only inject a descriptor of where it is as
+  // the resource, see postject_map_resource() in postject-api.h. Only ELF and
+  // PE executables support this, and `alignment` and `reserve` don't apply.
+  bool detached = false;
+  // For detached resources, a file to stream the data from instead of `data`,
+  // so that resources of many GB don't have to be held in memory. It's opened
+  // before anything is written, and the injection fails with `kError` if it
+  // isn't a regular file that can be read.
+  std::string file;
+};
+
+// Where the time of an injection went, filled in by the functions below that
+// take a `stats` argument, unless it's null. The phases are "plan" (reading the
+// headers and notes for the ELF fast path), "parse", "modify", "build" (the
+// LIEF steps), "fuse" (finding the sentinel fuse), "write" and "detach"
+// (appending detached resources), in the order they ran.
+struct InjectStats {
+  struct Phase {
+    std::string name;
+    double milliseconds;
+  };
+
+  std::vector<Phase> phases;
+  // Bytes written to the output, i.e. only the appended notes when the ELF
+  // fast path injects in place
+  uint64_t bytes_written = 0;
+};
+
+ExecutableFormat get_executable_format(const std::vector<uint8_t>& executable);
+
+InjectResult inject_into_elf(const std::vector<uint8_t>& executable,
+                             const std::string& note_name,
+                             const std::vector<uint8_t>& data,
+                             bool overwrite,
+                             std::vector<uint8_t>* output);
+
+InjectResult inject_into_macho(const std::vector<uint8_t>& executable,
+                               const std::string& segment_name,
+                               const std::string& section_name,
+                               const std::vector<uint8_t>& data,
+                               bool overwrite,
+                               std::vector<uint8_t>* output);
+
+InjectResult inject_into_pe(const std::vector<uint8_t>& executable,
+                            const std::string& resource_name,
+                            const std::vector<uint8_t>& data,
+                            bool overwrite,
+                            std::vector<uint8_t>* output);
+
+// Batch variants, which inject several resources in a single parse and build
+// pass. Nothing is written to `output` unless every resource was injected.
+
+InjectResult inject_many_into_elf(const std::vector<uint8_t>& executable,
+                                  const std::vector<Resource>& resources,
+                                  bool overwrite,
+                                  std::vector<uint8_t>* output,
+                                  InjectStats* stats = nullptr);
+
+InjectResult inject_many_into_macho(const std::vector<uint8_t>& executable,
+                                    const std::string& segment_name,
+                                    const std::vector<Resource>& resources,
+                                    bool overwrite,
+                                    std::vector<uint8_t>* output,
+                                    InjectStats* stats = nullptr);
+
+InjectResult inject_many_into_pe(const std::vector<uint8_t>& executable,
+                                 const std::vector<Resource>& resources,
+                                 bool overwrite,
+                                 std::vector<uint8_t>* output,
+                                 InjectStats* stats = nullptr);
+
+// File-based variants, which read the executable from `executable_path` and
+// write the injected executable to `output_path`, which can be the same file.
+// Instead of holding several copies of the executable in memory, ELF notes are
+// streamed to disk (and appended in place when the paths are the same), and
+// LIEF reads the file directly and writes its build straight to disk.
+//
+// Unless `sentinel_fuse` is empty, the fuse is also flipped from `:0` to `:1`
+// by the same writes as the resources, see `patch_sentinel_fuse()`. It's found
+// before anything is written, and if it can't be flipped, `kError` is returned,
+// `sentinel_fuse_result` says why and the output is left untouched. With
+// detached resources, everything is written to a temporary file next to the
+// output first, which only replaces the output once their data is appended.
+
+ExecutableFormat get_executable_format_of_file(const std::string& filename);
+
+InjectResult inject_many_into_elf_file(
+    const std::string& executable_path,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats = nullptr);
+
+InjectResult inject_many_into_macho_file(
+    const std::string& executable_path,
+    const std::string& segment_name,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats = nullptr);
+
+InjectResult inject_many_into_pe_file(
+    const std::string& executable_path,
+    const std::vector<Resource>& resources,
+    bool overwrite,
+    const std::string& output_path,
+    const std::string& sentinel_fuse,
+    SentinelFuseResult* sentinel_fuse_result,
+    InjectStats* stats = nullptr);
+
+// Read-only inspection of an executable file, which only reads the headers and
+// the notes, load commands or resource directory describing the resources,
+// rather than parsing the whole executable with LIEF
+
+// A resource found by `list_resources_in_file()`
+struct ResourceInfo {
+  std::string name;
+  // File offset and size of the data as injected, e.g. still compressed
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  // Whether the resource is the descriptor of detached data, in which case
+  // `offset` and `size` are those of the data rather than of the descriptor
+  bool detached = false;
+};
+
+// Lists the resources of the executable: the notes lookups consider on ELF,
+// the sections of `segment_name` on Mach-O (in the first slice of fat
+// binaries) and the named RCDATA resources on PE. Returns false if the file
+// can't be read or isn't an executable.
+bool list_resources_in_file(const std::string& filename,
+                            const std::string& segment_name,
+                            std::vector<ResourceInfo>* resources);
+
+enum class ExtractResult { kSuccess, kNotFound, kError };
+
+// Streams the data of the resource named `name` to `output_path`, as it's
+// stored in the executable
+ExtractResult extract_resource_from_file(const std::string& filename,
+                                         const std::string& segment_name,
+                                         const std::string& name,
+                                         const std::string& output_path);
+
+// Flips the sentinel fuse from `:0` to `:1` in the executable, e.g. the output
+// of the `inject_*` functions before it's handed over to the caller. Each slice
+// of a fat Mach-O binary has a fuse of its own, which are all flipped.
+SentinelFuseResult patch_sentinel_fuse(std::vector<uint8_t>* executable,
+                                       const std::string& sentinel_fuse);
+
+
+#endif  // POSTJECT_H_
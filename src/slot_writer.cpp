@@ -0,0 +1,796 @@
+#include "slot_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const uint32_t kMachMagic = 0xfeedface;
+const uint32_t kMachMagic64 = 0xfeedfacf;
+const uint32_t kMachCigam = 0xcefaedfe;
+const uint32_t kMachCigam64 = 0xcffaedfe;
+const uint32_t kFatMagic = 0xcafebabe;
+const uint32_t kFatMagic64 = 0xcafebabf;
+const uint32_t kLcSegment = 0x1;
+const uint32_t kLcSegment64 = 0x19;
+const uint32_t kLcCodeSignature = 0x1d;
+const size_t kMachONameSize = 16;
+
+// Fat binaries don't have anywhere near this many slices, it only guards
+// against garbage
+const uint32_t kMaxFatSlices = 64;
+
+const uint16_t kPeOptionalMagic = 0x10b;
+const uint16_t kPeOptionalMagic64 = 0x20b;
+const uint32_t kPeResourceDirectory = 2;
+const uint32_t kRtRcdata = 10;
+const size_t kPeSectionHeaderSize = 40;
+const size_t kPeResourceDirectorySize = 16;
+const size_t kPeResourceEntrySize = 8;
+const size_t kPeResourceDataEntrySize = 16;
+const uint32_t kPeResourceHighBit = 0x80000000;
+
+// Resource trees are type, name and language directories
+const int kPeResourceTreeDepth = 3;
+
+// Nothing legitimate comes close, it only guards against cycles and garbage
+const size_t kMaxPeResourceNodes = 64 * 1024;
+
+uint64_t read_uint(const uint8_t* p, size_t size, bool big_endian) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= static_cast<uint64_t>(p[big_endian ? size - 1 - i : i]) << (8 * i);
+  }
+  return value;
+}
+
+bool read_uint_at(const ExecutableInput& executable,
+                  uint64_t offset,
+                  size_t size,
+                  bool big_endian,
+                  uint64_t* value) {
+  uint8_t bytes[8];
+  if (!executable.read(offset, size, bytes)) {
+    return false;
+  }
+  *value = read_uint(bytes, size, big_endian);
+  return true;
+}
+
+std::string read_name(const uint8_t* p, size_t size) {
+  const char* chars = reinterpret_cast<const char*>(p);
+  return std::string(chars, strnlen(chars, size));
+}
+
+// The load commands of a slice, which are only a few KB
+struct MachOCommands {
+  bool is_64;
+  bool big_endian;
+  uint64_t header_size;
+  uint64_t ncmds;
+  std::vector<uint8_t> data;
+};
+
+bool read_macho_commands(const ExecutableInput& executable,
+                         const MachOSlice& slice,
+                         MachOCommands* commands) {
+  uint8_t header[32];
+  if (slice.size < sizeof(header) ||
+      !executable.read(slice.offset, sizeof(header), header)) {
+    return false;
+  }
+
+  const uint64_t magic = read_uint(header, 4, false);
+  if (magic != kMachMagic && magic != kMachMagic64 && magic != kMachCigam &&
+      magic != kMachCigam64) {
+    return false;
+  }
+
+  commands->is_64 = magic == kMachMagic64 || magic == kMachCigam64;
+  commands->big_endian = magic == kMachCigam || magic == kMachCigam64;
+  commands->header_size = commands->is_64 ? 32 : 28;
+  commands->ncmds = read_uint(header + 16, 4, commands->big_endian);
+  const uint64_t sizeofcmds = read_uint(header + 20, 4, commands->big_endian);
+  if (sizeofcmds > slice.size - commands->header_size) {
+    return false;
+  }
+
+  commands->data.resize(static_cast<size_t>(sizeofcmds));
+  return executable.read(slice.offset + commands->header_size,
+                         commands->data.size(), commands->data.data());
+}
+
+bool find_macho_slot_in_slice(const ExecutableInput& executable,
+                              const MachOSlice& slice,
+                              const std::string& segment_name,
+                              const std::string& section_name,
+                              ResourceSlot* slot,
+                              bool* code_signed) {
+  MachOCommands load_commands;
+  if (!read_macho_commands(executable, slice, &load_commands)) {
+    return false;
+  }
+
+  const bool is_64 = load_commands.is_64;
+  const bool be = load_commands.big_endian;
+  const uint64_t header_size = load_commands.header_size;
+  const uint64_t ncmds = load_commands.ncmds;
+  const uint64_t sizeofcmds = load_commands.data.size();
+  const std::vector<uint8_t>& commands = load_commands.data;
+
+  const size_t section_size = is_64 ? 80 : 68;
+  const size_t sections_start = is_64 ? 72 : 56;
+  bool found = false;
+  uint64_t position = 0;
+
+  for (uint64_t i = 0; i < ncmds; i++) {
+    if (sizeofcmds - position < 8) {
+      return false;
+    }
+
+    const uint8_t* command = commands.data() + position;
+    const uint64_t cmd = read_uint(command, 4, be);
+    const uint64_t cmdsize = read_uint(command + 4, 4, be);
+    if (cmdsize < 8 || cmdsize > sizeofcmds - position) {
+      return false;
+    }
+
+    if (cmd == kLcCodeSignature) {
+      *code_signed = true;
+    }
+
+    if (cmd == (is_64 ? kLcSegment64 : kLcSegment) &&
+        cmdsize >= sections_start &&
+        read_name(command + 8, kMachONameSize) == segment_name) {
+      const uint64_t fileoff = read_uint(command + (is_64 ? 40 : 32),
+                                         is_64 ? 8 : 4, be);
+      const uint64_t filesize = read_uint(command + (is_64 ? 48 : 36),
+                                          is_64 ? 8 : 4, be);
+      const uint64_t nsects = read_uint(command + (is_64 ? 64 : 48), 4, be);
+      if (nsects > (cmdsize - sections_start) / section_size ||
+          fileoff > slice.size || filesize > slice.size - fileoff) {
+        return false;
+      }
+
+      // Sections are laid out within their segment, so a section's slot ends
+      // at the next section or at the end of the segment
+      std::vector<uint64_t> offsets;
+      size_t target = nsects;
+      for (size_t j = 0; j < nsects; j++) {
+        const uint8_t* section = command + sections_start + j * section_size;
+        offsets.push_back(read_uint(section + (is_64 ? 48 : 40), 4, be));
+        if (read_name(section, kMachONameSize) == section_name) {
+          target = j;
+          slot->size = read_uint(section + (is_64 ? 40 : 36), is_64 ? 8 : 4,
+                                 be);
+          slot->size_field = slice.offset + header_size + position +
+                             sections_start + j * section_size +
+                             (is_64 ? 40 : 36);
+        }
+      }
+
+      if (target == nsects) {
+        return false;
+      }
+
+      const uint64_t start = offsets[target];
+      uint64_t end = fileoff + filesize;
+      for (uint64_t offset : offsets) {
+        if (offset > start && offset < end) {
+          end = offset;
+        }
+      }
+
+      if (start < fileoff || start > end || slot->size > end - start) {
+        return false;
+      }
+
+      slot->offset = slice.offset + start;
+      slot->capacity = end - start;
+      slot->size_field_width = is_64 ? 8 : 4;
+      slot->big_endian = be;
+      found = true;
+    }
+
+    position += cmdsize;
+  }
+
+  return found;
+}
+
+// The names of the sections of the segment named `segment_name`, if the slice
+// has one
+bool read_macho_section_names(const ExecutableInput& executable,
+                              const MachOSlice& slice,
+                              const std::string& segment_name,
+                              std::vector<std::string>* names) {
+  MachOCommands commands;
+  if (!read_macho_commands(executable, slice, &commands)) {
+    return false;
+  }
+
+  const bool is_64 = commands.is_64;
+  const bool be = commands.big_endian;
+  const size_t section_size = is_64 ? 80 : 68;
+  const size_t sections_start = is_64 ? 72 : 56;
+  uint64_t position = 0;
+
+  for (uint64_t i = 0; i < commands.ncmds; i++) {
+    if (commands.data.size() - position < 8) {
+      return false;
+    }
+
+    const uint8_t* command = commands.data.data() + position;
+    const uint64_t cmd = read_uint(command, 4, be);
+    const uint64_t cmdsize = read_uint(command + 4, 4, be);
+    if (cmdsize < 8 || cmdsize > commands.data.size() - position) {
+      return false;
+    }
+
+    if (cmd == (is_64 ? kLcSegment64 : kLcSegment) &&
+        cmdsize >= sections_start &&
+        read_name(command + 8, kMachONameSize) == segment_name) {
+      const uint64_t nsects = read_uint(command + (is_64 ? 64 : 48), 4, be);
+      if (nsects > (cmdsize - sections_start) / section_size) {
+        return false;
+      }
+
+      for (uint64_t j = 0; j < nsects; j++) {
+        names->push_back(read_name(
+            command + sections_start + j * section_size, kMachONameSize));
+      }
+    }
+
+    position += cmdsize;
+  }
+
+  return true;
+}
+
+struct PeSection {
+  uint64_t virtual_address;
+  uint64_t virtual_size;
+  uint64_t raw_size;
+  uint64_t raw_offset;
+};
+
+// The file-backed part of the section that holds `rva`, if any
+const PeSection* find_pe_section(const std::vector<PeSection>& sections,
+                                 uint64_t rva) {
+  for (const PeSection& section : sections) {
+    const uint64_t mapped_size =
+        section.virtual_size != 0
+            ? std::min(section.virtual_size, section.raw_size)
+            : section.raw_size;
+    if (rva >= section.virtual_address &&
+        rva - section.virtual_address < mapped_size) {
+      return &section;
+    }
+  }
+  return nullptr;
+}
+
+// Walks the resource tree, collecting where every structure and every
+// resource's data starts, and finding the data entry of RCDATA/`name`
+class PeResourceWalker {
+ public:
+  PeResourceWalker(const ExecutableInput& executable,
+                   const std::vector<PeSection>& sections,
+                   uint64_t tree_rva,
+                   const std::u16string& name)
+      : executable_(executable),
+        sections_(sections),
+        tree_rva_(tree_rva),
+        name_(name) {}
+
+  bool walk() { return walk_directory(0, 0, false); }
+
+  // RVAs where structures or data start
+  const std::vector<uint64_t>& starts() const { return starts_; }
+
+  // Offset of the data entry in the tree, or 0 if the resource wasn't found,
+  // since the root directory is always at 0
+  uint64_t data_entry() const { return data_entry_; }
+
+  // The names of all the RCDATA resources, in the order of the tree
+  const std::vector<std::u16string>& rcdata_names() const {
+    return rcdata_names_;
+  }
+
+  bool read_tree(uint64_t offset, size_t size, uint8_t* output) const {
+    const PeSection* section = find_pe_section(sections_, tree_rva_ + offset);
+    return section != nullptr &&
+           executable_.read(section->raw_offset + tree_rva_ + offset -
+                                section->virtual_address,
+                            size, output);
+  }
+
+ private:
+  bool walk_directory(uint64_t offset, int depth, bool on_path) {
+    uint8_t directory[kPeResourceDirectorySize];
+    if (depth >= kPeResourceTreeDepth || ++nodes_ > kMaxPeResourceNodes ||
+        !read_tree(offset, sizeof(directory), directory)) {
+      return false;
+    }
+    starts_.push_back(tree_rva_ + offset);
+
+    const uint64_t count = read_uint(directory + 12, 2, false) +
+                           read_uint(directory + 14, 2, false);
+    for (uint64_t i = 0; i < count; i++) {
+      uint8_t entry[kPeResourceEntrySize];
+      if (!read_tree(offset + sizeof(directory) + i * kPeResourceEntrySize,
+                     sizeof(entry), entry)) {
+        return false;
+      }
+
+      const uint64_t id = read_uint(entry, 4, false);
+      const uint64_t child = read_uint(entry + 4, 4, false);
+      bool child_on_path = false;
+
+      if (id & kPeResourceHighBit) {
+        std::u16string entry_name;
+        if (!read_string(id & ~kPeResourceHighBit, &entry_name)) {
+          return false;
+        }
+        child_on_path = on_path && depth == 1 && entry_name == name_;
+        if (on_path && depth == 1) {
+          rcdata_names_.push_back(entry_name);
+        }
+      } else {
+        child_on_path = depth == 0 && id == kRtRcdata;
+      }
+
+      // The first language of the resource is the one that's used
+      child_on_path = child_on_path || (on_path && depth == 2 && i == 0);
+
+      const bool ok =
+          child & kPeResourceHighBit
+              ? walk_directory(child & ~kPeResourceHighBit, depth + 1,
+                               child_on_path)
+              : walk_data_entry(child, child_on_path && depth == 2);
+      if (!ok) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool read_string(uint64_t offset, std::u16string* string) {
+    uint8_t length[2];
+    if (!read_tree(offset, sizeof(length), length)) {
+      return false;
+    }
+    starts_.push_back(tree_rva_ + offset);
+
+    std::vector<uint8_t> chars(read_uint(length, 2, false) * 2);
+    if (!read_tree(offset + sizeof(length), chars.size(), chars.data())) {
+      return false;
+    }
+
+    for (size_t i = 0; i < chars.size(); i += 2) {
+      string->push_back(static_cast<char16_t>(read_uint(&chars[i], 2, false)));
+    }
+    return true;
+  }
+
+  bool walk_data_entry(uint64_t offset, bool is_target) {
+    uint8_t entry[kPeResourceDataEntrySize];
+    if (++nodes_ > kMaxPeResourceNodes ||
+        !read_tree(offset, sizeof(entry), entry)) {
+      return false;
+    }
+    starts_.push_back(tree_rva_ + offset);
+    starts_.push_back(read_uint(entry, 4, false));
+
+    if (is_target) {
+      data_entry_ = offset;
+    }
+    return true;
+  }
+
+  const ExecutableInput& executable_;
+  const std::vector<PeSection>& sections_;
+  const uint64_t tree_rva_;
+  const std::u16string name_;
+  std::vector<uint64_t> starts_;
+  std::vector<std::u16string> rcdata_names_;
+  uint64_t data_entry_ = 0;
+  size_t nodes_ = 0;
+};
+
+bool read_pe_sections(const ExecutableInput& executable,
+                      uint64_t* tree_rva,
+                      std::vector<PeSection>* sections) {
+  uint8_t dos_header[0x40];
+  if (!executable.read(0, sizeof(dos_header), dos_header) ||
+      dos_header[0] != 'M' || dos_header[1] != 'Z') {
+    return false;
+  }
+
+  // PE signature followed by the file header
+  const uint64_t pe_offset = read_uint(dos_header + 0x3c, 4, false);
+  uint8_t file_header[24];
+  if (!executable.read(pe_offset, sizeof(file_header), file_header) ||
+      std::memcmp(file_header, "PE\0\0", 4) != 0) {
+    return false;
+  }
+
+  const uint64_t section_count = read_uint(file_header + 6, 2, false);
+  const uint64_t optional_size = read_uint(file_header + 20, 2, false);
+  const uint64_t optional_offset = pe_offset + sizeof(file_header);
+  std::vector<uint8_t> optional(static_cast<size_t>(optional_size));
+  if (optional.size() < 2 ||
+      !executable.read(optional_offset, optional.size(), optional.data())) {
+    return false;
+  }
+
+  const uint64_t magic = read_uint(optional.data(), 2, false);
+  if (magic != kPeOptionalMagic && magic != kPeOptionalMagic64) {
+    return false;
+  }
+
+  const size_t directory_count_offset = magic == kPeOptionalMagic64 ? 108 : 92;
+  const size_t resource_directory_offset =
+      directory_count_offset + 4 + kPeResourceDirectory * 8;
+  if (optional.size() < resource_directory_offset + 8 ||
+      read_uint(&optional[directory_count_offset], 4, false) <=
+          kPeResourceDirectory) {
+    return false;
+  }
+
+  // 0 if the binary has no resources
+  *tree_rva = read_uint(&optional[resource_directory_offset], 4, false);
+
+  for (uint64_t i = 0; i < section_count; i++) {
+    uint8_t header[kPeSectionHeaderSize];
+    if (!executable.read(optional_offset + optional_size +
+                             i * kPeSectionHeaderSize,
+                         sizeof(header), header)) {
+      return false;
+    }
+
+    PeSection section;
+    section.virtual_size = read_uint(header + 8, 4, false);
+    section.virtual_address = read_uint(header + 12, 4, false);
+    section.raw_size = read_uint(header + 16, 4, false);
+    section.raw_offset = read_uint(header + 20, 4, false);
+    if (section.raw_offset > executable.size() ||
+        section.raw_size > executable.size() - section.raw_offset) {
+      return false;
+    }
+    sections->push_back(section);
+  }
+
+  return true;
+}
+
+bool has_duplicate_names(const std::vector<Resource>& resources) {
+  for (size_t i = 0; i < resources.size(); i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (resources[i].name == resources[j].name) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// The slot has to fit the data and the room reserved after it
+bool fits(const ResourceSlot& slot, const Resource& resource) {
+  return std::max<uint64_t>(resource.data->size(), resource.reserve) <=
+         slot.capacity;
+}
+
+}  // namespace
+
+bool read_macho_slices(const ExecutableInput& executable,
+                       std::vector<MachOSlice>* slices) {
+  uint64_t magic = 0;
+  if (executable.size() >= 4 &&
+      !read_uint_at(executable, 0, 4, true, &magic)) {
+    return false;
+  }
+
+  if (magic != kFatMagic && magic != kFatMagic64) {
+    slices->push_back(MachOSlice{0, executable.size()});
+    return true;
+  }
+
+  // fat_header is followed by a fat_arch or fat_arch_64 entry for each slice,
+  // all big-endian
+  const bool is_64 = magic == kFatMagic64;
+  const size_t entry_size = is_64 ? 32 : 20;
+  uint64_t count = 0;
+  if (!read_uint_at(executable, 4, 4, true, &count) || count == 0 ||
+      count > kMaxFatSlices) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < count; i++) {
+    uint8_t entry[32];
+    if (!executable.read(8 + i * entry_size, entry_size, entry)) {
+      return false;
+    }
+
+    MachOSlice slice;
+    slice.offset = read_uint(entry + 8, is_64 ? 8 : 4, true);
+    slice.size = read_uint(entry + (is_64 ? 16 : 12), is_64 ? 8 : 4, true);
+    if (slice.offset > executable.size() ||
+        slice.size > executable.size() - slice.offset) {
+      return false;
+    }
+    slices->push_back(slice);
+  }
+
+  return true;
+}
+
+bool find_macho_slots(const ExecutableInput& executable,
+                      const std::string& segment_name,
+                      const std::string& section_name,
+                      std::vector<ResourceSlot>* slots,
+                      bool* code_signed) {
+  std::vector<MachOSlice> slices;
+  bool signed_slice = false;
+  if (!read_macho_slices(executable, &slices)) {
+    return false;
+  }
+
+  slots->clear();
+  for (const MachOSlice& slice : slices) {
+    ResourceSlot slot;
+    if (!find_macho_slot_in_slice(executable, slice, segment_name,
+                                  section_name, &slot, &signed_slice)) {
+      return false;
+    }
+    slots->push_back(slot);
+  }
+
+  if (code_signed != nullptr) {
+    *code_signed = signed_slice;
+  }
+  return true;
+}
+
+bool find_pe_slot(const ExecutableInput& executable,
+                  const std::string& resource_name,
+                  ResourceSlot* slot) {
+  uint64_t tree_rva = 0;
+  std::vector<PeSection> sections;
+  if (!read_pe_sections(executable, &tree_rva, &sections) || tree_rva == 0) {
+    return false;
+  }
+
+  // Names are stored as UTF-16, and postject only uses ASCII ones
+  std::u16string name;
+  for (char c : resource_name) {
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      return false;
+    }
+    name.push_back(static_cast<char16_t>(c));
+  }
+
+  PeResourceWalker walker(executable, sections, tree_rva, name);
+  uint8_t entry[kPeResourceDataEntrySize];
+  if (!walker.walk() || walker.data_entry() == 0 ||
+      !walker.read_tree(walker.data_entry(), sizeof(entry), entry)) {
+    return false;
+  }
+
+  const uint64_t data_rva = read_uint(entry, 4, false);
+  const PeSection* data_section = find_pe_section(sections, data_rva);
+  const PeSection* entry_section =
+      find_pe_section(sections, tree_rva + walker.data_entry());
+  if (data_section == nullptr || entry_section == nullptr) {
+    return false;
+  }
+
+  // The slot ends wherever the next structure or resource starts, or at the
+  // end of the file-backed part of the section
+  uint64_t end = data_section->virtual_address +
+                 (data_section->virtual_size != 0
+                      ? std::min(data_section->virtual_size,
+                                 data_section->raw_size)
+                      : data_section->raw_size);
+  for (uint64_t start : walker.starts()) {
+    if (start > data_rva && start < end) {
+      end = start;
+    }
+  }
+
+  slot->offset =
+      data_section->raw_offset + data_rva - data_section->virtual_address;
+  slot->size = read_uint(entry + 4, 4, false);
+  slot->capacity = end - data_rva;
+  slot->size_field = entry_section->raw_offset + tree_rva +
+                     walker.data_entry() + 4 - entry_section->virtual_address;
+  slot->size_field_width = 4;
+  slot->big_endian = false;
+  return slot->size <= slot->capacity;
+}
+
+bool list_macho_resources(const ExecutableInput& executable,
+                          const std::string& segment_name,
+                          std::vector<ResourceInfo>* resources) {
+  std::vector<MachOSlice> slices;
+  std::vector<std::string> names;
+  if (!read_macho_slices(executable, &slices) ||
+      !read_macho_section_names(executable, slices[0], segment_name, &names)) {
+    return false;
+  }
+
+  resources->clear();
+  for (const std::string& name : names) {
+    ResourceSlot slot;
+    bool code_signed = false;
+    if (!find_macho_slot_in_slice(executable, slices[0], segment_name, name,
+                                  &slot, &code_signed)) {
+      return false;
+    }
+
+    ResourceInfo info;
+    info.name = name;
+    info.offset = slot.offset;
+    info.size = slot.size;
+    resources->push_back(info);
+  }
+
+  return true;
+}
+
+bool list_pe_resources(const ExecutableInput& executable,
+                       std::vector<ResourceInfo>* resources) {
+  uint64_t tree_rva = 0;
+  std::vector<PeSection> sections;
+  if (!read_pe_sections(executable, &tree_rva, &sections)) {
+    return false;
+  }
+
+  resources->clear();
+  if (tree_rva == 0) {
+    return true;
+  }
+
+  PeResourceWalker walker(executable, sections, tree_rva, std::u16string());
+  if (!walker.walk()) {
+    return false;
+  }
+
+  for (const std::u16string& wide_name : walker.rcdata_names()) {
+    // Resources with names postject can't have, or without data of their
+    // own, aren't listed
+    std::string name;
+    for (char16_t c : wide_name) {
+      name.push_back(c < 0x80 ? static_cast<char>(c) : '\0');
+    }
+
+    ResourceSlot slot;
+    if (name.find('\0') != std::string::npos ||
+        !find_pe_slot(executable, name, &slot)) {
+      continue;
+    }
+
+    ResourceInfo info;
+    info.name = name;
+    info.offset = slot.offset;
+    info.size = slot.size;
+    resources->push_back(info);
+  }
+
+  return true;
+}
+
+bool plan_macho_overwrite(const ExecutableInput& executable,
+                          const std::string& segment_name,
+                          const std::vector<Resource>& resources,
+                          std::vector<SlotWrite>* writes) {
+  if (has_duplicate_names(resources)) {
+    return false;
+  }
+
+  writes->clear();
+  for (const Resource& resource : resources) {
+    std::vector<ResourceSlot> slots;
+    bool code_signed = false;
+    if (!find_macho_slots(executable, segment_name, resource.name, &slots,
+                          &code_signed) ||
+        code_signed) {
+      return false;
+    }
+
+    for (const ResourceSlot& slot : slots) {
+      if (!fits(slot, resource) ||
+          resource.data->size() > std::numeric_limits<uint32_t>::max()) {
+        return false;
+      }
+      writes->push_back(SlotWrite{slot, resource.data});
+    }
+  }
+
+  return true;
+}
+
+bool plan_pe_overwrite(const ExecutableInput& executable,
+                       const std::vector<Resource>& resources,
+                       std::vector<SlotWrite>* writes) {
+  if (has_duplicate_names(resources)) {
+    return false;
+  }
+
+  writes->clear();
+  for (const Resource& resource : resources) {
+    ResourceSlot slot;
+    if (!find_pe_slot(executable, resource.name, &slot) ||
+        !fits(slot, resource) ||
+        resource.data->size() > std::numeric_limits<uint32_t>::max()) {
+      return false;
+    }
+    writes->push_back(SlotWrite{slot, resource.data});
+  }
+
+  return true;
+}
+
+std::vector<uint8_t> encode_slot_size(const ResourceSlot& slot,
+                                      uint64_t size) {
+  std::vector<uint8_t> bytes(slot.size_field_width);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[slot.big_endian ? bytes.size() - 1 - i : i] =
+        static_cast<uint8_t>(size >> (8 * i));
+  }
+  return bytes;
+}
+
+void apply_slot_writes(const std::vector<uint8_t>& executable,
+                       const std::vector<SlotWrite>& writes,
+                       std::vector<uint8_t>* output) {
+  *output = executable;
+
+  for (const SlotWrite& write : writes) {
+    const std::vector<uint8_t>& data = *write.data;
+    const std::vector<uint8_t> size = encode_slot_size(write.slot, data.size());
+    auto position = std::copy(data.begin(), data.end(),
+                              output->begin() + write.slot.offset);
+    // Don't leave any of the old data behind
+    if (write.slot.size > data.size()) {
+      std::fill_n(position, write.slot.size - data.size(), 0);
+    }
+    std::copy(size.begin(), size.end(),
+              output->begin() + write.slot.size_field);
+  }
+}
+
+bool write_slot_writes(std::FILE* executable,
+                       uint64_t executable_size,
+                       const std::vector<SlotWrite>& writes,
+                       std::FILE* output) {
+  if (output != executable &&
+      !copy_file_contents(executable, output, executable_size)) {
+    return false;
+  }
+
+  for (const SlotWrite& write : writes) {
+    const std::vector<uint8_t>& data = *write.data;
+    const std::vector<uint8_t> size = encode_slot_size(write.slot, data.size());
+    if (!write_at(output, write.slot.offset, data.data(), data.size()) ||
+        !write_zeros(output, write.slot.size > data.size()
+                                 ? write.slot.size - data.size()
+                                 : 0) ||
+        !write_at(output, write.slot.size_field, size.data(), size.size())) {
+      return false;
+    }
+  }
+
+  return std::fflush(output) == 0;
+}
+
+uint64_t slot_writes_size(const std::vector<SlotWrite>& writes) {
+  uint64_t size = 0;
+  for (const SlotWrite& write : writes) {
+    size += std::max<uint64_t>(write.data->size(), write.slot.size) +
+            write.slot.size_field_width;
+  }
+  return size;
+}
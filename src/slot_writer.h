@@ -0,0 +1,107 @@
+#ifndef POSTJECT_SLOT_WRITER_H_
+#define POSTJECT_SLOT_WRITER_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "file_io.h"
+#include "postject.h"
+
+// Direct Mach-O and PE writer used as the fast path of overwriting resources.
+// Instead of having LIEF remove the old section or resource and rebuild the
+// whole binary, it only reads the headers needed to find the old data, and if
+// the new data fits in its slot, writes the data and the new size over the
+// old ones. The slot is the room up to whatever follows the data in the file,
+// e.g. the room left with `Resource::reserve`, which LIEF lays out by
+// injecting zero-padded data whose size is then set with `encode_slot_size()`.
+
+// Where a resource's data is in the executable
+struct ResourceSlot {
+  // File offset and size of the data
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  // Bytes available at `offset` before whatever follows the data
+  uint64_t capacity = 0;
+  // File offset of the header field holding the size, and its width
+  uint64_t size_field = 0;
+  size_t size_field_width = 0;
+  bool big_endian = false;
+};
+
+// Where a slice of a fat binary is
+struct MachOSlice {
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Finds the slices of a fat binary, or the whole file as the only slice of
+// anything else. Returns false if the fat header can't be read.
+bool read_macho_slices(const ExecutableInput& executable,
+                       std::vector<MachOSlice>* slices);
+
+// New data to write over a slot
+struct SlotWrite {
+  ResourceSlot slot;
+  const std::vector<uint8_t>* data;
+};
+
+// Finds the section in every slice of a Mach-O or fat binary. Returns false
+// if the binary can't be read or a slice doesn't have the section. If
+// `code_signed` isn't null, it's set when any of the slices is code signed.
+bool find_macho_slots(const ExecutableInput& executable,
+                      const std::string& segment_name,
+                      const std::string& section_name,
+                      std::vector<ResourceSlot>* slots,
+                      bool* code_signed = nullptr);
+
+// Finds the RCDATA resource named `resource_name` in a PE binary
+bool find_pe_slot(const ExecutableInput& executable,
+                  const std::string& resource_name,
+                  ResourceSlot* slot);
+
+// List the resources with the offsets and sizes of their data: the sections of
+// the segment on Mach-O, in the first slice of fat binaries, and the named
+// RCDATA resources on PE. Return false if the binary can't be read.
+
+bool list_macho_resources(const ExecutableInput& executable,
+                          const std::string& segment_name,
+                          std::vector<ResourceInfo>* resources);
+
+bool list_pe_resources(const ExecutableInput& executable,
+                       std::vector<ResourceInfo>* resources);
+
+// Plan writing every resource over its existing slots. They return false,
+// leaving the injection to LIEF, unless each resource already exists and fits
+// in its slots along with the room it reserves. Code signed Mach-O binaries
+// are left to LIEF as well, which removes the signature.
+
+bool plan_macho_overwrite(const ExecutableInput& executable,
+                          const std::string& segment_name,
+                          const std::vector<Resource>& resources,
+                          std::vector<SlotWrite>* writes);
+
+bool plan_pe_overwrite(const ExecutableInput& executable,
+                       const std::vector<Resource>& resources,
+                       std::vector<SlotWrite>* writes);
+
+// The new value of the size field of the slot
+std::vector<uint8_t> encode_slot_size(const ResourceSlot& slot, uint64_t size);
+
+void apply_slot_writes(const std::vector<uint8_t>& executable,
+                       const std::vector<SlotWrite>& writes,
+                       std::vector<uint8_t>* output);
+
+// Streams the planned output to `output`. If it's the same file as
+// `executable`, only the slots and their size fields are written.
+bool write_slot_writes(std::FILE* executable,
+                       uint64_t executable_size,
+                       const std::vector<SlotWrite>& writes,
+                       std::FILE* output);
+
+// The number of bytes `write_slot_writes()` writes when the output is the
+// executable itself
+uint64_t slot_writes_size(const std::vector<SlotWrite>& writes);
+
+#endif  // POSTJECT_SLOT_WRITER_H_
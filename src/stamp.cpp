@@ -0,0 +1,403 @@
+#include "stamp.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "file_io.h"
+
+namespace {
+
+// "PJTMPL" followed by a NUL byte and the version of the layout below
+const uint8_t kTemplateMagic[8] = {'P', 'J', 'T', 'M', 'P', 'L', 0, 1};
+
+// Bounds for reading templates, well above what postject itself writes
+const uint64_t kMaxTemplateResources = 4096;
+const uint64_t kMaxTemplateNameSize = 4096;
+const uint64_t kMaxTemplateSlots = 64;
+
+// Size of an ELF note header, which is what the room after aligned data has
+// to hold at least, since the data can't move to absorb the rest
+const uint64_t kElfNoteHeaderSize = 12;
+
+// Templates are written little-endian, whatever the executable's byte order
+
+void put_uint(std::vector<uint8_t>* bytes, size_t size, uint64_t value) {
+  for (size_t i = 0; i < size; i++) {
+    bytes->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void put_slot(std::vector<uint8_t>* bytes, const ResourceSlot& slot) {
+  put_uint(bytes, 8, slot.offset);
+  put_uint(bytes, 8, slot.capacity);
+  put_uint(bytes, 8, slot.size_field);
+  put_uint(bytes, 1, slot.size_field_width);
+  put_uint(bytes, 1, slot.big_endian ? 1 : 0);
+}
+
+class TemplateReader {
+ public:
+  TemplateReader(const ExecutableInput& input, uint64_t position)
+      : input_(input), position_(position) {}
+
+  uint64_t position() const { return position_; }
+
+  bool read_uint(size_t size, uint64_t* value) {
+    uint8_t bytes[8];
+    if (!input_.read(position_, size, bytes)) {
+      return false;
+    }
+    position_ += size;
+
+    *value = 0;
+    for (size_t i = 0; i < size; i++) {
+      *value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return true;
+  }
+
+  bool read_string(std::string* value) {
+    uint64_t size = 0;
+    if (!read_uint(4, &size) || size > kMaxTemplateNameSize) {
+      return false;
+    }
+
+    value->resize(static_cast<size_t>(size));
+    if (!input_.read(position_, value->size(),
+                     reinterpret_cast<uint8_t*>(&(*value)[0]))) {
+      return false;
+    }
+    position_ += size;
+    return true;
+  }
+
+  bool read_slot(ResourceSlot* slot) {
+    uint64_t width = 0;
+    uint64_t big_endian = 0;
+    if (!read_uint(8, &slot->offset) || !read_uint(8, &slot->capacity) ||
+        !read_uint(8, &slot->size_field) || !read_uint(1, &width) ||
+        !read_uint(1, &big_endian) || (width != 4 && width != 8)) {
+      return false;
+    }
+    slot->size_field_width = static_cast<size_t>(width);
+    slot->big_endian = big_endian != 0;
+    return true;
+  }
+
+ private:
+  const ExecutableInput& input_;
+  uint64_t position_;
+};
+
+bool within(uint64_t offset, uint64_t size, uint64_t executable_size) {
+  return offset <= executable_size && size <= executable_size - offset;
+}
+
+// Reads everything but the executable, which starts at `executable_offset`
+bool read_template_header(const ExecutableInput& input,
+                          InjectionTemplate* tmpl,
+                          uint64_t* executable_offset) {
+  uint8_t magic[sizeof(kTemplateMagic)];
+  if (!input.read(0, sizeof(magic), magic) ||
+      !std::equal(magic, magic + sizeof(magic), kTemplateMagic)) {
+    return false;
+  }
+
+  TemplateReader reader(input, sizeof(magic));
+  uint64_t format = 0;
+  uint64_t count = 0;
+  if (!reader.read_uint(4, &format) || !reader.read_uint(4, &count) ||
+      count > kMaxTemplateResources ||
+      format > static_cast<uint64_t>(ExecutableFormat::kPE)) {
+    return false;
+  }
+  tmpl->format = static_cast<ExecutableFormat>(format);
+
+  for (uint64_t i = 0; i < count; i++) {
+    TemplateResource resource;
+    uint64_t big_endian = 0;
+    uint64_t slot_count = 0;
+    if (!reader.read_string(&resource.name) ||
+        !reader.read_uint(8, &resource.alignment) ||
+        !reader.read_uint(8, &resource.note.offset) ||
+        !reader.read_uint(8, &resource.note.size) ||
+        !reader.read_uint(1, &big_endian) ||
+        !reader.read_uint(4, &slot_count) || slot_count > kMaxTemplateSlots) {
+      return false;
+    }
+    resource.note.big_endian = big_endian != 0;
+
+    resource.slots.resize(static_cast<size_t>(slot_count));
+    for (ResourceSlot& slot : resource.slots) {
+      if (!reader.read_slot(&slot)) {
+        return false;
+      }
+    }
+    tmpl->resources.push_back(std::move(resource));
+  }
+
+  // Nothing may be written outside of the executable
+  *executable_offset = reader.position();
+  const uint64_t executable_size = input.size() - *executable_offset;
+  for (const TemplateResource& resource : tmpl->resources) {
+    if (!within(resource.note.offset, resource.note.size, executable_size)) {
+      return false;
+    }
+    for (const ResourceSlot& slot : resource.slots) {
+      if (!within(slot.offset, slot.capacity, executable_size) ||
+          !within(slot.size_field, slot.size_field_width, executable_size)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool read_whole_file(const std::string& filename,
+                     std::vector<uint8_t>* contents) {
+  FilePtr file = open_file(filename, "rb");
+  uint64_t size = 0;
+  if (!file || !get_file_size(file.get(), &size) ||
+      size > std::numeric_limits<size_t>::max()) {
+    return false;
+  }
+
+  contents->resize(static_cast<size_t>(size));
+  return read_at(file.get(), 0, contents->size(), contents->data());
+}
+
+// Finds the room of `resource` in the executable of the template
+bool find_template_resource(const InjectionTemplate& tmpl,
+                            const std::string& segment_name,
+                            const Resource& resource,
+                            TemplateResource* entry) {
+  BufferInput executable(tmpl.executable);
+  entry->name = resource.name;
+  entry->alignment = resource.alignment;
+
+  switch (tmpl.format) {
+    case ExecutableFormat::kELF: {
+      // Only the fast path leaves room, LIEF doesn't
+      ElfNoteLayout layout;
+      return find_elf_note_slot(executable, resource.name, &entry->note) &&
+             layout_note_in_slot(entry->note, resource, &layout);
+    }
+
+    case ExecutableFormat::kMachO:
+      if (!find_macho_slots(executable, segment_name, resource.name,
+                            &entry->slots)) {
+        return false;
+      }
+      break;
+
+    case ExecutableFormat::kPE:
+      entry->slots.resize(1);
+      if (!find_pe_slot(executable, resource.name, &entry->slots[0])) {
+        return false;
+      }
+      break;
+
+    case ExecutableFormat::kUnknown:
+      return false;
+  }
+
+  return std::all_of(entry->slots.begin(), entry->slots.end(),
+                     [&](const ResourceSlot& slot) {
+                       return slot.capacity >= resource.reserve;
+                     });
+}
+
+}  // namespace
+
+InjectResult create_injection_template(const std::string& executable_path,
+                                       const std::string& segment_name,
+                                       const std::vector<Resource>& resources,
+                                       InjectionTemplate* tmpl) {
+  std::vector<uint8_t> executable;
+  if (!read_whole_file(executable_path, &executable)) {
+    return InjectResult::kError;
+  }
+
+  *tmpl = InjectionTemplate();
+  tmpl->format = get_executable_format(executable);
+
+  const std::vector<uint8_t> empty;
+  std::vector<Resource> placeholders;
+  for (const Resource& resource : resources) {
+    Resource placeholder = resource;
+    placeholder.data = &empty;
+    if (tmpl->format == ExecutableFormat::kELF && resource.alignment > 4) {
+      placeholder.reserve += kElfNoteHeaderSize;
+    }
+    placeholders.push_back(placeholder);
+  }
+
+  InjectResult result = InjectResult::kError;
+  switch (tmpl->format) {
+    case ExecutableFormat::kELF:
+      result = inject_many_into_elf(executable, placeholders, false,
+                                    &tmpl->executable);
+      break;
+
+    case ExecutableFormat::kMachO:
+      result = inject_many_into_macho(executable, segment_name, placeholders,
+                                      false, &tmpl->executable);
+      break;
+
+    case ExecutableFormat::kPE:
+      result = inject_many_into_pe(executable, placeholders, false,
+                                   &tmpl->executable);
+      break;
+
+    case ExecutableFormat::kUnknown:
+      break;
+  }
+
+  if (result != InjectResult::kSuccess) {
+    return result;
+  }
+
+  tmpl->resources.resize(placeholders.size());
+  for (size_t i = 0; i < placeholders.size(); i++) {
+    if (!find_template_resource(*tmpl, segment_name, placeholders[i],
+                                &tmpl->resources[i])) {
+      return InjectResult::kError;
+    }
+  }
+
+  return InjectResult::kSuccess;
+}
+
+bool write_injection_template(const InjectionTemplate& tmpl,
+                              const std::string& template_path) {
+  std::vector<uint8_t> header(std::begin(kTemplateMagic),
+                              std::end(kTemplateMagic));
+  put_uint(&header, 4, static_cast<uint64_t>(tmpl.format));
+  put_uint(&header, 4, tmpl.resources.size());
+
+  for (const TemplateResource& resource : tmpl.resources) {
+    put_uint(&header, 4, resource.name.size());
+    header.insert(header.end(), resource.name.begin(), resource.name.end());
+    put_uint(&header, 8, resource.alignment);
+    put_uint(&header, 8, resource.note.offset);
+    put_uint(&header, 8, resource.note.size);
+    put_uint(&header, 1, resource.note.big_endian ? 1 : 0);
+    put_uint(&header, 4, resource.slots.size());
+    for (const ResourceSlot& slot : resource.slots) {
+      put_slot(&header, slot);
+    }
+  }
+
+  FilePtr file = open_file(template_path, "wb");
+  return file && write_at(file.get(), 0, header.data(), header.size()) &&
+         append(file.get(), tmpl.executable.data(), tmpl.executable.size()) &&
+         std::fflush(file.get()) == 0;
+}
+
+ExecutableFormat get_injection_template_format(
+    const std::string& template_path) {
+  FilePtr file = open_file(template_path, "rb");
+  uint64_t size = 0;
+  InjectionTemplate tmpl;
+  uint64_t executable_offset = 0;
+  if (!file || !get_file_size(file.get(), &size) ||
+      !read_template_header(FileInput(file.get(), size), &tmpl,
+                            &executable_offset)) {
+    return ExecutableFormat::kUnknown;
+  }
+
+  return tmpl.format;
+}
+
+StampResult stamp_injection_template(const std::string& template_path,
+                                     const std::vector<Resource>& resources,
+                                     const std::string& output_path) {
+  FilePtr file = open_file(template_path, "rb");
+  uint64_t size = 0;
+  InjectionTemplate tmpl;
+  uint64_t executable_offset = 0;
+  if (!file || !get_file_size(file.get(), &size) ||
+      !read_template_header(FileInput(file.get(), size), &tmpl,
+                            &executable_offset)) {
+    return StampResult::kError;
+  }
+
+  // Work out every write before creating the output
+  std::vector<std::pair<uint64_t, const std::vector<uint8_t>*>> data_writes;
+  std::vector<std::pair<uint64_t, std::vector<uint8_t>>> patches;
+
+  for (const Resource& resource : resources) {
+    auto entry = std::find_if(tmpl.resources.begin(), tmpl.resources.end(),
+                              [&](const TemplateResource& candidate) {
+                                return candidate.name == resource.name;
+                              });
+    if (entry == tmpl.resources.end()) {
+      return StampResult::kUnknownResource;
+    }
+
+    const uint64_t data_size = resource.data->size();
+
+    if (tmpl.format == ExecutableFormat::kELF) {
+      // The note is laid out again, as its header and the padding note after
+      // it depend on the size
+      Resource note;
+      note.name = resource.name;
+      note.data = resource.data;
+      note.alignment = entry->alignment;
+      ElfNoteLayout layout;
+      if (data_size > std::numeric_limits<uint32_t>::max() ||
+          !layout_note_in_slot(entry->note, note, &layout)) {
+        return StampResult::kTooLarge;
+      }
+
+      const uint64_t data_offset = layout.offset + layout.prefix.size();
+      const uint64_t padded_size = (data_size + 3) & ~uint64_t{3};
+      patches.emplace_back(layout.offset, layout.prefix);
+      data_writes.emplace_back(data_offset, resource.data);
+      patches.emplace_back(
+          data_offset + data_size,
+          std::vector<uint8_t>(static_cast<size_t>(padded_size - data_size)));
+      patches.emplace_back(data_offset + padded_size, layout.suffix);
+      continue;
+    }
+
+    for (const ResourceSlot& slot : entry->slots) {
+      if (data_size > slot.capacity ||
+          (slot.size_field_width < 8 &&
+           data_size > std::numeric_limits<uint32_t>::max())) {
+        return StampResult::kTooLarge;
+      }
+
+      data_writes.emplace_back(slot.offset, resource.data);
+      patches.emplace_back(slot.size_field, encode_slot_size(slot, data_size));
+    }
+  }
+
+  FilePtr output = open_file(output_path, "wb");
+  if (!output ||
+      !copy_file_contents(file.get(), output.get(), size - executable_offset,
+                          executable_offset)) {
+    return StampResult::kError;
+  }
+
+  for (const auto& write : data_writes) {
+    if (!write.second->empty() &&
+        !write_at(output.get(), write.first, write.second->data(),
+                  write.second->size())) {
+      return StampResult::kError;
+    }
+  }
+
+  for (const auto& patch : patches) {
+    if (!patch.second.empty() &&
+        !write_at(output.get(), patch.first, patch.second.data(),
+                  patch.second.size())) {
+      return StampResult::kError;
+    }
+  }
+
+  return std::fflush(output.get()) == 0 ? StampResult::kSuccess
+                                        : StampResult::kError;
+}
@@ -0,0 +1,72 @@
+#ifndef POSTJECT_STAMP_H_
+#define POSTJECT_STAMP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "elf_writer.h"
+#include "postject.h"
+#include "slot_writer.h"
+
+// Injection templates, for stamping many executables with different resources
+// out of the same base executable. Creating a template does the expensive
+// part once: the resources are injected empty, with room for as much data as
+// they'll ever hold, the sentinel fuse is flipped, and where the room is is
+// saved along with the resulting executable. Stamping an output then only
+// copies that executable and writes the data and its size over the room,
+// without parsing anything.
+
+// A resource of a template and where its room is
+struct TemplateResource {
+  std::string name;
+  uint64_t alignment = 0;
+  // The note slot for ELF, see `layout_note_in_slot()`
+  ElfNoteSlot note;
+  // The section in every slice for Mach-O, or the resource for PE. The slots
+  // are empty, so `capacity` is how much data they can hold.
+  std::vector<ResourceSlot> slots;
+};
+
+struct InjectionTemplate {
+  ExecutableFormat format = ExecutableFormat::kUnknown;
+  std::vector<TemplateResource> resources;
+  std::vector<uint8_t> executable;
+};
+
+enum class StampResult {
+  kSuccess,
+  // The template has no resource with that name
+  kUnknownResource,
+  // The data doesn't fit in the room left for it
+  kTooLarge,
+  kError
+};
+
+// Injects `resources` into the executable, with each one's `reserve` as its
+// capacity, and finds their room. The data of the resources is ignored. The
+// sentinel fuse is left for the caller to flip in `tmpl->executable`.
+InjectResult create_injection_template(const std::string& executable_path,
+                                       const std::string& segment_name,
+                                       const std::vector<Resource>& resources,
+                                       InjectionTemplate* tmpl);
+
+// Templates are saved as a small header describing the resources, followed by
+// the executable
+
+bool write_injection_template(const InjectionTemplate& tmpl,
+                              const std::string& template_path);
+
+// The format of the executable in the template, or `kUnknown` if the file
+// isn't a template
+ExecutableFormat get_injection_template_format(
+    const std::string& template_path);
+
+// Writes the executable in the template to `output_path`, with the data of
+// `resources` in their room. Resources of the template that aren't given stay
+// empty.
+StampResult stamp_injection_template(const std::string& template_path,
+                                     const std::vector<Resource>& resources,
+                                     const std::string& output_path);
+
+#endif  // POSTJECT_STAMP_H_
@@ -0,0 +1,379 @@
+#include <string>
+#include <vector>
+
+#include <emscripten/bind.h>
+#include <emscripten/heap.h>
+#include <emscripten/val.h>
+
+#include "checksum.h"
+#include "compression.h"
+#include "postject.h"
+#include "stamp.h"
+
+// Reads the length of an array or typed array as a JS number, the same in
+// wasm64 builds, where size_t is 64-bit
+size_t length_from_val(const emscripten::val& value) {
+  return static_cast<size_t>(value["length"].as<double>());
+}
+
+std::vector<uint8_t> vec_from_val(const emscripten::val& value) {
+  // Copy the contents of the Node.js Buffer with a single bulk
+  // `TypedArray.prototype.set()` call into a view over the vector's storage.
+  // This is much faster than `convertJSArrayToNumberVector()`, which converts
+  // each element through the JS function, `Number()`. No allocations happen
+  // in between creating the view and copying, so the heap can't grow and
+  // detach the view.
+  std::vector<uint8_t> vec(length_from_val(value));
+  emscripten::val view{emscripten::typed_memory_view(vec.size(), vec.data())};
+  view.call<void>("set", value);
+  return vec;
+}
+
+emscripten::val val_from_vec(const std::vector<uint8_t>& vec) {
+  // Construct a new Uint8Array in JS
+  emscripten::val view{emscripten::typed_memory_view(vec.size(), vec.data())};
+  auto output_data = emscripten::val::global("Uint8Array").new_(vec.size());
+  output_data.call<void>("set", view);
+  return output_data;
+}
+
+// A copy of the target executable in the WASM heap. It is created once per
+// injection from JS and shared by format detection and the `inject_into_*`
+// functions, so the executable is never converted more than once.
+class ExecutableBuffer {
+ public:
+  explicit ExecutableBuffer(const emscripten::val& value)
+      : data_(vec_from_val(value)) {}
+
+  const std::vector<uint8_t>& data() const { return data_; }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+// `{ phases: [{ name, ms }], bytesWritten }`
+emscripten::val stats_object(const InjectStats& stats) {
+  emscripten::val phases = emscripten::val::array();
+  for (const InjectStats::Phase& phase : stats.phases) {
+    emscripten::val entry = emscripten::val::object();
+    entry.set("name", phase.name);
+    entry.set("ms", phase.milliseconds);
+    phases.call<void>("push", entry);
+  }
+  emscripten::val object = emscripten::val::object();
+  object.set("phases", phases);
+  object.set("bytesWritten", static_cast<double>(stats.bytes_written));
+  return object;
+}
+
+// `{ result, stats }`
+emscripten::val inject_stats_object(InjectResult result,
+                                    const InjectStats& stats) {
+  emscripten::val object = emscripten::val::object();
+  object.set("result", emscripten::val(result));
+  object.set("stats", stats_object(stats));
+  return object;
+}
+
+// `{ result, stats, sentinelFuseResult }`, which the file functions return
+emscripten::val inject_file_result_object(InjectResult result,
+                                          const InjectStats& stats,
+                                          SentinelFuseResult fuse_result) {
+  emscripten::val object = inject_stats_object(result, stats);
+  object.set("sentinelFuseResult", emscripten::val(fuse_result));
+  return object;
+}
+
+// Unless `sentinel_fuse` is empty, the fuse is flipped while the output is
+// still in the WASM heap, so it's scanned once, before it's copied out
+emscripten::val inject_result_object(InjectResult result,
+                                     const InjectStats& stats,
+                                     const std::string& sentinel_fuse,
+                                     std::vector<uint8_t>* output) {
+  emscripten::val object = inject_stats_object(result, stats);
+  if (result == InjectResult::kSuccess && !sentinel_fuse.empty()) {
+    object.set("sentinelFuseResult",
+               emscripten::val(patch_sentinel_fuse(output, sentinel_fuse)));
+  }
+  object.set("data", result == InjectResult::kSuccess
+                         ? val_from_vec(*output)
+                         : emscripten::val::undefined());
+  return object;
+}
+
+ExecutableFormat get_executable_format_wasm(
+    const ExecutableBuffer& executable) {
+  return get_executable_format(executable.data());
+}
+
+// Reads an optional byte count, which is 0 if it's undefined
+uint64_t optional_bytes_from_val(const emscripten::val& value) {
+  return value.isUndefined() ? 0 : static_cast<uint64_t>(value.as<double>());
+}
+
+// Converts an array of `{ name, data, alignment, reserve, detached, file }`
+// objects from JS, where all but `name` are optional, and `data` is only
+// missing for detached resources streamed from `file`. The data is copied
+// into `storage`, which has to outlive the returned resources.
+std::vector<Resource> resources_from_val(
+    const emscripten::val& value,
+    std::vector<std::vector<uint8_t>>* storage) {
+  const uint32_t length = static_cast<uint32_t>(length_from_val(value));
+  std::vector<Resource> resources;
+  resources.reserve(length);
+  storage->reserve(length);
+
+  for (uint32_t i = 0; i < length; i++) {
+    emscripten::val resource = value[i];
+    emscripten::val file = resource["file"];
+    const bool streamed = !file.isUndefined();
+
+    // Streamed resources are read straight from the file system, which
+    // NODERAWFS gives access to, rather than copied into the WASM heap
+    storage->push_back(streamed ? std::vector<uint8_t>()
+                                : vec_from_val(resource["data"]));
+    Resource entry;
+    entry.name = resource["name"].as<std::string>();
+    entry.data = streamed ? nullptr : &storage->back();
+    entry.alignment = optional_bytes_from_val(resource["alignment"]);
+    entry.reserve = optional_bytes_from_val(resource["reserve"]);
+    entry.detached = resource["detached"].isTrue();
+    if (streamed) {
+      entry.file = file.as<std::string>();
+    }
+    resources.push_back(entry);
+  }
+
+  return resources;
+}
+
+emscripten::val inject_many_into_elf_wasm(const ExecutableBuffer& executable,
+                                          const emscripten::val& resources,
+                                          bool overwrite,
+                                          const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  std::vector<uint8_t> output;
+  InjectStats stats;
+  InjectResult result =
+      inject_many_into_elf(executable.data(),
+                           resources_from_val(resources, &storage), overwrite,
+                           &output, &stats);
+  return inject_result_object(result, stats, sentinel_fuse, &output);
+}
+
+emscripten::val inject_many_into_macho_wasm(const ExecutableBuffer& executable,
+                                            const std::string& segment_name,
+                                            const emscripten::val& resources,
+                                            bool overwrite,
+                                            const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  std::vector<uint8_t> output;
+  InjectStats stats;
+  InjectResult result = inject_many_into_macho(
+      executable.data(), segment_name, resources_from_val(resources, &storage),
+      overwrite, &output, &stats);
+  return inject_result_object(result, stats, sentinel_fuse, &output);
+}
+
+emscripten::val inject_many_into_pe_wasm(const ExecutableBuffer& executable,
+                                         const emscripten::val& resources,
+                                         bool overwrite,
+                                         const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  std::vector<uint8_t> output;
+  InjectStats stats;
+  InjectResult result =
+      inject_many_into_pe(executable.data(),
+                          resources_from_val(resources, &storage), overwrite,
+                          &output, &stats);
+  return inject_result_object(result, stats, sentinel_fuse, &output);
+}
+
+emscripten::val compress_resource_wasm(const emscripten::val& data) {
+  return val_from_vec(compress_resource(vec_from_val(data)));
+}
+
+emscripten::val checksum_resource_wasm(const emscripten::val& data) {
+  return val_from_vec(add_resource_checksum(vec_from_val(data)));
+}
+
+// The file-based functions access the host file system directly, since the
+// module is linked with NODERAWFS
+
+ExecutableFormat get_executable_format_of_file_wasm(
+    const std::string& filename) {
+  return get_executable_format_of_file(filename);
+}
+
+emscripten::val inject_many_into_elf_file_wasm(
+    const std::string& filename,
+    const emscripten::val& resources,
+    bool overwrite,
+    const std::string& output,
+    const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+  InjectResult result = inject_many_into_elf_file(
+      filename, resources_from_val(resources, &storage), overwrite, output,
+      sentinel_fuse, &fuse_result, &stats);
+  return inject_file_result_object(result, stats, fuse_result);
+}
+
+emscripten::val inject_many_into_macho_file_wasm(
+    const std::string& filename,
+    const std::string& segment_name,
+    const emscripten::val& resources,
+    bool overwrite,
+    const std::string& output,
+    const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+  InjectResult result = inject_many_into_macho_file(
+      filename, segment_name, resources_from_val(resources, &storage),
+      overwrite, output, sentinel_fuse, &fuse_result, &stats);
+  return inject_file_result_object(result, stats, fuse_result);
+}
+
+emscripten::val inject_many_into_pe_file_wasm(
+    const std::string& filename,
+    const emscripten::val& resources,
+    bool overwrite,
+    const std::string& output,
+    const std::string& sentinel_fuse) {
+  std::vector<std::vector<uint8_t>> storage;
+  SentinelFuseResult fuse_result = SentinelFuseResult::kSuccess;
+  InjectStats stats;
+  InjectResult result = inject_many_into_pe_file(
+      filename, resources_from_val(resources, &storage), overwrite, output,
+      sentinel_fuse, &fuse_result, &stats);
+  return inject_file_result_object(result, stats, fuse_result);
+}
+
+// The `reserve` of each resource is its capacity. The template is only written
+// when both the injection and flipping the fuse succeeded.
+emscripten::val create_injection_template_wasm(
+    const std::string& filename,
+    const std::string& segment_name,
+    const emscripten::val& resources,
+    const std::string& sentinel_fuse,
+    const std::string& template_filename) {
+  std::vector<std::vector<uint8_t>> storage;
+  InjectionTemplate tmpl;
+  InjectResult result = create_injection_template(
+      filename, segment_name, resources_from_val(resources, &storage), &tmpl);
+  SentinelFuseResult fuse_result = SentinelFuseResult::kError;
+  if (result == InjectResult::kSuccess) {
+    fuse_result = patch_sentinel_fuse(&tmpl.executable, sentinel_fuse);
+    if (fuse_result == SentinelFuseResult::kSuccess &&
+        !write_injection_template(tmpl, template_filename)) {
+      result = InjectResult::kError;
+    }
+  }
+
+  emscripten::val object = emscripten::val::object();
+  object.set("result", emscripten::val(result));
+  object.set("sentinelFuseResult", emscripten::val(fuse_result));
+  return object;
+}
+
+ExecutableFormat get_injection_template_format_wasm(
+    const std::string& template_filename) {
+  return get_injection_template_format(template_filename);
+}
+
+StampResult stamp_injection_template_wasm(const std::string& template_filename,
+                                          const emscripten::val& resources,
+                                          const std::string& output) {
+  std::vector<std::vector<uint8_t>> storage;
+  return stamp_injection_template(
+      template_filename, resources_from_val(resources, &storage), output);
+}
+
+// `[{ name, offset, size, detached }]`, or null if the file can't be read or
+// isn't an executable
+emscripten::val list_resources_in_file_wasm(const std::string& filename,
+                                            const std::string& segment_name) {
+  std::vector<ResourceInfo> resources;
+  if (!list_resources_in_file(filename, segment_name, &resources)) {
+    return emscripten::val::null();
+  }
+
+  emscripten::val array = emscripten::val::array();
+  for (const ResourceInfo& resource : resources) {
+    emscripten::val entry = emscripten::val::object();
+    entry.set("name", resource.name);
+    entry.set("offset", static_cast<double>(resource.offset));
+    entry.set("size", static_cast<double>(resource.size));
+    entry.set("detached", resource.detached);
+    array.call<void>("push", entry);
+  }
+  return array;
+}
+
+ExtractResult extract_resource_from_file_wasm(const std::string& filename,
+                                              const std::string& segment_name,
+                                              const std::string& name,
+                                              const std::string& output) {
+  return extract_resource_from_file(filename, segment_name, name, output);
+}
+
+// The size of the WASM memory, which only ever grows, so it's also the peak
+// heap usage so far
+double get_heap_size_wasm() {
+  return static_cast<double>(emscripten_get_heap_size());
+}
+
+EMSCRIPTEN_BINDINGS(postject) {
+  emscripten::enum_<ExecutableFormat>("ExecutableFormat")
+      .value("kELF", ExecutableFormat::kELF)
+      .value("kMachO", ExecutableFormat::kMachO)
+      .value("kPE", ExecutableFormat::kPE)
+      .value("kUnknown", ExecutableFormat::kUnknown);
+  emscripten::enum_<InjectResult>("InjectResult")
+      .value("kAlreadyExists", InjectResult::kAlreadyExists)
+      .value("kError", InjectResult::kError)
+      .value("kSuccess", InjectResult::kSuccess)
+      .value("kTooLarge", InjectResult::kTooLarge);
+  emscripten::enum_<SentinelFuseResult>("SentinelFuseResult")
+      .value("kSuccess", SentinelFuseResult::kSuccess)
+      .value("kNotFound", SentinelFuseResult::kNotFound)
+      .value("kMultipleFound", SentinelFuseResult::kMultipleFound)
+      .value("kInvalidValue", SentinelFuseResult::kInvalidValue)
+      .value("kError", SentinelFuseResult::kError);
+  emscripten::enum_<StampResult>("StampResult")
+      .value("kSuccess", StampResult::kSuccess)
+      .value("kUnknownResource", StampResult::kUnknownResource)
+      .value("kTooLarge", StampResult::kTooLarge)
+      .value("kError", StampResult::kError);
+  emscripten::enum_<ExtractResult>("ExtractResult")
+      .value("kSuccess", ExtractResult::kSuccess)
+      .value("kNotFound", ExtractResult::kNotFound)
+      .value("kError", ExtractResult::kError);
+  emscripten::class_<ExecutableBuffer>("ExecutableBuffer")
+      .constructor<const emscripten::val&>();
+  emscripten::function("getExecutableFormat", &get_executable_format_wasm);
+  emscripten::function("injectManyIntoELF", &inject_many_into_elf_wasm);
+  emscripten::function("injectManyIntoMachO", &inject_many_into_macho_wasm);
+  emscripten::function("injectManyIntoPE", &inject_many_into_pe_wasm);
+  emscripten::function("getExecutableFormatOfFile",
+                       &get_executable_format_of_file_wasm);
+  emscripten::function("injectManyIntoELFFile",
+                       &inject_many_into_elf_file_wasm);
+  emscripten::function("injectManyIntoMachOFile",
+                       &inject_many_into_macho_file_wasm);
+  emscripten::function("injectManyIntoPEFile", &inject_many_into_pe_file_wasm);
+  emscripten::function("createInjectionTemplate",
+                       &create_injection_template_wasm);
+  emscripten::function("getInjectionTemplateFormat",
+                       &get_injection_template_format_wasm);
+  emscripten::function("stampInjectionTemplate",
+                       &stamp_injection_template_wasm);
+  emscripten::function("listResourcesInFile", &list_resources_in_file_wasm);
+  emscripten::function("extractResourceFromFile",
+                       &extract_resource_from_file_wasm);
+  emscripten::function("compressResource", &compress_resource_wasm);
+  emscripten::function("checksumResource", &checksum_resource_wasm);
+  emscripten::function("getHeapSize", &get_heap_size_wasm);
+}
@@ -1,6 +1,14 @@
 import { createRequire } from "module";
 const require = createRequire(import.meta.url);
-const { inject } = require("..");
+const {
+  inject,
+  injectMany,
+  injectAll,
+  createTemplate,
+  stamp,
+  listResources,
+  extractResource,
+} = require("..");
 
 import { spawnSync, execSync } from "child_process";
 import * as crypto from "crypto";
@@ -117,6 +125,122 @@ describe("postject CLI", () => {
     }
   }).timeout(15_000);
 
+  it("should inject into the executables listed in a manifest", async () => {
+    const copy = path.join(tempDir, `copy${path.extname(filename)}`);
+    await fs.copy(filename, copy);
+
+    const manifest = path.join(tempDir, "manifest.json");
+    const options = {
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    };
+    await fs.writeJson(manifest, [
+      {
+        filename: path.basename(filename),
+        resources: [{ name: "foobar", file: "resource.bin" }],
+        options,
+      },
+      {
+        filename: path.basename(copy),
+        resources: [{ name: "foobar", file: "resource.bin" }],
+        options,
+      },
+    ]);
+
+    {
+      const { status, stdout } = spawnSync(
+        "node",
+        ["./dist/cli.js", "inject-all", manifest, "--concurrency", "2"],
+        { encoding: "utf-8" }
+      );
+      expect(stdout).to.have.string("Injection done!");
+      expect(status).to.equal(0);
+    }
+
+    for (const executable of [filename, copy]) {
+      const { status, stdout } = spawnSync(executable, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(resourceContents);
+    }
+  }).timeout(30_000);
+
+  it("should inject into an executable named like a command", async () => {
+    // Without `inject`, this would list the resources of `foobar` instead
+    await fs.copy(filename, path.join(tempDir, "list"));
+
+    const { status, stdout } = spawnSync(
+      "node",
+      [
+        path.resolve("./dist/cli.js"),
+        "inject",
+        "list",
+        "foobar",
+        resourceFilename,
+        "--sentinel-fuse",
+        "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+      ],
+      { cwd: tempDir, encoding: "utf-8" }
+    );
+    expect(stdout).to.have.string("Injection done!");
+    expect(status).to.equal(0);
+
+    const names = (await listResources(path.join(tempDir, "list"))).map(
+      ({ name }) => name.toLowerCase().replace(/^__/, "")
+    );
+    expect(names).to.include("foobar");
+  }).timeout(15_000);
+
+  it("should list and extract the injected resources", async () => {
+    await injectMany(
+      filename,
+      [
+        { name: "foobar", data: await fs.readFile(resourceFilename) },
+        { name: "other", data: Buffer.from("other") },
+      ],
+      { sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2" }
+    );
+
+    {
+      const { status, stdout } = spawnSync(
+        "node",
+        ["./dist/cli.js", "list", filename, "--json"],
+        { encoding: "utf-8" }
+      );
+      expect(status).to.equal(0);
+      const [{ resources }] = JSON.parse(stdout);
+      // Stored as __foobar on Mach-O and FOOBAR on PE
+      const names = resources.map(({ name }) =>
+        name.toLowerCase().replace(/^__/, "")
+      );
+      expect(names).to.include.members(["foobar", "other"]);
+      expect(resources[names.indexOf("foobar")].size).to.be.at.least(
+        resourceContents.length
+      );
+    }
+
+    {
+      const output = path.join(tempDir, "extracted.bin");
+      const { status } = spawnSync(
+        "node",
+        ["./dist/cli.js", "extract", filename, "foobar", output],
+        { encoding: "utf-8" }
+      );
+      expect(status).to.equal(0);
+      expect(await fs.readFile(output, "utf-8")).to.have.string(
+        resourceContents
+      );
+    }
+
+    {
+      const { status, stdout } = spawnSync(
+        "node",
+        ["./dist/cli.js", "extract", filename, "unknown", "unknown.bin"],
+        { encoding: "utf-8" }
+      );
+      expect(status).to.equal(1);
+      expect(stdout).to.have.string("Resource not found");
+    }
+  }).timeout(15_000);
+
   it("should display an error message when filename doesn't exist", async () => {
     {
       const { status, stdout, stderr } = spawnSync(
@@ -163,6 +287,73 @@ describe("postject CLI", () => {
   }).timeout(15_000);
 });
 
+describe("postject native CLI", () => {
+  let filename;
+  let tempDir;
+  let resourceContents;
+  let resourceFilename;
+  const IS_WINDOWS = os.platform() === "win32";
+  const nativeCli = IS_WINDOWS
+    ? "./build/native/postject.exe"
+    : "./build/native/postject";
+
+  beforeEach(async function () {
+    // The native build is optional, see `npm run build -- --native`
+    if (!(await fs.pathExists(nativeCli))) {
+      this.skip();
+    }
+
+    let originalFilename;
+
+    tempDir = temporaryDirectory();
+    await fs.ensureDir(tempDir);
+
+    if (IS_WINDOWS) {
+      originalFilename = "./build/test/Debug/cpp_test.exe";
+      filename = path.join(tempDir, "cpp_test.exe");
+    } else {
+      originalFilename = "./build/test/cpp_test";
+      filename = path.join(tempDir, "cpp_test");
+    }
+
+    await fs.copy(originalFilename, filename);
+
+    resourceContents = crypto.randomBytes(64).toString("hex");
+    resourceFilename = path.join(tempDir, "resource.bin");
+    await fs.writeFile(resourceFilename, resourceContents);
+  });
+
+  afterEach(() => {
+    if (tempDir) {
+      rimraf.sync(tempDir);
+    }
+  });
+
+  it("should inject a resource successfully", async () => {
+    {
+      const { status, stdout } = spawnSync(
+        nativeCli,
+        [
+          filename,
+          "foobar",
+          resourceFilename,
+          "--sentinel-fuse",
+          "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+        ],
+        { encoding: "utf-8" }
+      );
+      expect(stdout).to.have.string("Injection done!");
+      expect(status).to.equal(0);
+    }
+
+    {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(resourceContents);
+    }
+  }).timeout(15_000);
+});
+
 describe("postject API", () => {
   let filename;
   let tempDir;
@@ -235,6 +426,634 @@ describe("postject API", () => {
       expect(stdout).to.have.string(resourceContents);
     }
   }).timeout(15_000);
+
+  it("should inject multiple resources in one pass", async () => {
+    const resources = [
+      { name: "foobar", data: await fs.readFile(resourceFilename) },
+      { name: "other", data: crypto.randomBytes(1024) },
+      { name: "third", data: crypto.randomBytes(512) },
+    ];
+    await injectMany(filename, resources, {
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    });
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceContents);
+
+    // Every resource is injected with its own data, which Mach-O sections may
+    // pad
+    for (const { name, data } of resources) {
+      const output = path.join(tempDir, `${name}.bin`);
+      await extractResource(filename, name, output);
+      const extracted = await fs.readFile(output);
+      expect(extracted.length).to.be.at.least(data.length);
+      expect(extracted.subarray(0, data.length).equals(data)).to.be.true;
+    }
+  }).timeout(15_000);
+
+  it("should inject a compressed resource", async () => {
+    // Repetitive, so that it actually compresses
+    const resourceData = Buffer.from(resourceContents.repeat(1000));
+
+    await inject(filename, "foobar", resourceData, {
+      compress: true,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    });
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceData.toString());
+    expect(stdout).to.have.string(
+      `Decompressed: ${resourceData.length} bytes`
+    );
+  }).timeout(15_000);
+
+  it("should inject a compressed resource with checksums", async () => {
+    const resourceData = Buffer.from(resourceContents.repeat(1000));
+
+    await inject(filename, "foobar", resourceData, {
+      compress: true,
+      checksum: true,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    });
+
+    // The checksums after the compressed data aren't part of the resource
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceData.toString());
+    expect(stdout).to.have.string(
+      `Decompressed: ${resourceData.length} bytes`
+    );
+    expect(stdout).to.have.string("Checksum verified");
+  }).timeout(15_000);
+
+  it("should inject a resource with checksums", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+
+    await inject(filename, "foobar", resourceData, {
+      checksum: true,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    });
+
+    {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(resourceContents);
+      expect(stdout).to.have.string(
+        `Decompressed: ${resourceData.length} bytes`
+      );
+      expect(stdout).to.have.string(
+        `Checksum verified: ${resourceData.length} bytes`
+      );
+    }
+
+    // Corrupt the data, which is stored as is
+    const executable = await fs.readFile(filename);
+    const offset = executable.indexOf(resourceData);
+    expect(offset).to.not.equal(-1);
+    executable[offset] ^= 1;
+    await fs.writeFile(filename, executable);
+
+    {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.not.have.string("Checksum verified");
+    }
+  }).timeout(15_000);
+
+  it("should inject a page aligned resource", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+
+    await expect(
+      inject(filename, "foobar", resourceData, { align: 3 })
+    ).to.be.rejectedWith("power of two");
+
+    const options = {
+      align: 4096,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    };
+
+    // Only ELF supports the alignment, rather than silently ignoring it
+    if (process.platform !== "linux") {
+      const { size } = await fs.stat(filename);
+      await expect(
+        inject(filename, "foobar", resourceData, options)
+      ).to.be.rejectedWith("only supported for ELF");
+      expect((await fs.stat(filename)).size).to.equal(size);
+      return;
+    }
+
+    await inject(filename, "foobar", resourceData, options);
+
+    const executable = await fs.readFile(filename);
+    const offset = executable.indexOf(resourceData);
+    expect(offset).to.be.above(0);
+    expect(offset % 4096).to.equal(0);
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceContents);
+  }).timeout(15_000);
+
+  it("should overwrite a resource in place", async () => {
+    const sentinelFuse = "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2";
+
+    await inject(filename, "foobar", await fs.readFile(resourceFilename), {
+      reserve: 1024,
+      sentinelFuse,
+    });
+    const { size } = await fs.stat(filename);
+
+    // Larger than the original resource, but within the reserved room
+    const newContents = crypto.randomBytes(256).toString("hex");
+    await inject(filename, "foobar", Buffer.from(newContents), {
+      overwrite: true,
+      sentinelFuse,
+    });
+    // The linker may have code signed the Mach-O test binary, which is then
+    // rebuilt instead
+    if (process.platform !== "darwin") {
+      expect((await fs.stat(filename)).size).to.equal(size);
+    }
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(newContents);
+    expect(stdout).to.not.have.string(resourceContents);
+  }).timeout(15_000);
+
+  it("should inject a detached resource", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+    const options = {
+      detach: true,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    };
+
+    if (process.platform === "darwin") {
+      await expect(
+        inject(filename, "foobar", resourceData, options)
+      ).to.be.rejectedWith("only supported for ELF and PE");
+      return;
+    }
+
+    await inject(filename, "foobar", resourceData, options);
+
+    // Stored after the end of the executable, at a 64 KB boundary, followed
+    // by its descriptor
+    const executable = await fs.readFile(filename);
+    const offset = executable.indexOf(resourceData);
+    expect(offset % 65536).to.equal(0);
+    expect(executable.length).to.equal(offset + resourceData.length + 24);
+
+    {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(`Mapped: ${resourceContents}`);
+    }
+
+    // A descriptor that doesn't match the file anymore isn't trusted
+    executable[executable.length - 1] ^= 1;
+    await fs.writeFile(filename, executable);
+
+    {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.not.have.string("Mapped");
+    }
+  }).timeout(15_000);
+
+  it("should keep detached resources when injecting more", async () => {
+    if (process.platform === "darwin") {
+      return;
+    }
+
+    const resourceData = await fs.readFile(resourceFilename);
+    const sentinelFuse = "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2";
+
+    await inject(filename, "foobar", resourceData, {
+      detach: true,
+      sentinelFuse,
+    });
+    await inject(filename, "other", Buffer.from("other"), { sentinelFuse });
+
+    // Overwriting the detached resource reuses its data if it's at the end,
+    // rather than appending it again
+    const { size } = await fs.stat(filename);
+    await inject(filename, "other", resourceData, {
+      detach: true,
+      overwrite: true,
+      sentinelFuse,
+    });
+    await inject(filename, "other", resourceData, {
+      detach: true,
+      overwrite: true,
+      sentinelFuse,
+    });
+    const executable = await fs.readFile(filename);
+    expect(executable.length).to.be.above(size);
+    expect(executable.indexOf(resourceData, size)).to.equal(
+      executable.lastIndexOf(resourceData)
+    );
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(`Mapped: ${resourceContents}`);
+  }).timeout(15_000);
+
+  it("should stream a detached resource from a file", async () => {
+    const sentinelFuse = "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2";
+
+    // Larger than the 32-bit size fields of the formats
+    await expect(
+      inject(filename, "foobar", Buffer.from("foo"), {
+        reserve: 2 ** 32,
+        sentinelFuse,
+      })
+    ).to.be.rejectedWith("too large");
+
+    await expect(
+      injectMany(filename, [{ name: "foobar", file: resourceFilename }], {
+        sentinelFuse,
+      })
+    ).to.be.rejectedWith("Only detached resources");
+
+    if (process.platform === "darwin") {
+      return;
+    }
+
+    await injectMany(filename, [{ name: "foobar", file: resourceFilename }], {
+      detach: true,
+      sentinelFuse,
+    });
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(`Mapped: ${resourceContents}`);
+  }).timeout(15_000);
+
+  it("should stamp executables from a template", async () => {
+    const templateFilename = path.join(tempDir, "template");
+    await createTemplate(
+      filename,
+      templateFilename,
+      [{ name: "foobar", capacity: 1024 }],
+      { sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2" }
+    );
+
+    for (const size of [16, 512]) {
+      const contents = crypto.randomBytes(size).toString("hex");
+      const output = path.join(
+        tempDir,
+        `stamped-${size}${path.extname(filename)}`
+      );
+      await stamp(templateFilename, output, [
+        { name: "foobar", data: Buffer.from(contents) },
+      ]);
+
+      const { status, stdout } = spawnSync(output, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(contents);
+    }
+
+    await expect(
+      stamp(templateFilename, path.join(tempDir, "too-large"), [
+        { name: "foobar", data: crypto.randomBytes(2048) },
+      ])
+    ).to.be.rejectedWith("doesn't fit");
+  }).timeout(15_000);
+
+  it("should flip the fuse of every slice of a fat binary", async () => {
+    if (process.platform !== "darwin") {
+      return;
+    }
+
+    // Two copies of the test binary behind a fat header, each with a fuse
+    const thin = await fs.readFile(filename);
+    const sliceAlign = 2 ** 14;
+    const sliceSize = Math.ceil(thin.length / sliceAlign) * sliceAlign;
+    const fat = Buffer.alloc(sliceAlign + 2 * sliceSize);
+    fat.writeUInt32BE(0xcafebabe, 0);
+    fat.writeUInt32BE(2, 4);
+    for (let i = 0; i < 2; i++) {
+      const entry = 8 + i * 20;
+      const offset = sliceAlign + i * sliceSize;
+      fat.writeUInt32BE(thin.readUInt32LE(4), entry); // cputype
+      fat.writeUInt32BE(thin.readUInt32LE(8), entry + 4); // cpusubtype
+      fat.writeUInt32BE(offset, entry + 8);
+      fat.writeUInt32BE(thin.length, entry + 12);
+      fat.writeUInt32BE(Math.log2(sliceAlign), entry + 16);
+      thin.copy(fat, offset);
+    }
+    const fatFilename = path.join(tempDir, "fat");
+    await fs.writeFile(fatFilename, fat);
+
+    const sentinelFuse = "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2";
+    const countFlipped = async (file) => {
+      const data = await fs.readFile(file);
+      let count = 0;
+      for (
+        let i = data.indexOf(`${sentinelFuse}:1`);
+        i !== -1;
+        i = data.indexOf(`${sentinelFuse}:1`, i + 1)
+      ) {
+        count++;
+      }
+      return count;
+    };
+
+    // The fuse of a template is flipped in memory, and the fuse of an
+    // executable injected into in the file, both for each slice
+    const templateFilename = path.join(tempDir, "template");
+    await createTemplate(
+      fatFilename,
+      templateFilename,
+      [{ name: "foobar", capacity: 1024 }],
+      { sentinelFuse }
+    );
+    const stamped = path.join(tempDir, "stamped");
+    await stamp(templateFilename, stamped, [
+      { name: "foobar", data: Buffer.from(resourceContents) },
+    ]);
+    expect(await countFlipped(stamped)).to.equal(2);
+
+    await inject(fatFilename, "foobar", Buffer.from(resourceContents), {
+      sentinelFuse,
+    });
+    expect(await countFlipped(fatFilename)).to.equal(2);
+  }).timeout(15_000);
+
+  it("should report timings", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+
+    const report = await inject(filename, "foobar", resourceData, {
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+      timings: true,
+    });
+
+    const phaseNames = report.phases.map(({ name }) => name);
+    expect(phaseNames).to.include.members(["load", "detect", "write", "fuse"]);
+    expect(report.totalMs).to.be.at.least(0);
+    expect(report.bytesCopied).to.equal(resourceData.length);
+    expect(report.bytesWritten).to.be.above(resourceData.length);
+    expect(report.peakHeap).to.be.above(0);
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceContents);
+  }).timeout(15_000);
+
+  it("should inject into many executables in parallel", async () => {
+    const jobs = [];
+    for (let i = 0; i < 4; i++) {
+      const copy = path.join(tempDir, `copy-${i}${path.extname(filename)}`);
+      await fs.copy(filename, copy);
+      jobs.push({
+        filename: copy,
+        resources: [
+          { name: "foobar", data: Buffer.from(`${resourceContents}-${i}`) },
+        ],
+      });
+    }
+
+    // Resources streamed from a file have to make it to the workers as well
+    const fileJobs = [];
+    if (process.platform !== "darwin") {
+      const copy = path.join(tempDir, `copy-file${path.extname(filename)}`);
+      await fs.copy(filename, copy);
+      fileJobs.push({
+        filename: copy,
+        resources: [{ name: "foobar", file: resourceFilename }],
+        options: { detach: true },
+      });
+    }
+
+    const options = {
+      concurrency: 2,
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    };
+    await injectAll([...jobs, ...fileJobs], options);
+
+    for (const [i, { filename }] of jobs.entries()) {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(`${resourceContents}-${i}`);
+    }
+
+    for (const { filename } of fileJobs) {
+      const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+      expect(status).to.equal(0);
+      expect(stdout).to.have.string(`Mapped: ${resourceContents}`);
+    }
+
+    await expect(
+      injectAll(
+        [...jobs, { filename: resourceFilename, resources: jobs[0].resources }],
+        { ...options, overwrite: true }
+      )
+    ).to.be.rejectedWith(resourceFilename);
+  }).timeout(30_000);
+
+  it("should not inject the same resource twice", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+    const options = {
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    };
+
+    await inject(filename, "foobar", resourceData, options);
+    await expect(
+      inject(filename, "foobar", resourceData, options)
+    ).to.be.rejectedWith("already exists");
+
+    // The original resource must still be intact
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceContents);
+  }).timeout(15_000);
+
+  it("should leave the executable intact if the fuse can't be flipped", async () => {
+    const resourceData = await fs.readFile(resourceFilename);
+    const original = await fs.readFile(filename);
+
+    await expect(
+      inject(filename, "foobar", resourceData, {
+        sentinelFuse: "NODE_JS_FUSE_0000000000000000000000000000000",
+      })
+    ).to.be.rejectedWith("Could not find the sentinel");
+    expect((await fs.readFile(filename)).equals(original)).to.be.true;
+
+    // Nothing was injected, so injecting with the right fuse doesn't find a
+    // resource that already exists
+    await inject(filename, "foobar", resourceData, {
+      sentinelFuse: "NODE_JS_FUSE_fce680ab2cc467b6e072b8b5df1996b2",
+    });
+
+    const { status, stdout } = spawnSync(filename, { encoding: "utf-8" });
+    expect(status).to.equal(0);
+    expect(stdout).to.have.string(resourceContents);
+  }).timeout(15_000);
+});
+
+describe("DeltaWriter", () => {
+  let executable;
+  let original;
+  let tempDir;
+  const IS_WINDOWS = os.platform() === "win32";
+  const deltaWriterTest = IS_WINDOWS
+    ? "./build/test/Debug/delta_writer_test.exe"
+    : "./build/test/delta_writer_test";
+
+  beforeEach(async () => {
+    let originalFilename;
+
+    tempDir = temporaryDirectory();
+    await fs.ensureDir(tempDir);
+
+    if (IS_WINDOWS) {
+      originalFilename = "./build/test/Debug/cpp_test.exe";
+      executable = path.join(tempDir, "cpp_test.exe");
+    } else {
+      originalFilename = "./build/test/cpp_test";
+      executable = path.join(tempDir, "cpp_test");
+    }
+
+    await fs.copy(originalFilename, executable);
+    original = await fs.readFile(executable);
+  });
+
+  afterEach(() => {
+    rimraf.sync(tempDir);
+  });
+
+  const randomHex = (size) => crypto.randomBytes(size).toString("hex");
+
+  // What rewriting all of the output gives, i.e. the operations applied to
+  // the executable in order and the result truncated or extended to `size`
+  function rewrite(size, operations) {
+    let output = Buffer.from(original);
+    for (const operation of operations) {
+      const [kind, ...fields] = operation.split(":");
+      const offset = Number(fields[0]);
+      const data =
+        kind === "write"
+          ? Buffer.from(fields[1], "hex")
+          : kind === "zeros"
+          ? Buffer.alloc(Number(fields[1]))
+          : original.subarray(
+              Number(fields[1]),
+              Number(fields[1]) + Number(fields[2])
+            );
+      if (offset + data.length > output.length) {
+        output = Buffer.concat([
+          output,
+          Buffer.alloc(offset + data.length - output.length),
+        ]);
+      }
+      data.copy(output, offset);
+    }
+    return size <= output.length
+      ? output.subarray(0, size)
+      : Buffer.concat([output, Buffer.alloc(size - output.length)]);
+  }
+
+  // Writes the operations with DeltaWriter and checks the output against
+  // rewriting it, returning the bytes written
+  async function deltaWrite(output, size, operations) {
+    const { status, stdout } = spawnSync(
+      deltaWriterTest,
+      [executable, output, String(size), ...operations],
+      { encoding: "utf-8" }
+    );
+    expect(status).to.equal(0);
+
+    const expected = rewrite(size, operations);
+    expect((await fs.readFile(output)).equals(expected)).to.be.true;
+    expect(await fs.pathExists(`${output}.postject-tmp`)).to.be.false;
+    return Number(stdout.match(/Written: (\d+) bytes/)[1]);
+  }
+
+  it("should patch the headers and append in place", async () => {
+    const { ino } = await fs.stat(executable);
+
+    const written = await deltaWrite(executable, original.length + 100, [
+      `write:16:${randomHex(8)}`,
+      `write:${original.length + 20}:${randomHex(50)}`,
+    ]);
+
+    expect((await fs.stat(executable)).ino).to.equal(ino);
+    expect(written).to.be.at.most(8 + 50);
+  });
+
+  it("should write moved data to a temporary file", async () => {
+    const { ino } = await fs.stat(executable);
+
+    await deltaWrite(executable, original.length, [
+      `write:16:${randomHex(8)}`,
+      `write:${Math.floor(original.length / 2)}:${randomHex(64)}`,
+    ]);
+
+    expect((await fs.stat(executable)).ino).to.not.equal(ino);
+  });
+
+  it("should leave the executable as is when writing another output", async () => {
+    const output = path.join(tempDir, "output");
+
+    await deltaWrite(output, original.length + 100, [
+      `write:16:${randomHex(8)}`,
+      `write:${original.length}:${randomHex(100)}`,
+    ]);
+
+    expect((await fs.readFile(executable)).equals(original)).to.be.true;
+  });
+
+  it("should truncate the output", async () => {
+    // Truncating is never safe in place, even for header patches
+    const { ino } = await fs.stat(executable);
+
+    await deltaWrite(executable, original.length - 1000, [
+      `write:16:${randomHex(8)}`,
+      `write:${original.length - 2000}:${randomHex(64)}`,
+    ]);
+
+    expect((await fs.stat(executable)).ino).to.not.equal(ino);
+  });
+
+  it("should grow the output with zeros", async () => {
+    await deltaWrite(executable, original.length + 5000, [
+      `zeros:${original.length}:3000`,
+      `write:${original.length + 4000}:${randomHex(64)}`,
+    ]);
+  });
+
+  it("should apply overlapping writes in order in place", async () => {
+    const { ino } = await fs.stat(executable);
+
+    await deltaWrite(executable, original.length + 64, [
+      `write:32:${randomHex(64)}`,
+      `write:48:${randomHex(16)}`,
+      `zeros:40:8`,
+      `write:${original.length}:${randomHex(32)}`,
+      // Zeros past the end are still written over earlier writes
+      `zeros:${original.length + 8}:8`,
+    ]);
+
+    expect((await fs.stat(executable)).ino).to.equal(ino);
+  });
+
+  it("should apply overlapping writes and copies in order", async () => {
+    const middle = Math.floor(original.length / 2);
+
+    await deltaWrite(executable, original.length + 64, [
+      `write:${middle}:${randomHex(64)}`,
+      `copy:${middle + 16}:4096:16`,
+      // Copying data onto itself restores what earlier writes changed
+      `write:4096:${randomHex(16)}`,
+      `copy:4096:4096:16`,
+      `write:${original.length}:${randomHex(32)}`,
+      `copy:${original.length + 8}:100:16`,
+      `zeros:${original.length + 16}:4`,
+    ]);
+  });
 });
 
 describe("api.js should not contain __filename and __dirname", () => {
@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "delta_writer.h"
+
+// Writes the output of a rebuild with DeltaWriter, for test/cli.mjs to check
+// against rewriting it all:
+//
+//   delta_writer_test <executable> <output> <size> <operation>...
+//
+// where the operations are `write:<offset>:<hex data>`,
+// `zeros:<offset>:<size>` and `copy:<offset>:<from>:<size>`.
+
+namespace {
+
+std::vector<std::string> split(const std::string& operation) {
+  std::vector<std::string> fields;
+  std::stringstream stream(operation);
+  std::string field;
+  while (std::getline(stream, field, ':')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+uint64_t parse_number(const std::string& number) {
+  return std::strtoull(number.c_str(), nullptr, 10);
+}
+
+std::vector<uint8_t> parse_hex(const std::string& hex) {
+  std::vector<uint8_t> data;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    data.push_back(static_cast<uint8_t>(
+        std::strtoul(hex.substr(i, 2).c_str(), nullptr, 16)));
+  }
+  return data;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::cerr << "Usage: delta_writer_test <executable> <output> <size> "
+                 "<operation>..."
+              << std::endl;
+    return 1;
+  }
+
+  DeltaWriter writer;
+  if (!writer.open(argv[1], argv[2])) {
+    std::cerr << "Couldn't open the executable." << std::endl;
+    return 1;
+  }
+
+  // The data has to outlive `commit()`
+  std::vector<std::vector<uint8_t>> data;
+  data.reserve(argc);
+
+  for (int i = 4; i < argc; i++) {
+    const std::vector<std::string> fields = split(argv[i]);
+    bool written = false;
+    if (fields.size() == 3 && fields[0] == "write") {
+      data.push_back(parse_hex(fields[2]));
+      written = writer.write(parse_number(fields[1]), data.back().data(),
+                             data.back().size());
+    } else if (fields.size() == 3 && fields[0] == "zeros") {
+      written =
+          writer.write_zeros(parse_number(fields[1]), parse_number(fields[2]));
+    } else if (fields.size() == 4 && fields[0] == "copy") {
+      written = writer.copy(parse_number(fields[1]), parse_number(fields[2]),
+                            parse_number(fields[3]));
+    }
+
+    if (!written) {
+      std::cerr << "Couldn't apply " << argv[i] << "." << std::endl;
+      return 1;
+    }
+  }
+
+  if (!writer.commit(parse_number(argv[3]))) {
+    std::cerr << "Couldn't commit the output." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Written: " << writer.written() << " bytes" << std::endl;
+  return 0;
+}
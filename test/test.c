@@ -7,6 +7,26 @@
 
 #include "../dist/postject-api.h"
 
+struct enumerated_resource {
+  const char* name;
+  const void* ptr;
+  size_t size;
+  bool found;
+};
+
+static bool find_enumerated_resource(const char* name,
+                                     const void* data,
+                                     size_t size,
+                                     void* user_data) {
+  struct enumerated_resource* resource = (struct enumerated_resource*)user_data;
+  if (strstr(name, resource->name) != NULL && data == resource->ptr &&
+      size == resource->size) {
+    resource->found = true;
+    return false;
+  }
+  return true;
+}
+
 int main() {
   size_t size = 0;
 
@@ -20,6 +40,24 @@ int main() {
       fprintf(stderr, "size must not be 0.\n");
       exit(1);
     }
+    // Mach-O section names are prefixed with __, PE resource names are
+    // uppercased
+    struct enumerated_resource resource = {"foobar", ptr, size, false};
+#if defined(_WIN32)
+    resource.name = "FOOBAR";
+#endif
+    postject_enumerate_resources(find_enumerated_resource, &resource, NULL);
+    if (!resource.found) {
+      fprintf(stderr, "resource must be enumerated.\n");
+      exit(1);
+    }
+    struct postject_span span;
+    postject_resource_span(ptr, size, POSTJECT_HINT_WILLNEED, &span);
+    if ((const char*)span.data > (const char*)ptr ||
+        (const char*)span.data + span.size < (const char*)ptr + size) {
+      fprintf(stderr, "span must cover the resource.\n");
+      exit(1);
+    }
     char* str = (char*)malloc(size + 1);
     memset(str, 0, size + 1);
 #if defined(_WIN32)
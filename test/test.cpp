@@ -17,7 +17,43 @@ int main() {
       std::cerr << "size must not be 0." << std::endl;
       exit(1);
     }
-    std::cout << std::string(static_cast<const char*>(ptr), size) << std::endl;
+
+    // Resources injected with --detach are mapped from the executable
+    size_t mapped_size = 0;
+    const void* mapped = postject_map_resource("foobar", &mapped_size, nullptr);
+    if (mapped != nullptr) {
+      std::cout << "Mapped: "
+                << std::string(static_cast<const char*>(mapped), mapped_size)
+                << std::endl;
+      postject_unmap_resource(mapped, mapped_size);
+      return 0;
+    }
+
+    // Resources injected with --compress are decompressed, others are copied
+    size_t decompressed_size = 0;
+    if (!postject_find_resource_decompressed("foobar", nullptr, 0,
+                                             &decompressed_size, nullptr)) {
+      std::cerr << "resource must be readable." << std::endl;
+      exit(1);
+    }
+    std::string contents(decompressed_size, '\0');
+    if (!postject_find_resource_decompressed("foobar", &contents[0],
+                                             contents.size(),
+                                             &decompressed_size, nullptr)) {
+      std::cerr << "resource must be decompressed." << std::endl;
+      exit(1);
+    }
+    std::cout << contents << std::endl;
+    std::cout << "Decompressed: " << decompressed_size << " bytes" << std::endl;
+
+    // Only resources injected with --checksum can be verified
+    const void* verified_data = nullptr;
+    size_t verified_size = 0;
+    if (postject_verify_resource("foobar", &verified_data, &verified_size,
+                                 nullptr)) {
+      std::cout << "Checksum verified: " << verified_size << " bytes"
+                << std::endl;
+    }
   } else {
     const void* ptr = postject_find_resource("foobar", &size, nullptr);
     if (ptr != nullptr) {